@@ -0,0 +1,175 @@
+#include "base64_stream.h"
+#include <string.h>
+
+// MARK: Decode Table
+#define B64_BAD -1
+#define B64_SKIP -2     // Whitespace
+#define B64_PAD -3
+#define B64_ESCAPE -4   // JSON escape: "\/" is a slash, "\n" and friends are whitespace
+
+typedef struct {
+    int8_t values[256];
+} DecodeTable;
+
+static DecodeTable buildTable(void) {
+    DecodeTable table;
+    memset(table.values, B64_BAD, sizeof(table.values));
+    const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (int i = 0; i < 64; i++) {
+        table.values[(uint8_t)alphabet[i]] = i;
+    }
+    table.values[(uint8_t)' '] = B64_SKIP;
+    table.values[(uint8_t)'\t'] = B64_SKIP;
+    table.values[(uint8_t)'\r'] = B64_SKIP;
+    table.values[(uint8_t)'\n'] = B64_SKIP;
+    table.values[(uint8_t)'\\'] = B64_ESCAPE;
+    table.values[(uint8_t)'='] = B64_PAD;
+    return table;
+}
+
+static const DecodeTable s_table = buildTable();
+
+// MARK: Decoder
+void base64DecoderInit(Base64Decoder* decoder) {
+    memset(decoder, 0, sizeof(*decoder));
+}
+
+size_t base64Decode(Base64Decoder* decoder, const char* in, size_t len, uint8_t* out) {
+    if (decoder->failed) {
+        return 0;
+    }
+    const int8_t* table = s_table.values;
+    const uint8_t* src = (const uint8_t*)in;
+    const uint8_t* end = src + len;
+    uint8_t* dst = out;
+
+    while (src < end) {
+        // Between quads: take whole clean quads at once, the common case
+        if (decoder->count == 0 && !decoder->done && !decoder->escaped) {
+            while (end - src >= 4) {
+                int32_t a = table[src[0]], b = table[src[1]], c = table[src[2]], d = table[src[3]];
+                if ((a | b | c | d) < 0) {
+                    break;
+                }
+                uint32_t triple = (uint32_t)a << 18 | (uint32_t)b << 12 | (uint32_t)c << 6 | (uint32_t)d;
+                dst[0] = triple >> 16;
+                dst[1] = triple >> 8;
+                dst[2] = triple;
+                dst += 3;
+                src += 4;
+            }
+            if (src == end) {
+                break;
+            }
+        }
+
+        // One character at a time around skips, escapes, padding and piece boundaries
+        uint8_t ch = *src++;
+        int8_t value = table[ch];
+        if (decoder->escaped) {
+            decoder->escaped = false;
+            if (ch == 'n' || ch == 'r' || ch == 't') {
+                continue;
+            }
+            value = ch == '/' ? table[ch] : B64_BAD;
+        } else if (value == B64_ESCAPE) {
+            decoder->escaped = true;
+            continue;
+        }
+        if (value == B64_SKIP) {
+            continue;
+        }
+        if (value == B64_PAD) {
+            if (!decoder->done) {
+                if (decoder->count < 2) {
+                    decoder->failed = true;
+                    return 0;
+                }
+                dst += base64DecodeFinish(decoder, dst);
+                decoder->done = true;
+            }
+            continue;
+        }
+        if (value == B64_BAD || decoder->done) {
+            decoder->failed = true;
+            return 0;
+        }
+        decoder->bits = decoder->bits << 6 | value;
+        if (++decoder->count == 4) {
+            dst[0] = decoder->bits >> 16;
+            dst[1] = decoder->bits >> 8;
+            dst[2] = decoder->bits;
+            dst += 3;
+            decoder->bits = 0;
+            decoder->count = 0;
+        }
+    }
+    return dst - out;
+}
+
+size_t base64DecodeFinish(Base64Decoder* decoder, uint8_t* out) {
+    size_t written = 0;
+    if (decoder->count == 1) {
+        decoder->failed = true;
+    } else if (decoder->count == 2) {
+        out[0] = decoder->bits >> 4;
+        written = 1;
+    } else if (decoder->count == 3) {
+        out[0] = decoder->bits >> 10;
+        out[1] = decoder->bits >> 2;
+        written = 2;
+    }
+    decoder->bits = 0;
+    decoder->count = 0;
+    return written;
+}
+
+// MARK: JSON Envelope
+static const char* findToken(const char* from, const char* end, const char* token) {
+    size_t token_len = strlen(token);
+    while (end - from >= (ptrdiff_t)token_len) {
+        const char* hit = (const char*)memchr(from, token[0], end - from - token_len + 1);
+        if (!hit) {
+            return NULL;
+        }
+        if (memcmp(hit, token, token_len) == 0) {
+            return hit;
+        }
+        from = hit + 1;
+    }
+    return NULL;
+}
+
+bool base64FindInlineData(const char* json, size_t len, size_t from, size_t* start, size_t* end) {
+    if (!json || from >= len) {
+        return false;
+    }
+    const char* limit = json + len;
+    const char* snake = findToken(json + from, limit, "\"inline_data\"");
+    const char* camel = findToken(json + from, snake ? snake : limit, "\"inlineData\"");
+    const char* part = camel ? camel : snake;
+    if (!part) {
+        return false;
+    }
+
+    // "data": "..." inside the part, skipping the MIME type if it comes first
+    const char* key = findToken(part, limit, "\"data\"");
+    if (!key) {
+        return false;
+    }
+    const char* p = key + 6;
+    while (p < limit && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t' || *p == ':')) {
+        p++;
+    }
+    if (p >= limit || *p != '"') {
+        return false;
+    }
+    p++;
+    const char* close = (const char*)memchr(p, '"', limit - p);
+    if (!close) {
+        return false;
+    }
+    *start = p - json;
+    *end = close - json;
+    return true;
+}
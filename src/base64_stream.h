@@ -0,0 +1,68 @@
+#ifndef BASE64_STREAM_H
+#define BASE64_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Incremental base64 decoding of inline images in JSON bodies
+ *
+ * The decoder keeps its partial quad between calls, so input can be fed
+ * in whatever pieces it arrives in (a stored payload sliced for sending,
+ * or a response read off the socket). Whitespace is skipped, as are the
+ * JSON escapes that can appear in base64 text ("\/", "\n", "\r", "\t").
+ */
+
+/**
+ * Output needed for chars of input, including up to 3 carried from the previous call
+ */
+#define BASE64_DECODED_MAX(chars) (((chars) + 3) / 4 * 3)
+
+typedef struct {
+    uint32_t bits;
+    uint8_t count;      // Characters in bits
+    bool done;          // Padding seen, only more padding may follow
+    bool escaped;       // Backslash seen, the escaped character is next
+    bool failed;
+} Base64Decoder;
+
+void base64DecoderInit(Base64Decoder* decoder);
+
+/**
+ * Decode the next piece of input
+ * @param out Must hold BASE64_DECODED_MAX(len) bytes
+ * @return Bytes written; once decoder->failed is set it stays at 0
+ */
+size_t base64Decode(Base64Decoder* decoder, const char* in, size_t len, uint8_t* out);
+
+/**
+ * Flush the last, unpadded quad
+ * @param out Must hold 2 bytes
+ * @return Bytes written; sets decoder->failed if the input ended mid-byte
+ */
+size_t base64DecodeFinish(Base64Decoder* decoder, uint8_t* out);
+
+/**
+ * Find the base64 text of the next inline image in a JSON body
+ *
+ * Matches Gemini's "inline_data" (requests) and "inlineData" (responses)
+ * parts, with "data" before or after the MIME type. Only scans for
+ * tokens; the body is not validated.
+ *
+ * @param from Offset to search from, e.g. the previous match's end
+ * @param start Receives the offset of the first base64 character
+ * @param end Receives the offset of the closing quote
+ * @return true if found
+ */
+bool base64FindInlineData(const char* json, size_t len, size_t from, size_t* start, size_t* end);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BASE64_STREAM_H */
@@ -0,0 +1,122 @@
+#include "boot_sequence.h"
+#include "vision_transport.h"
+#include "platform_port.h"
+#include <Arduino.h>
+#include <WiFi.h>
+#include "esp_attr.h"
+#include <string.h>
+
+// MARK: Boot Config
+static const uint32_t FAST_CONNECT_TIMEOUT_MS = 3000;  // Before giving up on the cached access point
+static const uint32_t RTC_CACHE_MAGIC = 0x57494649;    // "WIFI"
+
+// Survives ESP.restart() and watchdog resets, not power loss
+typedef struct {
+    uint32_t magic;
+    uint8_t bssid[6];
+    int32_t channel;
+} ApCache;
+
+RTC_DATA_ATTR static ApCache s_ap_cache;
+
+static const char* s_ssid = NULL;
+static const char* s_password = NULL;
+static bool s_fast_connect = false;
+static uint32_t s_started_at = 0;
+static uint32_t s_ready_at = 0;
+static PortSem s_got_ip = NULL;     // Given by the WiFi event task when an address is assigned
+
+static void onGotIp(arduino_event_id_t event) {
+    (void)event;
+    portSemGive(s_got_ip);
+}
+
+void bootStartNetwork(const char* ssid, const char* password) {
+    s_ssid = ssid;
+    s_password = password;
+    s_started_at = millis();
+
+    // Credentials come from the build, don't rewrite them to NVS on every boot
+    WiFi.persistent(false);
+    WiFi.mode(WIFI_STA);
+    WiFi.setAutoReconnect(true);
+    if (!s_got_ip) {
+        s_got_ip = portSemCreate(0);
+        if (s_got_ip) {
+            WiFi.onEvent(onGotIp, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+        }
+    }
+
+    s_fast_connect = s_ap_cache.magic == RTC_CACHE_MAGIC;
+    if (s_fast_connect) {
+        WiFi.begin(ssid, password, s_ap_cache.channel, s_ap_cache.bssid, true);
+    } else {
+        WiFi.begin(ssid, password);
+    }
+}
+
+// MARK: Sequence
+void bootService(void) {
+    if (!s_ssid) {
+        return;
+    }
+    bool connected = WiFi.status() == WL_CONNECTED;
+
+    if (!connected && s_fast_connect && millis() - s_started_at > FAST_CONNECT_TIMEOUT_MS) {
+        // The access point moved or changed channel: scan like a cold boot
+        Serial.println("Cached access point not answering, scanning");
+        s_ap_cache.magic = 0;
+        s_fast_connect = false;
+        WiFi.disconnect();
+        WiFi.begin(s_ssid, s_password);
+        return;
+    }
+
+    if (connected && s_ready_at == 0) {
+        s_ready_at = millis();
+        Serial.printf("WiFi connected in %lu ms%s, IP address: %s\n",
+                      (unsigned long)(s_ready_at - s_started_at), s_fast_connect ? " (cached AP)" : "",
+                      WiFi.localIP().toString().c_str());
+
+        const uint8_t* bssid = WiFi.BSSID();
+        if (bssid) {
+            memcpy(s_ap_cache.bssid, bssid, sizeof(s_ap_cache.bssid));
+            s_ap_cache.channel = WiFi.channel();
+            s_ap_cache.magic = RTC_CACHE_MAGIC;
+        }
+
+        // Resolve and handshake now so the first classification doesn't pay for it
+        visionConnPrewarm(visionGetBackend());
+    }
+}
+
+bool bootNetworkReady(void) {
+    return s_ready_at != 0 && WiFi.status() == WL_CONNECTED;
+}
+
+bool bootWaitForNetwork(uint32_t timeout_ms) {
+    uint32_t start = millis();
+    for (;;) {
+        bootService();
+        if (bootNetworkReady()) {
+            return true;
+        }
+        uint32_t elapsed = millis() - start;
+        if (elapsed >= timeout_ms || !s_got_ip) {
+            return false;
+        }
+
+        // Sleep until the address arrives, waking once more if the cached access point needs a scan
+        uint32_t wait = timeout_ms - elapsed;
+        uint32_t since_start = millis() - s_started_at;
+        if (s_fast_connect && since_start <= FAST_CONNECT_TIMEOUT_MS) {
+            uint32_t until_scan = FAST_CONNECT_TIMEOUT_MS - since_start + 1;
+            wait = until_scan < wait ? until_scan : wait;
+        }
+        portSemTakeTimeout(s_got_ip, wait);
+    }
+}
+
+uint32_t bootNetworkReadyAt(void) {
+    return s_ready_at;
+}
@@ -0,0 +1,56 @@
+#ifndef BOOT_SEQUENCE_H
+#define BOOT_SEQUENCE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Non-blocking network bring-up
+ *
+ * Association runs on the WiFi driver's task while setup() initializes
+ * the camera and storage, so the device can capture before the network
+ * is up. The access point's BSSID and channel are kept in RTC memory,
+ * which survives software and watchdog resets, letting the next boot
+ * skip the channel scan. Once an address is assigned, the backend
+ * connection is pre-warmed so the first request starts with DNS and TLS
+ * done.
+ */
+
+/**
+ * Start associating; returns immediately
+ */
+void bootStartNetwork(const char* ssid, const char* password);
+
+/**
+ * Advance the sequence: fall back to a full scan if the cached access
+ * point does not answer, and pre-warm once connected. Cheap; call every
+ * loop iteration.
+ */
+void bootService(void);
+
+/**
+ * @return true once the station has an IP address
+ */
+bool bootNetworkReady(void);
+
+/**
+ * Wait for the network, servicing the sequence meanwhile
+ * @param timeout_ms How long to wait at most
+ * @return true if the network is up
+ */
+bool bootWaitForNetwork(uint32_t timeout_ms);
+
+/**
+ * @return millis() when the network first came up, 0 if it has not yet
+ */
+uint32_t bootNetworkReadyAt(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BOOT_SEQUENCE_H */
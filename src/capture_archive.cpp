@@ -0,0 +1,203 @@
+#include "capture_archive.h"
+#include "waste_classifier.h"
+#include "platform_port.h"
+#include <Arduino.h>
+#include "img_converters.h"
+#include <stdio.h>
+#include <string.h>
+
+// MARK: Archive Config
+static const uint8_t QUALITIES[] = {80, 60, 40};    // Retried lower until the JPEG fits a slot
+static const size_t TAR_BLOCK = 512;
+static const size_t INDEX_LINE_SIZE = 96;
+
+static uint8_t* s_arena = NULL;     // ARCHIVE_SLOTS slots of ARCHIVE_SLOT_SIZE
+static uint8_t* s_export = NULL;    // One slot, for copying out before sending
+static ArchiveEntry s_entries[ARCHIVE_SLOTS];
+static uint8_t s_next_slot = 0;
+static uint32_t s_next_id = 1;
+static PortSem s_lock = NULL;
+
+bool archiveBegin(void) {
+    if (s_arena) {
+        return true;
+    }
+    s_lock = portSemCreate(1);
+    s_arena = (uint8_t*)ps_malloc((ARCHIVE_SLOTS + 1) * ARCHIVE_SLOT_SIZE);
+    if (!s_lock || !s_arena) {
+        free(s_arena);
+        s_arena = NULL;
+        return false;
+    }
+    s_export = s_arena + ARCHIVE_SLOTS * ARCHIVE_SLOT_SIZE;
+    memset(s_entries, 0, sizeof(s_entries));
+    return true;
+}
+
+// MARK: Add
+typedef struct {
+    uint8_t* out;
+    size_t size;
+} SlotWriter;
+
+static size_t slotWrite(void* arg, size_t index, const void* data, size_t len) {
+    SlotWriter* slot = (SlotWriter*)arg;
+    if (!data) {
+        return 0;
+    }
+    if (index + len > ARCHIVE_SLOT_SIZE) {
+        return 0;   // Aborts the encoder, retried at a lower quality
+    }
+    memcpy(slot->out + index, data, len);
+    slot->size = index + len;
+    return len;
+}
+
+bool archiveAdd(const Thumbnail* thumb, const ArchiveEntry* entry) {
+    if (!s_arena || !thumb || !entry || thumb->width == 0 || thumb->height == 0) {
+        return false;
+    }
+
+    portSemTake(s_lock);
+    uint8_t slot = s_next_slot;
+    ArchiveEntry* stored = &s_entries[slot];
+    stored->id = 0;     // Hidden from readers while the slot is rewritten
+
+    SlotWriter writer = {s_arena + (size_t)slot * ARCHIVE_SLOT_SIZE, 0};
+    bool encoded = false;
+    for (size_t i = 0; i < sizeof(QUALITIES) && !encoded; i++) {
+        writer.size = 0;
+        encoded = fmt2jpg_cb((uint8_t*)thumb->pixels, (size_t)thumb->width * thumb->height,
+                             thumb->width, thumb->height, PIXFORMAT_GRAYSCALE, QUALITIES[i],
+                             slotWrite, &writer);
+    }
+
+    if (encoded) {
+        *stored = *entry;
+        stored->width = thumb->width;
+        stored->height = thumb->height;
+        stored->size = writer.size;
+        stored->id = s_next_id++;
+        s_next_slot = (slot + 1) % ARCHIVE_SLOTS;
+    }
+    portSemGive(s_lock);
+    return encoded;
+}
+
+// MARK: Read
+uint8_t archiveList(ArchiveEntry* entries) {
+    if (!s_arena || !entries) {
+        return 0;
+    }
+    uint8_t count = 0;
+    portSemTake(s_lock);
+    for (uint8_t i = 0; i < ARCHIVE_SLOTS; i++) {
+        const ArchiveEntry* entry = &s_entries[(s_next_slot + i) % ARCHIVE_SLOTS];
+        if (entry->id != 0) {
+            entries[count++] = *entry;
+        }
+    }
+    portSemGive(s_lock);
+    return count;
+}
+
+/**
+ * Copy a stored image into the export buffer
+ * @return true if the id is still in the archive
+ */
+static bool copyOut(uint32_t id, ArchiveEntry* entry) {
+    bool found = false;
+    portSemTake(s_lock);
+    for (uint8_t slot = 0; slot < ARCHIVE_SLOTS && !found; slot++) {
+        if (s_entries[slot].id == id) {
+            *entry = s_entries[slot];
+            memcpy(s_export, s_arena + (size_t)slot * ARCHIVE_SLOT_SIZE, entry->size);
+            found = true;
+        }
+    }
+    portSemGive(s_lock);
+    return found;
+}
+
+bool archiveExportImage(uint32_t id, ArchiveWriter write, void* ctx) {
+    // Handlers run one at a time, so the single export buffer is not shared
+    ArchiveEntry entry;
+    if (!s_arena || !write || !copyOut(id, &entry)) {
+        return false;
+    }
+    return write(ctx, (const char*)s_export, entry.size);
+}
+
+// MARK: Tar
+static void tarHeader(char* block, const char* name, size_t size) {
+    memset(block, 0, TAR_BLOCK);
+    strncpy(block, name, 99);
+    memcpy(block + 100, "0000644", 7);                      // mode
+    memcpy(block + 108, "0000000", 7);                      // uid
+    memcpy(block + 116, "0000000", 7);                      // gid
+    snprintf(block + 124, 12, "%011lo", (unsigned long)size);
+    memcpy(block + 136, "00000000000", 11);                 // mtime, no wall clock
+    block[156] = '0';                                       // Regular file
+    memcpy(block + 257, "ustar", 6);
+    memcpy(block + 263, "00", 2);
+
+    // Checksum is computed with its own field as spaces
+    memset(block + 148, ' ', 8);
+    unsigned sum = 0;
+    for (size_t i = 0; i < TAR_BLOCK; i++) {
+        sum += (uint8_t)block[i];
+    }
+    snprintf(block + 148, 8, "%06o", sum);
+    block[155] = ' ';
+}
+
+static bool tarFile(const char* name, const char* data, size_t size, ArchiveWriter write, void* ctx) {
+    static const char zeros[TAR_BLOCK] = {0};
+    char header[TAR_BLOCK];
+    tarHeader(header, name, size);
+    size_t padding = (TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK;
+    return write(ctx, header, TAR_BLOCK) && (size == 0 || write(ctx, data, size)) &&
+           (padding == 0 || write(ctx, zeros, padding));
+}
+
+static void entryName(const ArchiveEntry* entry, char* out, size_t out_size) {
+    snprintf(out, out_size, "capture-%06lu-%s.jpg", (unsigned long)entry->id, wasteTypeName(entry->verdict));
+}
+
+bool archiveExportTar(ArchiveWriter write, void* ctx) {
+    static ArchiveEntry entries[ARCHIVE_SLOTS];
+    static char index[64 + ARCHIVE_SLOTS * INDEX_LINE_SIZE];
+    if (!s_arena || !write) {
+        return false;
+    }
+
+    // Index first, from one listing so it matches the files that follow
+    uint8_t count = archiveList(entries);
+    size_t len = snprintf(index, sizeof(index), "file,trigger_ms,latency_ms,verdict,capture_bytes\n");
+    char name[48];
+    for (uint8_t i = 0; i < count; i++) {
+        entryName(&entries[i], name, sizeof(name));
+        len += snprintf(index + len, sizeof(index) - len, "%s,%lu,%lu,%s,%lu\n", name,
+                        (unsigned long)entries[i].trigger_ms, (unsigned long)entries[i].latency_ms,
+                        wasteTypeName(entries[i].verdict), (unsigned long)entries[i].jpeg_len);
+    }
+    if (!tarFile("index.csv", index, len, write, ctx)) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        // Overwritten since the listing, leave it out
+        ArchiveEntry entry;
+        if (!copyOut(entries[i].id, &entry)) {
+            continue;
+        }
+        entryName(&entry, name, sizeof(name));
+        if (!tarFile(name, (const char*)s_export, entry.size, write, ctx)) {
+            return false;
+        }
+    }
+
+    // End of archive: two empty blocks
+    static const char zeros[2 * TAR_BLOCK] = {0};
+    return write(ctx, zeros, sizeof(zeros));
+}
@@ -0,0 +1,86 @@
+#ifndef CAPTURE_ARCHIVE_H
+#define CAPTURE_ARCHIVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "frame_analysis.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Recent captures kept in PSRAM for reviewing verdicts
+ *
+ * Each capture is stored as its 1/8-scale grayscale thumbnail, JPEG
+ * encoded into a fixed slot of one arena allocated at startup, so memory
+ * use never grows and the full-resolution frame is never touched. The
+ * oldest entry is overwritten once all slots are used.
+ */
+
+#define ARCHIVE_SLOTS      32
+#define ARCHIVE_SLOT_SIZE  (12 * 1024)
+
+typedef struct {
+    uint32_t id;            // Increases with every archived capture, 0 = empty slot
+    uint32_t trigger_ms;    // millis() at the trigger
+    uint32_t jpeg_len;      // Size of the full-resolution capture
+    uint32_t latency_ms;    // Trigger to result
+    uint16_t width;         // Of the thumbnail
+    uint16_t height;
+    uint16_t size;          // Of the stored thumbnail JPEG
+    uint8_t verdict;        // TYPE_* value
+} ArchiveEntry;
+
+/**
+ * Allocate the arena (ARCHIVE_SLOTS x ARCHIVE_SLOT_SIZE of PSRAM)
+ * @return true if successful, false if PSRAM is short
+ */
+bool archiveBegin(void);
+
+/**
+ * Encode a capture's thumbnail into the next slot
+ *
+ * Takes a few milliseconds for a 200x150 thumbnail; call it after the
+ * result is signalled.
+ *
+ * @param thumb Thumbnail of the capture
+ * @param entry Metadata; id, size, width and height are filled in
+ * @return true if archived
+ */
+bool archiveAdd(const Thumbnail* thumb, const ArchiveEntry* entry);
+
+/**
+ * Copy the metadata of every stored capture, oldest first
+ * @param entries Receives up to ARCHIVE_SLOTS entries
+ * @return Number of entries
+ */
+uint8_t archiveList(ArchiveEntry* entries);
+
+/**
+ * Receives archive output, returns false to stop
+ */
+typedef bool (*ArchiveWriter)(void* ctx, const char* data, size_t len);
+
+/**
+ * Write one stored thumbnail JPEG
+ * @return false if the id is no longer in the archive or the writer failed
+ */
+bool archiveExportImage(uint32_t id, ArchiveWriter write, void* ctx);
+
+/**
+ * Write the archive as a tar file: an index.csv, then one JPEG per capture
+ *
+ * Each image is copied out of its slot before sending, so a slow client
+ * never blocks archiveAdd for longer than a memcpy.
+ *
+ * @return false if the writer failed or the archive is not ready
+ */
+bool archiveExportTar(ArchiveWriter write, void* ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CAPTURE_ARCHIVE_H */
@@ -0,0 +1,257 @@
+#include "capture_log.h"
+#include "waste_classifier.h"
+#include "platform_port.h"
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <stdio.h>
+#include <string.h>
+
+static_assert(sizeof(CaptureLogRecord) == 32, "log records must stay 32 bytes");
+
+// MARK: Log Config
+static const uint8_t RECORD_VERSION = 1;
+static const uint8_t QUEUE_SIZE = 32;
+static const uint8_t FLUSH_BATCH = 8;               // Records per flash write
+static const uint32_t FLUSH_MAX_AGE_MS = 60000;     // Write a partial batch after this long
+static const uint8_t EXPORT_BATCH = 16;             // Records per read while exporting
+
+static const char* SEGMENT_PATHS[2] = {"/log/capture0.bin", "/log/capture1.bin"};
+
+static bool s_ready = false;
+static PortSem s_lock = NULL;
+
+static uint32_t s_next_sequence = 1;
+static uint16_t s_boot = 0;
+static uint8_t s_active = 0;
+static uint32_t s_active_records = 0;
+
+static CaptureLogRecord s_queue[QUEUE_SIZE];
+static uint8_t s_queue_head = 0;
+static uint8_t s_queue_count = 0;
+static uint32_t s_oldest_queued_at = 0;
+
+// MARK: Segments
+static uint32_t segmentRecords(uint8_t segment) {
+    File file = LittleFS.open(SEGMENT_PATHS[segment], "r");
+    if (!file) {
+        return 0;
+    }
+    uint32_t records = file.size() / sizeof(CaptureLogRecord);
+    file.close();
+    return records;
+}
+
+/**
+ * Read the last complete record of a segment
+ */
+static bool segmentLast(uint8_t segment, CaptureLogRecord* record) {
+    File file = LittleFS.open(SEGMENT_PATHS[segment], "r");
+    if (!file) {
+        return false;
+    }
+    uint32_t records = file.size() / sizeof(CaptureLogRecord);
+    bool ok = records > 0 && file.seek((records - 1) * sizeof(CaptureLogRecord)) &&
+              file.read((uint8_t*)record, sizeof(*record)) == sizeof(*record);
+    file.close();
+    return ok;
+}
+
+bool captureLogBegin(void) {
+    if (s_ready) {
+        return true;
+    }
+    if (!LittleFS.begin(true)) {
+        return false;
+    }
+    if (!LittleFS.exists("/log") && !LittleFS.mkdir("/log")) {
+        return false;
+    }
+    s_lock = portSemCreate(1);
+    if (!s_lock) {
+        return false;
+    }
+
+    // Resume after the newest record of either segment
+    CaptureLogRecord last[2];
+    bool found[2] = {segmentLast(0, &last[0]), segmentLast(1, &last[1])};
+    s_active = found[1] && (!found[0] || last[1].sequence > last[0].sequence) ? 1 : 0;
+    if (found[s_active]) {
+        s_next_sequence = last[s_active].sequence + 1;
+        s_boot = last[s_active].boot + 1;
+    }
+    s_active_records = segmentRecords(s_active);
+
+    s_ready = true;
+    return true;
+}
+
+// MARK: Append
+void captureLogAppend(const CaptureLogRecord* record) {
+    if (!s_ready || !record) {
+        return;
+    }
+    portSemTake(s_lock);
+    if (s_queue_count == QUEUE_SIZE) {
+        s_queue_head = (s_queue_head + 1) % QUEUE_SIZE;
+        s_queue_count--;
+    }
+    if (s_queue_count == 0) {
+        s_oldest_queued_at = millis();
+    }
+
+    CaptureLogRecord* slot = &s_queue[(s_queue_head + s_queue_count) % QUEUE_SIZE];
+    *slot = *record;
+    slot->sequence = s_next_sequence++;
+    slot->boot = s_boot;
+    slot->version = RECORD_VERSION;
+    slot->reserved = 0;
+    s_queue_count++;
+    portSemGive(s_lock);
+}
+
+void captureLogFlush(bool force) {
+    if (!s_ready || s_queue_count == 0) {
+        return;
+    }
+    if (!force && s_queue_count < FLUSH_BATCH && millis() - s_oldest_queued_at < FLUSH_MAX_AGE_MS) {
+        return;
+    }
+
+    portSemTake(s_lock);
+    while (s_queue_count > 0) {
+        const char* mode = "a";
+        if (s_active_records >= CAPTURE_LOG_SEGMENT_RECORDS) {
+            // Retire the older segment
+            s_active ^= 1;
+            s_active_records = 0;
+            mode = "w";
+        }
+
+        // Contiguous run of the queue that fits in the segment
+        uint32_t run = s_queue_count;
+        if (s_queue_head + run > QUEUE_SIZE) {
+            run = QUEUE_SIZE - s_queue_head;
+        }
+        if (run > CAPTURE_LOG_SEGMENT_RECORDS - s_active_records) {
+            run = CAPTURE_LOG_SEGMENT_RECORDS - s_active_records;
+        }
+
+        File file = LittleFS.open(SEGMENT_PATHS[s_active], mode);
+        if (!file) {
+            break;
+        }
+        size_t bytes = run * sizeof(CaptureLogRecord);
+        size_t written = file.write((const uint8_t*)&s_queue[s_queue_head], bytes);
+        file.close();
+
+        uint32_t records = written / sizeof(CaptureLogRecord);
+        s_active_records += records;
+        s_queue_head = (s_queue_head + records) % QUEUE_SIZE;
+        s_queue_count -= records;
+        if (written != bytes) {
+            break;  // Filesystem full, try again later
+        }
+    }
+    s_oldest_queued_at = millis();
+    portSemGive(s_lock);
+}
+
+// MARK: Export
+static const char* CSV_HEADER = "sequence,boot,trigger_ms,capture_ms,analysis_ms,request_ms,total_ms,"
+                                "jpeg_bytes,verdict,http_status,sharpness,rssi,flags,source\n";
+
+static size_t formatRecord(const CaptureLogRecord* record, char* out, size_t out_size) {
+    char flags[64] = "";
+    if (record->flags & CAPTURE_LOG_LOCAL) strcat(flags, "local;");
+    if (record->flags & CAPTURE_LOG_DEGRADED) strcat(flags, "degraded;");
+    if (record->flags & CAPTURE_LOG_CACHED) strcat(flags, "cached;");
+    if (record->flags & CAPTURE_LOG_DOWNGRADED) strcat(flags, "downgraded;");
+    if (record->flags & CAPTURE_LOG_REQUERIED) strcat(flags, "requeried;");
+    if (record->flags & CAPTURE_LOG_RECAPTURED) strcat(flags, "recaptured;");
+    size_t flags_len = strlen(flags);
+    if (flags_len > 0) {
+        flags[flags_len - 1] = '\0';
+    }
+
+    int len = snprintf(out, out_size, "%lu,%u,%lu,%u,%u,%u,%u,%lu,%s,%d,%u,%d,%s,%u\n",
+                       (unsigned long)record->sequence, (unsigned)record->boot,
+                       (unsigned long)record->trigger_ms, (unsigned)record->capture_ms,
+                       (unsigned)record->analysis_ms, (unsigned)record->request_ms,
+                       (unsigned)record->total_ms, (unsigned long)record->jpeg_len,
+                       wasteTypeName(record->verdict), (int)record->http_status,
+                       (unsigned)record->sharpness, (int)record->rssi, flags, (unsigned)record->source);
+    return len < 0 || (size_t)len >= out_size ? 0 : (size_t)len;
+}
+
+/**
+ * Format and write records newer than *last_sequence
+ */
+static bool exportRecords(const CaptureLogRecord* records, size_t count, uint32_t* last_sequence,
+                          CaptureLogWriter write, void* ctx) {
+    static char csv[EXPORT_BATCH * 128];
+    size_t len = 0;
+    for (size_t i = 0; i < count; i++) {
+        // A segment switch mid-export can replay records, skip them
+        if (records[i].sequence <= *last_sequence) {
+            continue;
+        }
+        *last_sequence = records[i].sequence;
+        len += formatRecord(&records[i], csv + len, sizeof(csv) - len);
+    }
+    return len == 0 || write(ctx, csv, len);
+}
+
+bool captureLogExportCsv(CaptureLogWriter write, void* ctx) {
+    if (!s_ready || !write) {
+        return false;
+    }
+    if (!write(ctx, CSV_HEADER, strlen(CSV_HEADER))) {
+        return false;
+    }
+
+    CaptureLogRecord records[EXPORT_BATCH];
+    uint32_t last_sequence = 0;
+
+    // Older segment first, a few records per lock so flushes can interleave
+    portSemTake(s_lock);
+    uint8_t order[2] = {(uint8_t)(s_active ^ 1), s_active};
+    portSemGive(s_lock);
+    for (uint8_t i = 0; i < 2; i++) {
+        for (size_t offset = 0;; offset += sizeof(records)) {
+            portSemTake(s_lock);
+            size_t count = 0;
+            File file = LittleFS.open(SEGMENT_PATHS[order[i]], "r");
+            if (file && file.seek(offset)) {
+                count = file.read((uint8_t*)records, sizeof(records)) / sizeof(CaptureLogRecord);
+            }
+            if (file) {
+                file.close();
+            }
+            portSemGive(s_lock);
+
+            if (count == 0) {
+                break;
+            }
+            if (!exportRecords(records, count, &last_sequence, write, ctx)) {
+                return false;
+            }
+        }
+    }
+
+    // Records not yet flushed (handlers run one at a time, so a static copy is safe)
+    static CaptureLogRecord queued[QUEUE_SIZE];
+    portSemTake(s_lock);
+    uint8_t queued_count = s_queue_count;
+    for (uint8_t i = 0; i < queued_count; i++) {
+        queued[i] = s_queue[(s_queue_head + i) % QUEUE_SIZE];
+    }
+    portSemGive(s_lock);
+
+    for (uint8_t i = 0; i < queued_count; i += EXPORT_BATCH) {
+        uint8_t count = queued_count - i < EXPORT_BATCH ? queued_count - i : EXPORT_BATCH;
+        if (!exportRecords(&queued[i], count, &last_sequence, write, ctx)) {
+            return false;
+        }
+    }
+    return true;
+}
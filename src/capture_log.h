@@ -0,0 +1,95 @@
+#ifndef CAPTURE_LOG_H
+#define CAPTURE_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Persistent history of classifications
+ *
+ * Fixed-size records are queued in RAM and appended to two segment files
+ * on LittleFS (which levels wear across the partition). When the active
+ * segment is full the other one is truncated and takes over, so the log
+ * keeps the most recent 2 x CAPTURE_LOG_SEGMENT_RECORDS records.
+ */
+
+#ifndef CAPTURE_LOG_SEGMENT_RECORDS
+#define CAPTURE_LOG_SEGMENT_RECORDS 2048    // 64 KB per segment
+#endif
+
+// Record flags
+#define CAPTURE_LOG_LOCAL     0x01  // Decided on-device without a request
+#define CAPTURE_LOG_DEGRADED  0x02  // Local guess because the quota was exhausted
+#define CAPTURE_LOG_CACHED    0x04  // Request referenced the context cache
+#define CAPTURE_LOG_DOWNGRADED 0x08 // Sent a downscaled frame because the link was slow
+#define CAPTURE_LOG_REQUERIED 0x10  // Asked again because the first answer was unsure
+#define CAPTURE_LOG_RECAPTURED 0x20 // Took a new frame for the second request
+
+typedef struct {
+    uint32_t sequence;      // Increases across reboots
+    uint32_t trigger_ms;    // millis() at the trigger
+    uint32_t jpeg_len;      // 0 if the capture failed
+    uint16_t boot;          // Boot counter
+    uint16_t capture_ms;    // Trigger to frame ready
+    uint16_t analysis_ms;   // Thumbnail checks
+    uint16_t request_ms;    // Backend round trip, 0 without a request
+    uint16_t total_ms;      // Trigger to result signalled
+    int16_t http_status;    // 0 without a request
+    uint16_t sharpness;     // thumbnailSharpness of the capture
+    uint8_t verdict;        // TYPE_* value
+    uint8_t flags;          // CAPTURE_LOG_* bits
+    int8_t rssi;            // WiFi signal at the result, dBm
+    uint8_t version;
+    uint8_t source;         // Camera, 0 for the controller's own (see frame_source.h)
+    uint8_t reserved;
+} CaptureLogRecord;
+
+/**
+ * Mount the filesystem and resume the sequence and boot counters
+ * @return true if the log is ready
+ */
+bool captureLogBegin(void);
+
+/**
+ * Queue a record; sequence, boot and version are filled in
+ *
+ * Only touches RAM. If the queue is full the oldest queued record is
+ * dropped rather than blocking the capture loop.
+ */
+void captureLogAppend(const CaptureLogRecord* record);
+
+/**
+ * Write queued records to flash once enough have accumulated or they are old
+ *
+ * Flash writes stall both cores' caches, so call this from the capture
+ * loop while idle.
+ *
+ * @param force Write whatever is queued
+ */
+void captureLogFlush(bool force);
+
+/**
+ * Receives CSV output, returns false to stop
+ */
+typedef bool (*CaptureLogWriter)(void* ctx, const char* data, size_t len);
+
+/**
+ * Write the whole log as CSV, oldest first, including queued records
+ *
+ * Safe from another task: flash is read a few records at a time so the
+ * capture loop is never held up for long.
+ *
+ * @return false if the writer stopped early or the log is not ready
+ */
+bool captureLogExportCsv(CaptureLogWriter write, void* ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CAPTURE_LOG_H */
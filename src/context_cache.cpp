@@ -0,0 +1,72 @@
+#include "context_cache.h"
+#include "vision_client.h"
+#include "platform_port.h"
+#include <stdio.h>
+
+// MARK: Cache Config
+static const uint32_t REFRESH_MARGIN_MS = 120000;   // Recreate this long before expiry
+static const uint32_t RETRY_INTERVAL_MS = 600000;   // After a failed creation
+
+static bool s_configured = false;
+static uint32_t s_ttl_sec = 0;
+static VisionContext s_inline;
+static VisionContext s_cached;
+
+static char s_name[128];
+static bool s_valid = false;
+static uint32_t s_expires_at = 0;
+static bool s_attempted = false;
+static uint32_t s_attempted_at = 0;
+
+void contextCacheConfigure(const char* instructions, const VisionExample* examples, uint8_t count, uint32_t ttl_sec) {
+    s_inline.instructions = instructions;
+    s_inline.examples = examples;
+    s_inline.example_count = count > VISION_MAX_EXAMPLES ? VISION_MAX_EXAMPLES : count;
+    s_inline.cache_name = NULL;
+
+    s_cached = s_inline;
+    s_cached.cache_name = s_name;
+
+    s_ttl_sec = ttl_sec;
+    s_valid = false;
+    s_attempted = false;
+    s_configured = instructions != NULL;
+}
+
+// MARK: Lookup
+static bool cacheFresh(void) {
+    return s_valid && (int32_t)(s_expires_at - REFRESH_MARGIN_MS - millis()) > 0;
+}
+
+const VisionContext* contextCacheCurrent(void) {
+    if (!s_configured) {
+        return NULL;
+    }
+    return cacheFresh() ? &s_cached : &s_inline;
+}
+
+void contextCacheInvalidate(void) {
+    s_valid = false;
+}
+
+// MARK: Maintenance
+void contextCacheMaintain(const char* api_key) {
+    if (!s_configured || !api_key || cacheFresh()) {
+        return;
+    }
+    if (s_attempted && millis() - s_attempted_at < RETRY_INTERVAL_MS) {
+        return;
+    }
+
+    char ttl[16];
+    snprintf(ttl, sizeof(ttl), "%lus", (unsigned long)s_ttl_sec);
+    s_attempted = true;
+    s_attempted_at = millis();
+
+    // The expiry counts from when the upload started, to stay on the safe side
+    s_valid = visionCreateCache(&s_inline, ttl, api_key, s_name, sizeof(s_name));
+    if (s_valid) {
+        s_expires_at = s_attempted_at + s_ttl_sec * 1000;
+        s_attempted = false;
+    }
+}
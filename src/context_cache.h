@@ -0,0 +1,55 @@
+#ifndef CONTEXT_CACHE_H
+#define CONTEXT_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "vision_backend.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Server-side cache of the standing request context
+ *
+ * The instructions and few-shot example images are uploaded once as a
+ * Gemini cachedContent, and each classification only references it, so
+ * a request carries little more than the new image. Until the cache
+ * exists, once it is about to expire, or after the backend rejects it,
+ * requests carry the context inline instead.
+ */
+
+/**
+ * Set the context to cache
+ * @param instructions System instructions, must outlive the cache
+ * @param examples Labelled example images, must outlive the cache
+ * @param count Number of examples (at most VISION_MAX_EXAMPLES)
+ * @param ttl_sec Lifetime requested for each cache entry
+ */
+void contextCacheConfigure(const char* instructions, const VisionExample* examples, uint8_t count, uint32_t ttl_sec);
+
+/**
+ * @return Context for the next request, referencing the cache while it is valid (NULL if not configured)
+ */
+const VisionContext* contextCacheCurrent(void);
+
+/**
+ * Forget the cache entry, e.g. after the backend refused it
+ */
+void contextCacheInvalidate(void);
+
+/**
+ * Create the cache entry if it is missing or close to expiry
+ *
+ * Uploads the whole context when it does, so call it from the capture
+ * loop while idle. Cheap when there is nothing to do.
+ *
+ * @param api_key The backend API key
+ */
+void contextCacheMaintain(const char* api_key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONTEXT_CACHE_H */
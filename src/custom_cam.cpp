@@ -2,14 +2,13 @@
 #include <Arduino.h>
 #include "esp_camera.h"
 #include "driver/gpio.h"
-#include <WiFiClientSecure.h>
-
-// MARK: Base64 Encoding
-static const char base64_table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-
-// MARK: Gemini API Config
-static const char* GEMINI_HOST = "generativelanguage.googleapis.com";
-static const int GEMINI_PORT = 443;
+#include "esp_timer.h"
+#include "esp_jpg_decode.h"
+#include "jpeg_encode.h"
+#include "jpeg_dc.h"
+#include "exposure_lock.h"
+#include "sensor_profile.h"
+#include "vision_backend.h"
 
 // MARK: Camera Pins
 #define CAM_PIN_PWDN    32
@@ -62,7 +61,7 @@ bool initCamera(void) {
         .pixel_format = PIXFORMAT_JPEG,
         .frame_size = FRAMESIZE_UXGA,  // 1600x1200 UXGA for higher quality
         .jpeg_quality = 10,            // Good quality (0-63, lower is better)
-        .fb_count = 2,
+        .fb_count = 3,                 // Classifier plus preview clients sharing frames
         .fb_location = CAMERA_FB_IN_PSRAM,
         .grab_mode = CAMERA_GRAB_LATEST
     };
@@ -87,154 +86,283 @@ bool initCamera(void) {
         sensor->set_aec2(sensor, 1);           // Auto exposure correction on
     }
     
+    // From here on, mode switches go through the profile cache
+    sensorProfilesBegin();
+    
     return true;
 }
 
-// MARK: Static Capture
-camera_fb_t* captureStaticFrame() {
-    const uint32_t threshold = 100000;
-    const int max_attempts = 100;
-    // TODO: add motion detection
-    return esp_camera_fb_get();
+// MARK: Thumbnail
+// Decoder jobs start with the frame so they can share frameRead
+typedef struct {
+    const camera_fb_t* fb;
+    Thumbnail* thumb;
+} ThumbnailJob;
+
+static size_t frameRead(void* arg, size_t index, uint8_t* buf, size_t len) {
+    const camera_fb_t* fb = *(const camera_fb_t* const*)arg;
+    if (index >= fb->len) {
+        return 0;
+    }
+    if (index + len > fb->len) {
+        len = fb->len - index;
+    }
+    if (buf) {
+        memcpy(buf, fb->buf + index, len);
+    }
+    return len;
 }
 
-// MARK: Base64 Utils
-static size_t calculateBase64Length(size_t input_length) {
-    return ((input_length + 2) / 3 * 4) + 1;  // +1 for null terminator
+static bool thumbnailWrite(void* arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t* data) {
+    Thumbnail* thumb = ((ThumbnailJob*)arg)->thumb;
+    if (!data) {
+        // Start (x = y = 0, full output size) and end markers
+        if (x == 0 && y == 0) {
+            if (w > THUMB_MAX_WIDTH || h > THUMB_MAX_HEIGHT) {
+                return false;
+            }
+            thumb->width = w;
+            thumb->height = h;
+        }
+        return true;
+    }
+
+    // RGB888 block to luma, (r + 2g + b) / 4 works for either channel order
+    for (uint16_t row = 0; row < h && y + row < thumb->height; row++) {
+        uint8_t* out = thumb->pixels + (size_t)(y + row) * thumb->width + x;
+        const uint8_t* in = data + (size_t)row * w * 3;
+        for (uint16_t col = 0; col < w && x + col < thumb->width; col++, in += 3) {
+            out[col] = (in[0] + 2 * in[1] + in[2]) >> 2;
+        }
+    }
+    return true;
 }
 
-// MARK: Encode to JSON
-static size_t encodeToGeminiJson(
-    const uint8_t* input_data, 
-    size_t input_length, 
-    char* output_buffer, 
-    size_t output_buffer_size, 
-    const char* prompt,
-    const char* gemini_key) {
-    
-    if (!input_data || !output_buffer || input_length == 0) {
-        return 0;
+bool frameThumbnail(const camera_fb_t* fb, Thumbnail* thumb) {
+    if (!fb || !thumb || fb->format != PIXFORMAT_JPEG) {
+        return false;
+    }
+    // Walk the Huffman stream for luma DC terms only, a few ms for UXGA
+    if (jpegDcThumbnail(fb->buf, fb->len, thumb)) {
+        return true;
     }
     
-    // JSON format template parts
-    const char* json_prefix = "{\n"
-        "  \"contents\":[\n"
-        "    {\n"
-        "      \"parts\":[\n"
-        "        {\"text\":\"";
-    
-    const char* prompt_suffix = "\"},\n"
-        "        {\"inline_data\":{\n"
-        "          \"mime_type\":\"image/jpeg\",\n"
-        "          \"data\":\"";
-    
-    const char* json_suffix = "\"\n"
-        "        }}\n"
-        "      ]\n"
-        "    }\n"
-        "  ],\n"
-        "  \"generationConfig\":{\n"
-        "    \"maxOutputTokens\":5,\n"
-        "    \"temperature\":1\n"
-        "  }\n"
-        "}";
-    
-    // Calculate total size needed
-    size_t base64_length = calculateBase64Length(input_length) - 1;
-    size_t total_size = 
-        strlen(json_prefix) + 
-        strlen(prompt) + 
-        strlen(prompt_suffix) + 
-        base64_length + 
-        strlen(json_suffix) + 
-        1; // +1 for null terminator
-    
-    if (total_size > output_buffer_size) {
+    // Anything the DC extractor doesn't handle goes through the full decoder at 1/8 scale
+    ThumbnailJob job = {fb, thumb};
+    thumb->width = 0;
+    thumb->height = 0;
+    return esp_jpg_decode(fb->len, JPG_SCALE_8X, frameRead, thumbnailWrite, &job) == ESP_OK &&
+           thumb->width > 0;
+}
+
+// MARK: Downscale
+static const uint8_t DOWNSCALE_MIN_QUALITY = 20;    // Below this the classifier loses the material
+static const uint8_t DOWNSCALE_MAX_QUALITY = 85;
+
+// Decoded a strip at a time into the encoder, which codes each strip as it
+// fills, so neither the RGB image nor its coefficients are ever held whole.
+// Each quality step of the budget search decodes the frame again
+typedef struct {
+    const camera_fb_t* fb;
+    jpg_scale_t scale;
+    JpegStream stream;
+    uint8_t* strip;
+    uint8_t strip_rows;
+    uint8_t quality;
+    uint8_t* out;
+    size_t out_cap;
+} DownscaleJob;
+
+static bool downscaleWrite(void* arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t* data) {
+    DownscaleJob* job = (DownscaleJob*)arg;
+    JpegStream* stream = &job->stream;
+    if (!data) {
+        if (x == 0 && y == 0) {
+            if (!job->strip) {
+                stream->width = w;
+                stream->height = h;
+                stream->color = true;
+                job->strip_rows = jpegStripRows(true);
+                job->strip = (uint8_t*)ps_malloc((size_t)w * job->strip_rows * 3);
+                stream->coeffs = (int16_t*)ps_malloc(jpegCoefficientBytes(w, job->strip_rows, true));
+                if (!job->strip || !stream->coeffs) {
+                    return false;
+                }
+            }
+            return jpegStreamBegin(stream, job->quality, job->out, job->out_cap);
+        }
+        return true;
+    }
+
+    // Blocks come in raster order and their height divides the strip
+    uint16_t strip_y = y - y % job->strip_rows;
+    for (uint16_t row = 0; row < h && y + row < stream->height; row++) {
+        uint8_t* out = job->strip + ((size_t)(y - strip_y + row) * stream->width + x) * 3;
+        uint16_t cols = x + w <= stream->width ? w : stream->width - x;
+        memcpy(out, data + (size_t)row * w * 3, (size_t)cols * 3);
+    }
+    if (x + w >= stream->width && ((y + h) % job->strip_rows == 0 || y + h >= stream->height)) {
+        // Over budget aborts the decode, so failed steps stay cheap
+        return jpegStreamStrip(stream, job->strip);
+    }
+    return true;
+}
+
+static size_t downscaleAt(void* arg, uint8_t quality, uint8_t* out, size_t out_cap) {
+    DownscaleJob* job = (DownscaleJob*)arg;
+    job->quality = quality;
+    job->out = out;
+    job->out_cap = out_cap;
+    if (esp_jpg_decode(job->fb->len, job->scale, frameRead, downscaleWrite, job) != ESP_OK) {
         return 0;
     }
-    
-    // Build JSON output
-    char* pos = output_buffer;
-    
-    // Copy JSON prefix
-    strcpy(pos, json_prefix);
-    pos += strlen(json_prefix);
-    
-    // Copy prompt (escaping quotes)
-    for (const char* p = prompt; *p; p++) {
-        if (*p == '"' || *p == '\\') {
-            *pos++ = '\\';
+    return jpegStreamEnd(&job->stream);
+}
+
+uint8_t* frameDownscale(const camera_fb_t* fb, uint8_t level, size_t budget, size_t* out_len) {
+    if (!fb || !out_len || fb->format != PIXFORMAT_JPEG || level < 1 || level > 2) {
+        return NULL;
+    }
+    DownscaleJob job = {};
+    job.fb = fb;
+    job.scale = level == 1 ? JPG_SCALE_2X : JPG_SCALE_4X;
+    uint8_t* jpeg = (uint8_t*)ps_malloc(budget);
+    *out_len = jpeg ? jpegSearchQuality(downscaleAt, &job, budget, DOWNSCALE_MIN_QUALITY, DOWNSCALE_MAX_QUALITY,
+                                        jpeg, NULL) : 0;
+    if (*out_len == 0) {
+        free(jpeg);
+        jpeg = NULL;
+    }
+    free(job.strip);
+    free(job.stream.coeffs);
+    return jpeg;
+}
+
+// MARK: Static Capture
+static Thumbnail* s_thumbs[2] = {NULL, NULL};
+static const Thumbnail* s_last_thumb = NULL;
+static int64_t s_fresh_after_us = 0;    // Frames that started earlier are dropped, 0 for none
+static const int STALE_FRAMES_MAX = 4;  // fb_count plus the one being read out
+
+const Thumbnail* lastCaptureThumbnail(void) {
+    return s_last_thumb;
+}
+
+// Next frame, skipping the ones queued before s_fresh_after_us
+static camera_fb_t* grabFreshFrame(void) {
+    for (int i = 0; i < STALE_FRAMES_MAX; i++) {
+        camera_fb_t* fb = esp_camera_fb_get();
+        if (!fb) {
+            return NULL;
+        }
+        int64_t started = (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+        if (started >= s_fresh_after_us) {
+            return fb;
         }
-        *pos++ = *p;
+        esp_camera_fb_return(fb);
     }
+    return esp_camera_fb_get();
+}
+
+camera_fb_t* captureStaticFrame() {
+    const uint8_t threshold = 3;  // Mean pixel change between frames that still counts as static
+    const int max_attempts = 6;
     
-    // Copy prompt suffix
-    strcpy(pos, prompt_suffix);
-    pos += strlen(prompt_suffix);
-    
-    // Encode image data to Base64
-    size_t i;
-    uint32_t a, b, c;
+    // Thumbnails live in PSRAM, allocated on first use
+    for (int i = 0; i < 2; i++) {
+        if (!s_thumbs[i]) s_thumbs[i] = (Thumbnail*)ps_malloc(sizeof(Thumbnail));
+    }
+    s_last_thumb = NULL;
+    if (!s_thumbs[0] || !s_thumbs[1]) {
+        return grabFreshFrame();
+    }
     
-    for (i = 0; i < input_length; i += 3) {
-        a = i < input_length ? input_data[i] : 0;
-        b = (i + 1) < input_length ? input_data[i + 1] : 0;
-        c = (i + 2) < input_length ? input_data[i + 2] : 0;
+    camera_fb_t* fb = NULL;
+    Thumbnail* previous = NULL;
+    for (int attempt = 0; attempt < max_attempts; attempt++) {
+        if (fb) esp_camera_fb_return(fb);
+        fb = grabFreshFrame();
+        if (!fb) {
+            return NULL;
+        }
         
-        uint32_t triple = (a << 16) | (b << 8) | c;
+        Thumbnail* current = s_thumbs[attempt & 1];
+        if (!frameThumbnail(fb, current)) {
+            return fb;  // Can't judge, use the frame as is
+        }
+        s_last_thumb = current;
         
-        *pos++ = base64_table[(triple >> 18) & 0x3F];
-        *pos++ = base64_table[(triple >> 12) & 0x3F];
-        *pos++ = (i + 1) < input_length ? base64_table[(triple >> 6) & 0x3F] : '=';
-        *pos++ = (i + 2) < input_length ? base64_table[triple & 0x3F] : '=';
+        if (previous && thumbnailDifference(previous, current) <= threshold) {
+            break;
+        }
+        previous = current;
     }
-    
-    // Copy JSON suffix
-    strcpy(pos, json_suffix);
-    pos += strlen(json_suffix);
-    
-    return pos - output_buffer;
+    return fb;
 }
 
-// MARK: Capture Image
-char* captureImageAsGeminiJson(const char* prompt, size_t* encoded_size, const char* gemini_key) {
-    if (!prompt || !gemini_key) {
-        return NULL;
-    }
-    
-    // Turn on flash
+// MARK: Flash Capture
+static const uint32_t CONVERGE_TIMEOUT_MS = 1500;
+static const int64_t FLASH_RISE_US = 15000;     // LED rise plus the first rows' exposure
+
+camera_fb_t* captureFlashFrame(void) {
+    // Classify settings and the learned exposure in one batch, while the flash is still off
+    SensorReg lock[EXPOSURE_LOCK_REGS];
+    size_t lock_count = exposureLock(lock);
+    sensorProfileApply(SENSOR_PROFILE_CLASSIFY, lock, lock_count);
+    bool locked = lock_count > 0;
     digitalWrite(FLASH_GPIO_PIN, HIGH);
-    delay(75);  // Wait for flash to stabilize
-    
-    // Capture frame
+    uint32_t flash_on = millis();
+
+    if (locked) {
+        // Exposure is already right, only frames started under the flash are needed
+        s_fresh_after_us = esp_timer_get_time() + FLASH_RISE_US;
+    } else {
+        exposureConverge(CONVERGE_TIMEOUT_MS);
+    }
     camera_fb_t* fb = captureStaticFrame();
-    
-    // Turn off flash immediately
+    s_fresh_after_us = 0;
+
+    // Check the frame and restore auto mode before the light changes again
+    exposureRelease(fb ? s_last_thumb : NULL, millis() - flash_on);
+    sensorProfileApply(SENSOR_PROFILE_PREVIEW, NULL, 0);
     digitalWrite(FLASH_GPIO_PIN, LOW);
     
     if (!fb || fb->format != PIXFORMAT_JPEG) {
         if (fb) esp_camera_fb_return(fb);
         return NULL;
     }
+    return fb;
+}
+
+// MARK: Encode Frame
+char* encodeFrameAsGeminiJson(const camera_fb_t* fb, const char* prompt, size_t* encoded_size) {
+    if (!fb || !prompt) {
+        return NULL;
+    }
     
-    // Calculate output size needed
-    size_t base64_len = calculateBase64Length(fb->len);
-    size_t json_overhead = 500; 
-    size_t prompt_len = strlen(prompt) * 2;
-    size_t buffer_size = base64_len + json_overhead + prompt_len;
+    // Set up the request body encoder for the selected backend, or Gemini's when
+    // a controller takes bare JPEGs, so the web page still gets a JSON body
+    static const VisionBackend GEMINI_BACKEND = visionGeminiBackend(NULL);
+    const VisionBackend* backend = visionGetBackend();
+    if (strcmp(backend->ops->content_type, "application/json") != 0) {
+        backend = &GEMINI_BACKEND;
+    }
+    VisionRequest request = {prompt, fb->buf, fb->len, NULL, NULL, false};
+    VisionEncoder encoder;
+    if (!visionEncoderInit(&encoder, backend, &request)) {
+        return NULL;
+    }
+    size_t json_len = visionEncoderLength(&encoder);
     
     // Allocate buffer for JSON output
-    char* json_buffer = (char*)malloc(buffer_size);
+    char* json_buffer = (char*)malloc(json_len + 1);
     if (!json_buffer) {
-        esp_camera_fb_return(fb);
         return NULL;
     }
     
     // Encode to JSON
-    size_t json_len = encodeToGeminiJson(fb->buf, fb->len, json_buffer, buffer_size, prompt, gemini_key);
-    
-    // Free the camera frame buffer
-    esp_camera_fb_return(fb);
+    json_len = visionEncoderRead(&encoder, json_buffer, json_len);
+    json_buffer[json_len] = '\0';
     
     if (json_len == 0) {
         free(json_buffer);
@@ -249,85 +377,20 @@ char* captureImageAsGeminiJson(const char* prompt, size_t* encoded_size, const c
     return json_buffer;
 }
 
-// MARK: Gemini API
-char* sendToGeminiAPI(const char* json_payload, const char* gemini_key) {
-    if (!json_payload || !gemini_key) {
+// MARK: Capture Image
+char* captureImageAsGeminiJson(const char* prompt, size_t* encoded_size, const char* gemini_key) {
+    if (!prompt || !gemini_key) {
         return NULL;
     }
     
-    // Create secure client
-    WiFiClientSecure client;
-    client.setInsecure(); // Skip certificate validation
-    
-    // Connect to Gemini API
-    if (!client.connect(GEMINI_HOST, GEMINI_PORT)) {
+    camera_fb_t* fb = captureFlashFrame();
+    if (!fb) {
         return NULL;
     }
     
-    // Build API URL
-    char url[256];
-    snprintf(url, sizeof(url), 
-             "/v1beta/models/gemini-2.0-flash-lite:generateContent?key=%s", 
-             gemini_key);
-    
-    // Calculate payload length
-    size_t payload_len = strlen(json_payload);
-    
-    // Build HTTP request
-    client.printf("POST %s HTTP/1.1\r\n", url);
-    client.printf("Host: %s\r\n", GEMINI_HOST);
-    client.println("Content-Type: application/json");
-    client.printf("Content-Length: %u\r\n", payload_len);
-    client.println("Connection: close");
-    client.println();
-    
-    // Send payload in chunks
-    const size_t CHUNK_SIZE = 1024;
-    const char* pos = json_payload;
-    size_t remaining = payload_len;
-    
-    while (remaining > 0) {
-        size_t chunk = remaining > CHUNK_SIZE ? CHUNK_SIZE : remaining;
-        size_t sent = client.write((const uint8_t*)pos, chunk);
-        if (sent == 0) {
-            client.stop();
-            return NULL;
-        }
-        
-        pos += sent;
-        remaining -= sent;
-        delay(1);
-    }
-    
-    // Wait for response with timeout
-    unsigned long timeout = millis();
-    while (client.connected() && !client.available()) {
-        if (millis() - timeout > 10000) {
-            client.stop();
-            return NULL;
-        }
-        delay(100);
-    }
-    
-    // Skip HTTP headers
-    while (client.connected()) {
-        String line = client.readStringUntil('\n');
-        if (line == "\r") {
-            break;
-        }
-    }
-    
-    // Read response body
-    String response = client.readString();
-    client.stop();
+    char* json_buffer = encodeFrameAsGeminiJson(fb, prompt, encoded_size);
     
-    // Allocate buffer for response
-    char* response_buffer = (char*)malloc(response.length() + 1);
-    if (!response_buffer) {
-        return NULL;
-    }
-    
-    // Copy response
-    strcpy(response_buffer, response.c_str());
-    return response_buffer;
-}
\ No newline at end of file
+    // Free the camera frame buffer
+    esp_camera_fb_return(fb);
+    return json_buffer;
+}
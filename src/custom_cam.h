@@ -6,6 +6,8 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include "esp_camera.h"
+#include "vision_client.h"
+#include "frame_analysis.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -20,29 +22,71 @@ bool initCamera(void);
 /**
  * Capture a stable frame by detecting minimal changes between consecutive frames
  * 
- * This function temporarily disables auto-exposure to get stable frames
- * and returns the current frame when it's static enough
+ * Consecutive frames are compared on their 1/8-scale thumbnails, and the
+ * current frame is returned once it's static enough (or after a few
+ * attempts, so a busy scene can't stall the capture)
  * 
  * @return Pointer to captured frame buffer or NULL on failure (must be freed with esp_camera_fb_return())
  */
 camera_fb_t* captureStaticFrame(void);
 
 /**
- * Capture an image and convert it to a JSON payload for Gemini API
+ * Decode a 1/8-scale grayscale thumbnail from a JPEG frame
+ * @param fb JPEG frame
+ * @param thumb Receives the thumbnail (200x150 for UXGA)
+ * @return true if successful, false on error
+ */
+bool frameThumbnail(const camera_fb_t* fb, Thumbnail* thumb);
+
+/**
+ * Re-encode a JPEG frame at a lower resolution and the best quality that fits a budget
+ *
+ * Decoded at 1/2 or 1/4 scale straight into the encoder's DCT stage, then
+ * quantized at decreasing qualities until it fits. The frame itself is
+ * left untouched for the archive and the web page.
+ *
+ * @param fb JPEG frame
+ * @param level 1 for half scale (800x600 from UXGA), 2 for quarter scale
+ * @param budget Largest acceptable JPEG size
+ * @param out_len Receives the JPEG size
+ * @return JPEG data or NULL on error or if it cannot fit (must be freed with free())
+ */
+uint8_t* frameDownscale(const camera_fb_t* fb, uint8_t level, size_t budget, size_t* out_len);
+
+/**
+ * @return Thumbnail of the frame last returned by captureStaticFrame, NULL if it could not be decoded
+ */
+const Thumbnail* lastCaptureThumbnail(void);
+
+/**
+ * Turn on the flash, capture a JPEG frame and turn the flash off again
+ *
+ * Exposure and gain learned on an earlier flash capture are loaded before
+ * the flash goes on, so the first frame started under the flash is used;
+ * without a snapshot, auto exposure converges under the flash first
+ * (see exposure_lock.h)
+ *
+ * @return Pointer to captured frame buffer or NULL on failure (must be freed with esp_camera_fb_return())
+ */
+camera_fb_t* captureFlashFrame(void);
+
+/**
+ * Convert a captured JPEG frame to a JSON payload for the selected vision backend
+ * @param fb Frame from captureFlashFrame
  * @param prompt The text prompt to send to Gemini
  * @param encoded_size Optional pointer to receive the JSON size
- * @param gemini_key The Gemini API key
  * @return Pointer to the JSON payload (must be freed with free())
  */
-char* captureImageAsGeminiJson(const char* prompt, size_t* encoded_size, const char* gemini_key);
+char* encodeFrameAsGeminiJson(const camera_fb_t* fb, const char* prompt, size_t* encoded_size);
 
 /**
- * Send the image to Gemini API and get response
- * @param json_payload The JSON payload (from captureImageAsGeminiJson)
+ * Capture an image and convert it to a JSON payload for the selected vision backend
+ * @param prompt The text prompt to send to Gemini
+ * @param encoded_size Optional pointer to receive the JSON size
  * @param gemini_key The Gemini API key
- * @return Pointer to the response string (must be freed with free())
+ * @return Pointer to the JSON payload (must be freed with free())
  */
-char* sendToGeminiAPI(const char* json_payload, const char* gemini_key);
+char* captureImageAsGeminiJson(const char* prompt, size_t* encoded_size, const char* gemini_key);
 
 #ifdef __cplusplus
 }
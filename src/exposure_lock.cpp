@@ -0,0 +1,105 @@
+#include "exposure_lock.h"
+#include <Arduino.h>
+#include "esp_camera.h"
+
+// MARK: Lock Config
+static const uint8_t MEAN_MIN = 50;                         // Locked frames outside this band trigger relearning
+static const uint8_t MEAN_MAX = 210;
+static const uint32_t SNAPSHOT_MAX_AGE_MS = 30UL * 60 * 1000;   // The LED dims as it heats up
+static const uint32_t POLL_INTERVAL_MS = 30;                // About a frame at UXGA
+static const uint16_t SETTLED_DELTA = 4;                    // AEC change between polls that counts as settled
+static const uint8_t SETTLED_POLLS = 3;
+static const uint32_t UNKNOWN_SENSOR_SETTLE_MS = 75;        // Fixed wait when the registers can't be read
+
+// OV2640 sensor-bank registers (bank in the high byte, as get_reg/set_reg expect)
+#define OV2640_REG_GAIN   0x100
+#define OV2640_REG_REG04  0x104     // AEC[1:0]
+#define OV2640_REG_AEC    0x110     // AEC[9:2]
+#define OV2640_REG_COM8   0x113
+#define OV2640_REG_REG45  0x145     // AEC[15:10]
+
+#define COM8_AUTO         0x05      // AEC and AGC enable bits
+
+static ExposureStats s_stats = {};
+static uint32_t s_learned_at = 0;
+
+static sensor_t* knownSensor(void) {
+    sensor_t* sensor = esp_camera_sensor_get();
+    return sensor && sensor->id.PID == OV2640_PID ? sensor : NULL;
+}
+
+static uint16_t readAec(sensor_t* sensor) {
+    return (sensor->get_reg(sensor, OV2640_REG_REG45, 0x3F) << 10) |
+           (sensor->get_reg(sensor, OV2640_REG_AEC, 0xFF) << 2) |
+           sensor->get_reg(sensor, OV2640_REG_REG04, 0x03);
+}
+
+// MARK: State Machine
+size_t exposureLock(SensorReg* regs) {
+    if (s_stats.valid && millis() - s_learned_at > SNAPSHOT_MAX_AGE_MS) {
+        s_stats.valid = false;
+    }
+    if (!knownSensor() || !s_stats.valid) {
+        s_stats.state = EXPOSURE_LEARNING;
+        return 0;
+    }
+
+    // Manual mode first, or AEC would overwrite the values straight away
+    uint16_t aec = s_stats.aec;
+    regs[0] = {OV2640_REG_COM8, COM8_AUTO, 0};
+    regs[1] = {OV2640_REG_REG45, 0x3F, (uint8_t)(aec >> 10)};
+    regs[2] = {OV2640_REG_AEC, 0xFF, (uint8_t)(aec >> 2)};
+    regs[3] = {OV2640_REG_REG04, 0x03, (uint8_t)(aec & 0x03)};
+    regs[4] = {OV2640_REG_GAIN, 0xFF, s_stats.gain};
+    s_stats.state = EXPOSURE_LOCKED;
+    s_stats.locked++;
+    return EXPOSURE_LOCK_REGS;
+}
+
+void exposureConverge(uint32_t timeout_ms) {
+    if (s_stats.state != EXPOSURE_LEARNING) {
+        return;
+    }
+    sensor_t* sensor = knownSensor();
+    if (!sensor) {
+        delay(UNKNOWN_SENSOR_SETTLE_MS);
+        return;
+    }
+
+    uint32_t start = millis();
+    uint16_t previous = readAec(sensor);
+    uint8_t settled = 0;
+    while (settled < SETTLED_POLLS && millis() - start < timeout_ms) {
+        delay(POLL_INTERVAL_MS);
+        uint16_t aec = readAec(sensor);
+        settled = abs((int)aec - (int)previous) <= SETTLED_DELTA ? settled + 1 : 0;
+        previous = aec;
+    }
+
+    // Taken even on timeout; the captured frame decides whether it is kept
+    s_stats.aec = previous;
+    s_stats.gain = sensor->get_reg(sensor, OV2640_REG_GAIN, 0xFF);
+    s_stats.valid = true;
+    s_stats.learned++;
+    s_learned_at = millis();
+}
+
+void exposureRelease(const Thumbnail* thumb, uint32_t settle_ms) {
+    s_stats.last_settle_ms = settle_ms;
+    if (s_stats.state == EXPOSURE_AUTO) {
+        return;
+    }
+    if (!thumb) {
+        s_stats.valid = false;
+    } else {
+        uint8_t mean = thumbnailMean(thumb);
+        if (mean < MEAN_MIN || mean > MEAN_MAX) {
+            s_stats.valid = false;
+        }
+    }
+    s_stats.state = EXPOSURE_AUTO;
+}
+
+ExposureStats exposureGetStats(void) {
+    return s_stats;
+}
@@ -0,0 +1,82 @@
+#ifndef EXPOSURE_LOCK_H
+#define EXPOSURE_LOCK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "frame_analysis.h"
+#include "sensor_profile.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Exposure and gain locking for flash captures
+ *
+ * Auto exposure and gain stay on between captures for the preview stream.
+ * The first flash capture runs them under the flash until the exposure
+ * register settles and snapshots the converged values (learning). Later
+ * captures switch AEC/AGC off and load the snapshot before the flash goes
+ * on, so the first frame exposed under the flash is usable (locked). The
+ * lock is a handful of registers applied together with the classify
+ * profile, and switching back to the preview profile after the capture
+ * restores auto mode (see sensor_profile.h). The snapshot is learned again
+ * when a locked frame comes out too dark or too bright, or after a while.
+ *
+ * Only the OV2640 registers are known; other sensors always take the
+ * learning path.
+ */
+
+typedef enum {
+    EXPOSURE_AUTO = 0,      // Between captures
+    EXPOSURE_LEARNING,      // Flash on, waiting for AEC/AGC to converge
+    EXPOSURE_LOCKED,        // Flash on, snapshot loaded
+} ExposureState;
+
+/**
+ * Counters and the current snapshot, for /status
+ */
+typedef struct {
+    ExposureState state;
+    bool valid;             // A snapshot is loaded for the next capture
+    uint16_t aec;           // Exposure, in sensor line periods
+    uint8_t gain;           // Raw gain register
+    uint32_t learned;       // Snapshots taken
+    uint32_t locked;        // Captures taken with a snapshot
+    uint32_t last_settle_ms;// Flash on to usable frame, last capture
+} ExposureStats;
+
+#define EXPOSURE_LOCK_REGS 5
+
+/**
+ * Start a flash capture
+ * @param regs Receives EXPOSURE_LOCK_REGS registers that load the snapshot; apply them with
+ *             the classify profile before the flash goes on
+ * @return Registers written to regs, 0 if auto mode must converge (learning)
+ */
+size_t exposureLock(SensorReg* regs);
+
+/**
+ * Wait for AEC/AGC to settle under the flash, then snapshot them (learning only)
+ * @param timeout_ms Longest wait
+ */
+void exposureConverge(uint32_t timeout_ms);
+
+/**
+ * Check the captured frame, dropping a snapshot that didn't expose it well
+ * @param thumb Thumbnail of the captured frame, NULL if there is none
+ * @param settle_ms Flash on to usable frame
+ */
+void exposureRelease(const Thumbnail* thumb, uint32_t settle_ms);
+
+/**
+ * @return Snapshot of the stats
+ */
+ExposureStats exposureGetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EXPOSURE_LOCK_H */
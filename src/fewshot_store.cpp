@@ -0,0 +1,79 @@
+#include "fewshot_store.h"
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <string.h>
+
+// MARK: Store Config
+static const size_t MAX_EXAMPLE_SIZE = 200 * 1024;  // Keep the cache upload reasonable
+static const size_t MAX_LABEL_LENGTH = 24;
+
+static char s_labels[VISION_MAX_EXAMPLES][MAX_LABEL_LENGTH];
+
+/**
+ * "paper_2.jpg" -> "paper"
+ * @return true if the name is a JPEG with a usable label
+ */
+static bool labelFromName(const char* name, char* label, size_t label_size) {
+    const char* base = strrchr(name, '/');
+    base = base ? base + 1 : name;
+
+    const char* ext = strrchr(base, '.');
+    if (!ext || (strcasecmp(ext, ".jpg") != 0 && strcasecmp(ext, ".jpeg") != 0)) {
+        return false;
+    }
+    const char* end = ext;
+    const char* underscore = strrchr(base, '_');
+    if (underscore && underscore < ext) {
+        end = underscore;
+    }
+
+    size_t len = end - base;
+    if (len == 0 || len >= label_size) {
+        return false;
+    }
+    memcpy(label, base, len);
+    label[len] = '\0';
+    return true;
+}
+
+// MARK: Load
+uint8_t fewShotLoad(const char* dir, VisionExample* examples, uint8_t max_examples) {
+    if (!dir || !examples) {
+        return 0;
+    }
+    if (max_examples > VISION_MAX_EXAMPLES) {
+        max_examples = VISION_MAX_EXAMPLES;
+    }
+    if (!LittleFS.begin(false)) {
+        return 0;
+    }
+
+    File root = LittleFS.open(dir);
+    if (!root || !root.isDirectory()) {
+        return 0;
+    }
+
+    uint8_t count = 0;
+    for (File file = root.openNextFile(); file && count < max_examples; file = root.openNextFile()) {
+        size_t size = file.size();
+        if (file.isDirectory() || size == 0 || size > MAX_EXAMPLE_SIZE ||
+            !labelFromName(file.name(), s_labels[count], MAX_LABEL_LENGTH)) {
+            continue;
+        }
+
+        uint8_t* image = (uint8_t*)ps_malloc(size);
+        if (!image) {
+            break;
+        }
+        if (file.read(image, size) != size) {
+            free(image);
+            continue;
+        }
+
+        examples[count].label = s_labels[count];
+        examples[count].image = image;
+        examples[count].image_len = size;
+        count++;
+    }
+    return count;
+}
@@ -0,0 +1,29 @@
+#ifndef FEWSHOT_STORE_H
+#define FEWSHOT_STORE_H
+
+#include <stdint.h>
+#include "vision_backend.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Load labelled example images from LittleFS
+ *
+ * Files are named after their label, optionally with a numeric suffix:
+ * /fewshot/plastic.jpg, /fewshot/paper_2.jpg. Upload them with
+ * "pio run -t uploadfs" from the data/ directory.
+ *
+ * @param dir Directory to scan, e.g. "/fewshot"
+ * @param examples Receives the examples; images are kept in PSRAM for the program's lifetime
+ * @param max_examples Capacity of examples (at most VISION_MAX_EXAMPLES are used)
+ * @return Number of examples loaded, 0 if the directory is missing or empty
+ */
+uint8_t fewShotLoad(const char* dir, VisionExample* examples, uint8_t max_examples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FEWSHOT_STORE_H */
@@ -0,0 +1,135 @@
+#include "frame_analysis.h"
+#include <stdlib.h>
+#include <string.h>
+
+// MARK: Analysis Config
+static const uint8_t BACKGROUND_MIN_SAMPLES = 2;    // Empty verdicts before the model is trusted
+static const uint8_t BACKGROUND_PIXEL_DIFF = 24;    // A pixel this far from the background has changed
+static const uint16_t BACKGROUND_MAX_CHANGED = 5;   // Changed pixels allowed, per mille
+
+static Thumbnail* s_background = NULL;
+static uint8_t s_background_samples = 0;
+
+// MARK: Metrics
+uint8_t thumbnailDifference(const Thumbnail* a, const Thumbnail* b) {
+    if (a->width != b->width || a->height != b->height) {
+        return 255;
+    }
+    size_t count = (size_t)a->width * a->height;
+    if (count == 0) {
+        return 0;
+    }
+
+    uint32_t sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        sum += abs((int)a->pixels[i] - (int)b->pixels[i]);
+    }
+    return sum / count;
+}
+
+uint16_t thumbnailSharpness(const Thumbnail* thumb) {
+    if (thumb->width < 2 || thumb->height < 2) {
+        return 0;
+    }
+
+    uint32_t sum = 0;
+    for (uint16_t y = 0; y + 1 < thumb->height; y++) {
+        const uint8_t* row = thumb->pixels + (size_t)y * thumb->width;
+        const uint8_t* next = row + thumb->width;
+        for (uint16_t x = 0; x + 1 < thumb->width; x++) {
+            sum += abs((int)row[x + 1] - (int)row[x]) + abs((int)next[x] - (int)row[x]);
+        }
+    }
+    uint32_t count = (uint32_t)(thumb->width - 1) * (thumb->height - 1);
+    return (uint16_t)(sum * 16 / count);
+}
+
+uint8_t thumbnailMean(const Thumbnail* thumb) {
+    size_t count = (size_t)thumb->width * thumb->height;
+    uint32_t sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        sum += thumb->pixels[i];
+    }
+    return count ? sum / count : 0;
+}
+
+// MARK: Hash
+uint64_t thumbnailHash(const Thumbnail* thumb) {
+    if (thumb->width < 9 || thumb->height < 8) {
+        return 0;
+    }
+
+    uint32_t cells[8][9];
+    for (uint8_t cy = 0; cy < 8; cy++) {
+        uint16_t y0 = (uint32_t)cy * thumb->height / 8;
+        uint16_t y1 = (uint32_t)(cy + 1) * thumb->height / 8;
+        for (uint8_t cx = 0; cx < 9; cx++) {
+            uint16_t x0 = (uint32_t)cx * thumb->width / 9;
+            uint16_t x1 = (uint32_t)(cx + 1) * thumb->width / 9;
+            uint32_t sum = 0;
+            for (uint16_t y = y0; y < y1; y++) {
+                const uint8_t* row = thumb->pixels + (size_t)y * thumb->width;
+                for (uint16_t x = x0; x < x1; x++) {
+                    sum += row[x];
+                }
+            }
+            cells[cy][cx] = sum / ((uint32_t)(y1 - y0) * (x1 - x0));
+        }
+    }
+
+    uint64_t hash = 0;
+    for (uint8_t cy = 0; cy < 8; cy++) {
+        for (uint8_t cx = 0; cx < 8; cx++) {
+            hash = (hash << 1) | (cells[cy][cx] > cells[cy][cx + 1]);
+        }
+    }
+    return hash;
+}
+
+uint8_t hashDistance(uint64_t a, uint64_t b) {
+    return (uint8_t)__builtin_popcountll(a ^ b);
+}
+
+// MARK: Background
+void backgroundLearn(const Thumbnail* thumb) {
+    if (!s_background) {
+        s_background = (Thumbnail*)malloc(sizeof(Thumbnail));
+        if (!s_background) {
+            return;
+        }
+        s_background_samples = 0;
+    }
+
+    if (s_background_samples == 0 || s_background->width != thumb->width || s_background->height != thumb->height) {
+        memcpy(s_background, thumb, sizeof(Thumbnail));
+        s_background_samples = 1;
+        return;
+    }
+
+    // Running average weighted 3:1 to the history, tracks slow lighting drift
+    size_t count = (size_t)thumb->width * thumb->height;
+    for (size_t i = 0; i < count; i++) {
+        s_background->pixels[i] = (3 * s_background->pixels[i] + thumb->pixels[i] + 2) / 4;
+    }
+    if (s_background_samples < 255) {
+        s_background_samples++;
+    }
+}
+
+bool backgroundMatches(const Thumbnail* thumb) {
+    if (!s_background || s_background_samples < BACKGROUND_MIN_SAMPLES ||
+        s_background->width != thumb->width || s_background->height != thumb->height) {
+        return false;
+    }
+
+    // Compare around each image's mean so flash and exposure drift don't count as change
+    int offset = (int)thumbnailMean(s_background) - (int)thumbnailMean(thumb);
+    size_t count = (size_t)thumb->width * thumb->height;
+    size_t changed = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (abs((int)thumb->pixels[i] + offset - (int)s_background->pixels[i]) > BACKGROUND_PIXEL_DIFF) {
+            changed++;
+        }
+    }
+    return changed * 1000 <= count * BACKGROUND_MAX_CHANGED;
+}
@@ -0,0 +1,76 @@
+#ifndef FRAME_ANALYSIS_H
+#define FRAME_ANALYSIS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * On-device checks on a 1/8-scale grayscale thumbnail of the capture
+ *
+ * A UXGA frame gives a 200x150 thumbnail, small enough that every check
+ * here takes well under a millisecond, so they can run on each frame
+ * instead of decoding the full JPEG.
+ */
+
+#define THUMB_MAX_WIDTH  200
+#define THUMB_MAX_HEIGHT 150
+
+/**
+ * 8-bit luma image, row-major
+ */
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint8_t pixels[THUMB_MAX_WIDTH * THUMB_MAX_HEIGHT];
+} Thumbnail;
+
+/**
+ * @return Mean absolute pixel difference (0-255), 255 if the sizes differ
+ */
+uint8_t thumbnailDifference(const Thumbnail* a, const Thumbnail* b);
+
+/**
+ * Focus measure: mean absolute gradient, low for blurred or defocused frames
+ * @return Mean of |dx| + |dy| over the image, scaled by 16
+ */
+uint16_t thumbnailSharpness(const Thumbnail* thumb);
+
+/**
+ * @return Mean brightness (0-255)
+ */
+uint8_t thumbnailMean(const Thumbnail* thumb);
+
+/**
+ * Perceptual hash (dHash): the thumbnail is averaged down to 9x8 cells and
+ * each bit says whether a cell is brighter than its right neighbour, so
+ * re-encoding, small shifts and exposure drift flip few bits
+ * @return 64-bit hash, 0 if the thumbnail is smaller than 9x8
+ */
+uint64_t thumbnailHash(const Thumbnail* thumb);
+
+/**
+ * @return Number of differing bits between two thumbnailHash() values (0-64)
+ */
+uint8_t hashDistance(uint64_t a, uint64_t b);
+
+/**
+ * Fold a frame known to show the empty chute into the background model
+ * @param thumb Thumbnail of a frame the backend classified as empty
+ */
+void backgroundLearn(const Thumbnail* thumb);
+
+/**
+ * @return true if the frame matches the learned empty-chute background
+ */
+bool backgroundMatches(const Thumbnail* thumb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FRAME_ANALYSIS_H */
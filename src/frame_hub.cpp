@@ -0,0 +1,104 @@
+#include "frame_hub.h"
+#include "platform_port.h"
+#include <Arduino.h>
+#include <atomic>
+#include <new>
+
+struct SharedFrame {
+    std::atomic<int> refs;
+    camera_fb_t* fb;
+    uint32_t timestamp;
+};
+
+// MARK: Frames
+SharedFrame* frameWrap(camera_fb_t* fb) {
+    if (!fb) {
+        return NULL;
+    }
+    SharedFrame* frame = new (std::nothrow) SharedFrame();
+    if (!frame) {
+        esp_camera_fb_return(fb);
+        return NULL;
+    }
+    frame->refs.store(1);
+    frame->fb = fb;
+    frame->timestamp = millis();
+    return frame;
+}
+
+SharedFrame* frameRetain(SharedFrame* frame) {
+    if (frame) {
+        frame->refs.fetch_add(1);
+    }
+    return frame;
+}
+
+void frameRelease(SharedFrame* frame) {
+    if (frame && frame->refs.fetch_sub(1) == 1) {
+        esp_camera_fb_return(frame->fb);
+        delete frame;
+    }
+}
+
+const camera_fb_t* frameBuffer(const SharedFrame* frame) {
+    return frame->fb;
+}
+
+uint32_t frameTimestamp(const SharedFrame* frame) {
+    return frame->timestamp;
+}
+
+// MARK: Hub
+static PortSem s_hub_lock = NULL;
+static SharedFrame* s_latest = NULL;
+
+static bool hubLock(void) {
+    // First use is from setup() or the loop, before any stream client exists
+    if (!s_hub_lock) {
+        s_hub_lock = portSemCreate(1);
+    }
+    if (!s_hub_lock) {
+        return false;
+    }
+    portSemTake(s_hub_lock);
+    return true;
+}
+
+void frameHubPublish(SharedFrame* frame) {
+    if (!hubLock()) {
+        return;
+    }
+    SharedFrame* old = s_latest;
+    s_latest = frameRetain(frame);
+    portSemGive(s_hub_lock);
+    frameRelease(old);
+}
+
+SharedFrame* frameHubAcquire(uint32_t max_age_ms, bool allow_capture) {
+    if (!hubLock()) {
+        return NULL;
+    }
+
+    bool fresh = s_latest && millis() - frameTimestamp(s_latest) <= max_age_ms;
+    if (!fresh && allow_capture) {
+        // Drop the stale frame first so the driver has a buffer to fill
+        SharedFrame* old = s_latest;
+        s_latest = NULL;
+        frameRelease(old);
+        s_latest = frameWrap(esp_camera_fb_get());
+    }
+
+    SharedFrame* frame = frameRetain(s_latest);
+    portSemGive(s_hub_lock);
+    return frame;
+}
+
+void frameHubFlush(void) {
+    if (!hubLock()) {
+        return;
+    }
+    SharedFrame* old = s_latest;
+    s_latest = NULL;
+    portSemGive(s_hub_lock);
+    frameRelease(old);
+}
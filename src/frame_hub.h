@@ -0,0 +1,74 @@
+#ifndef FRAME_HUB_H
+#define FRAME_HUB_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_camera.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Reference-counted camera frame
+ *
+ * Wraps a camera_fb_t without copying it. The frame buffer goes back to
+ * the driver with esp_camera_fb_return() when the last reference is
+ * released, so the classifier and any number of preview clients can share
+ * one capture.
+ */
+typedef struct SharedFrame SharedFrame;
+
+/**
+ * Wrap a frame from the driver
+ * @param fb Frame from esp_camera_fb_get(), owned by the returned handle
+ * @return Shared frame with one reference or NULL (fb is returned on failure)
+ */
+SharedFrame* frameWrap(camera_fb_t* fb);
+
+/**
+ * Add a reference
+ */
+SharedFrame* frameRetain(SharedFrame* frame);
+
+/**
+ * Drop a reference, returning the buffer to the driver on the last one
+ */
+void frameRelease(SharedFrame* frame);
+
+/**
+ * @return The underlying frame buffer (read-only)
+ */
+const camera_fb_t* frameBuffer(const SharedFrame* frame);
+
+/**
+ * @return millis() at which the frame was wrapped
+ */
+uint32_t frameTimestamp(const SharedFrame* frame);
+
+/**
+ * Make a frame the latest one for preview clients
+ */
+void frameHubPublish(SharedFrame* frame);
+
+/**
+ * Get a frame for a preview client
+ *
+ * Returns the latest frame if it is younger than max_age_ms. Otherwise a
+ * new frame is grabbed, unless allow_capture is false (classification in
+ * progress), in which case the stale frame is returned.
+ *
+ * @return Frame with a reference for the caller, or NULL
+ */
+SharedFrame* frameHubAcquire(uint32_t max_age_ms, bool allow_capture);
+
+/**
+ * Drop the hub's own reference so its buffer is free for the next capture
+ */
+void frameHubFlush(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FRAME_HUB_H */
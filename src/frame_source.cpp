@@ -0,0 +1,164 @@
+#include "frame_source.h"
+#include "vision_client.h"
+#include "vision_transport.h"
+#include "request_scheduler.h"
+#include "waste_classifier.h"
+#include "timer_wheel.h"
+#include "platform_port.h"
+#include <stdlib.h>
+#include <string.h>
+
+static FrameSource* s_sources[FRAME_SOURCES_MAX];
+static uint8_t s_source_count = 0;
+
+static SourceFrame s_queue[FRAME_QUEUE_DEPTH];
+static uint8_t s_queue_head = 0;
+static volatile uint8_t s_queue_count = 0;
+static PortSem s_lock = NULL;
+
+// MARK: Sources
+bool frameSourcesBegin(void) {
+    if (!s_lock) {
+        s_lock = portSemCreate(1);
+    }
+    return s_lock != NULL;
+}
+
+bool frameSourceRegister(FrameSource* source) {
+    if (!s_lock || !source || !source->name || !source->ops) {
+        return false;
+    }
+    portSemTake(s_lock);
+    FrameSource* existing = frameSourceFind(source->name);
+    bool ok = existing ? existing == source : s_source_count < FRAME_SOURCES_MAX;
+    if (!existing && ok) {
+        source->id = s_source_count + 1;
+        memset(&source->stats, 0, sizeof(source->stats));
+        source->stats.last_verdict = TYPE_UNSET;
+        s_sources[s_source_count++] = source;
+    }
+    portSemGive(s_lock);
+    return ok;
+}
+
+FrameSource* frameSourceFind(const char* name) {
+    // Sources are only ever added, so a lookup needs no lock
+    uint8_t count = s_source_count;
+    for (uint8_t i = 0; i < count; i++) {
+        if (strcmp(s_sources[i]->name, name) == 0) {
+            return s_sources[i];
+        }
+    }
+    return NULL;
+}
+
+uint8_t frameSourceCount(void) {
+    return s_source_count;
+}
+
+const FrameSource* frameSourceAt(uint8_t index) {
+    return index < s_source_count ? s_sources[index] : NULL;
+}
+
+// MARK: Queue
+bool frameSourceSubmit(FrameSource* source, const uint8_t* jpeg, size_t len, void* owner) {
+    if (!s_lock || !source || !source->id || !jpeg || len == 0) {
+        return false;
+    }
+    portSemTake(s_lock);
+    bool queued = s_queue_count < FRAME_QUEUE_DEPTH;
+    if (queued) {
+        SourceFrame* slot = &s_queue[(s_queue_head + s_queue_count) % FRAME_QUEUE_DEPTH];
+        slot->source = source;
+        slot->jpeg = jpeg;
+        slot->len = len;
+        slot->queued_ms = millis();
+        slot->owner = owner;
+        s_queue_count++;
+    } else {
+        source->stats.dropped++;
+    }
+    portSemGive(s_lock);
+
+    // Handshake while the frame waits its turn, and wake the capture loop if it is asleep
+    if (queued) {
+        visionConnPrewarm(visionGetBackend());
+        wheelWake();
+    }
+    return queued;
+}
+
+uint8_t frameSourcePending(void) {
+    return s_queue_count;
+}
+
+static bool takeNext(SourceFrame* frame) {
+    if (!s_lock || s_queue_count == 0) {
+        return false;
+    }
+    portSemTake(s_lock);
+    bool taken = s_queue_count > 0;
+    if (taken) {
+        *frame = s_queue[s_queue_head];
+        s_queue_head = (s_queue_head + 1) % FRAME_QUEUE_DEPTH;
+        s_queue_count--;
+    }
+    portSemGive(s_lock);
+    return taken;
+}
+
+static void complete(SourceFrame* frame, int waste_type) {
+    FrameSource* source = frame->source;
+    source->stats.last_verdict = waste_type;
+    source->stats.last_latency_ms = millis() - frame->queued_ms;
+    source->ops->deliver(source, frame, waste_type);
+    if (source->ops->release) {
+        source->ops->release(source, frame);
+    }
+}
+
+// MARK: Pipeline
+bool frameSourceService(const VisionContext* context, const char* prompt, const char* api_key,
+                        uint32_t fresh_ms, SourceResult* result) {
+    SourceFrame frame;
+    if (!takeNext(&frame)) {
+        return false;
+    }
+
+    SourceResult out = {};
+    out.source_id = frame.source->id;
+    out.waste_type = TYPE_ERROR;
+    out.jpeg_len = frame.len;
+    out.queued_ms = frame.queued_ms;
+    out.wait_ms = millis() - frame.queued_ms;
+
+    // Wait for quota only as long as the frame stays fresh, like the controller's own captures
+    if (out.wait_ms >= fresh_ms) {
+        frame.source->stats.dropped++;
+    } else if (!schedulerAcquire(REQUEST_FRESH, fresh_ms - out.wait_ms)) {
+        frame.source->stats.frames++;
+        out.throttled = true;
+    } else {
+        VisionRequest request = {prompt, frame.jpeg, frame.len, context, WASTE_RESPONSE_ENUM, false};
+        uint32_t start = millis();
+        char* response = visionSendRequest(&request, api_key);
+        out.request_ms = millis() - start;
+
+        VisionResponseInfo info = visionLastResponse();
+        schedulerReportResponse(info.status, info.retry_after_ms);
+        out.http_status = info.status;
+        out.throttled = info.status == 429 || info.status == 503;
+        out.cache_rejected = info.cache_rejected;
+        if (response) {
+            out.waste_type = parseGeminiResponse(response);
+            free(response);
+        }
+        frame.source->stats.frames++;
+    }
+
+    complete(&frame, out.waste_type);
+    if (result) {
+        *result = out;
+    }
+    return true;
+}
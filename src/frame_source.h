@@ -0,0 +1,147 @@
+#ifndef FRAME_SOURCE_H
+#define FRAME_SOURCE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "vision_backend.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Frames from several cameras, classified by one pipeline
+ *
+ * Each chute's camera is a FrameSource: a remote ESP32-CAM pushing JPEGs
+ * over the LAN, or a simulated source replaying files on Linux. Sources
+ * queue their frames from any task; the controller's capture loop drains
+ * the queue between its own captures, so every chute shares one request
+ * quota, one context cache and one DNS cache. The backend handshake for a
+ * frame starts as it is queued, overlapping the request ahead of it, so a
+ * burst from several chutes pays the TLS setup only once. Each verdict is
+ * handed to the source the frame came from, which routes it on: a reply
+ * to the remote camera, a line of output from the simulator.
+ *
+ * The controller's own OV2640 is source 0 and keeps its dedicated path in
+ * the capture loop (flash, exposure lock, local checks); queued sources
+ * are numbered from 1 in registration order.
+ */
+
+#define FRAME_SOURCES_MAX 8
+#define FRAME_QUEUE_DEPTH 4
+
+typedef struct FrameSource FrameSource;
+
+/**
+ * A queued JPEG and who to answer
+ */
+typedef struct {
+    FrameSource* source;
+    const uint8_t* jpeg;
+    size_t len;
+    uint32_t queued_ms;     // millis() when submitted; freshness counts from here
+    void* owner;            // The source's handle for the memory and the reply
+} SourceFrame;
+
+typedef struct {
+    /** Route a verdict back where the frame came from; TYPE_ERROR if it could not be classified */
+    void (*deliver)(FrameSource* source, const SourceFrame* frame, int waste_type);
+    /** Give the frame's memory back; called once, after deliver */
+    void (*release)(FrameSource* source, SourceFrame* frame);
+} FrameSourceOps;
+
+/**
+ * Per-source counters, for /status
+ */
+typedef struct {
+    uint32_t frames;        // Classified, or failed after a request
+    uint32_t dropped;       // Refused with a full queue, or stale before their turn
+    int last_verdict;
+    uint32_t last_latency_ms;   // Queued to verdict
+} FrameSourceStats;
+
+struct FrameSource {
+    const char* name;
+    const FrameSourceOps* ops;
+    void* ctx;
+    uint8_t id;             // Assigned by frameSourceRegister
+    FrameSourceStats stats;
+};
+
+/**
+ * What the pipeline did with one queued frame, for the capture log
+ */
+typedef struct {
+    uint8_t source_id;
+    int waste_type;         // TYPE_* value
+    size_t jpeg_len;
+    uint32_t queued_ms;
+    uint32_t wait_ms;       // Time in the queue
+    uint32_t request_ms;    // 0 without a request
+    int http_status;        // 0 without a request
+    bool throttled;         // No quota in time, or the backend pushed back
+    bool cache_rejected;    // The backend no longer has the context cache the request named
+} SourceResult;
+
+/**
+ * Set up the queue; call once before registering sources
+ * @return true if ready
+ */
+bool frameSourcesBegin(void);
+
+/**
+ * Add a source; name, ops and ctx must be set and outlive it
+ * @return true if registered (or already registered)
+ */
+bool frameSourceRegister(FrameSource* source);
+
+/**
+ * @return The registered source with this name, NULL if none
+ */
+FrameSource* frameSourceFind(const char* name);
+
+/**
+ * Queue a frame for classification; safe from any task
+ * @param owner Passed back to the source's ops with the frame
+ * @return true if queued, false if the queue is full (the caller keeps the memory)
+ */
+bool frameSourceSubmit(FrameSource* source, const uint8_t* jpeg, size_t len, void* owner);
+
+/**
+ * @return Number of frames waiting
+ */
+uint8_t frameSourcePending(void);
+
+/**
+ * Classify the oldest queued frame and route its verdict
+ *
+ * Frames older than fresh_ms are answered TYPE_ERROR without a request.
+ * Requests wait for quota only while the frame stays fresh.
+ *
+ * @param context Standing context for the request, NULL for the prompt alone
+ * @param prompt Prompt used without a context
+ * @param api_key The backend API key
+ * @param fresh_ms How long a frame is worth sending
+ * @param result Receives what happened, if not NULL
+ * @return true if a frame was handled, false if the queue was empty
+ */
+bool frameSourceService(const VisionContext* context, const char* prompt, const char* api_key,
+                        uint32_t fresh_ms, SourceResult* result);
+
+/**
+ * @return Number of registered sources
+ */
+uint8_t frameSourceCount(void);
+
+/**
+ * @param index 0..frameSourceCount()-1
+ * @return The source, NULL if out of range
+ */
+const FrameSource* frameSourceAt(uint8_t index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FRAME_SOURCE_H */
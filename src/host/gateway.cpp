@@ -0,0 +1,815 @@
+// Edge gateway: one Linux box talks to the backend for a fleet of cameras.
+//
+// Cameras POST raw JPEGs over plain HTTP on the LAN to the same endpoint
+// the controller serves (POST /frame?source=NAME), so a device built with
+// CONTROLLER_HOST pointing here works unchanged and needs neither an API
+// key nor a TLS stack. The gateway holds the key and a pool of workers,
+// each keeping one persistent HTTP/1.1 connection to the backend, and
+// builds and parses requests with the device's own code (vision_backend,
+// waste_classifier).
+//
+// Before a frame is sent its perceptual hash (thumbnailHash of the JPEG's
+// DC thumbnail) is looked up among recent verdicts, and among frames
+// already in flight: a near-duplicate from a camera that fired twice, or
+// from two chutes seeing the same item, waits for that request instead of
+// spending another one.
+//
+// Replies are the label as plain text, or 4 bytes with
+// "Accept: application/octet-stream": waste type, confidence in percent
+// (255 if the backend gave none), flags (bit 0: from the cache), reserved.
+// GET /status returns the counters as JSON.
+//
+//   pio run -e gateway
+//   .pio/build/gateway/program --port 8090 --key $GEMINI_API_KEY --pool 4
+//   .pio/build/gateway/program --port 8090 --host 127.0.0.1 --backend-port 8080   (against mock_server)
+
+#include "frame_analysis.h"
+#include "jpeg_dc.h"
+#include "latency_stats.h"
+#include "platform_port.h"
+#include "vision_backend.h"
+#include "vision_transport.h"
+#include "waste_classifier.h"
+
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// MARK: Config
+struct GatewayConfig {
+    int port = 8090;
+    std::string host;                 // Backend host, empty for Gemini
+    int backend_port = 8080;
+    bool backend_tls = false;
+    std::string model = "gemini-2.0-flash-lite";
+    std::string api_key;
+    int pool = 4;                     // Backend connections, one worker each
+    uint32_t fresh_ms = 5000;         // Frames older than this are not worth sending
+    uint32_t cache_ttl_ms = 300000;
+    int cache_distance = 4;           // Hash bits two frames may differ by and still share a verdict
+    bool logprobs = false;            // Ask for confidence, so unsure verdicts stay out of the cache
+    int stats_sec = 10;
+};
+
+static GatewayConfig config;
+
+static const size_t FRAME_MAX = 512 * 1024;
+static const size_t CACHE_MAX = 1024;
+static const uint32_t CONNECT_TIMEOUT_MS = 10000;
+static const uint32_t RESPONSE_TIMEOUT_MS = 15000;
+static const uint32_t DEVICE_IDLE_SEC = 30;
+static const float CACHE_MIN_CONFIDENCE = 0.80f;  // Unsure answers are not worth repeating
+
+static VisionBackend backend;
+
+// MARK: Stats
+static std::atomic<uint64_t> stat_frames{0};
+static std::atomic<uint64_t> stat_cache_hits{0};
+static std::atomic<uint64_t> stat_coalesced{0};
+static std::atomic<uint64_t> stat_requests{0};
+static std::atomic<uint64_t> stat_failed{0};
+static std::atomic<uint64_t> stat_throttled{0};
+static std::atomic<uint64_t> stat_stale{0};
+static std::atomic<uint64_t> stat_connects{0};
+static std::atomic<uint64_t> stat_devices{0};
+
+static std::mutex s_latency_lock;
+static LatencyWindow s_device_latency;    // Frame received to reply, as the camera sees it
+static LatencyWindow s_backend_latency;   // One backend request
+
+static void recordLatency(LatencyWindow* window, uint32_t ms) {
+    std::lock_guard<std::mutex> guard(s_latency_lock);
+    latencyRecord(window, ms);
+}
+
+// MARK: Jobs
+/**
+ * One backend request, shared by every frame that hashed close enough to it
+ */
+struct Job {
+    std::vector<uint8_t> jpeg;
+    bool hashed = false;
+    uint64_t hash = 0;
+    uint32_t received_ms = 0;
+
+    bool done = false;
+    int waste_type = TYPE_ERROR;
+    uint8_t confidence_pct = 255;
+    int status = 0;                   // Backend HTTP status, 0 if no response
+    uint32_t retry_after_ms = 0;
+};
+
+static std::mutex s_jobs_lock;
+static std::condition_variable s_jobs_ready;   // Workers wait for a queued job
+static std::condition_variable s_jobs_done;    // Devices wait for their job's verdict
+static std::deque<std::shared_ptr<Job>> s_queue;
+static std::vector<std::shared_ptr<Job>> s_in_flight;  // Queued or being sent
+
+// Quota pushback from the backend: frames are refused until then, and the camera backs off
+static std::atomic<uint32_t> s_throttled_until{0};
+
+// MARK: Verdict Cache
+struct CacheEntry {
+    uint64_t hash;
+    int waste_type;
+    uint8_t confidence_pct;
+    uint32_t stored_ms;
+};
+
+static std::mutex s_cache_lock;
+static std::vector<CacheEntry> s_cache;
+
+static bool cacheLookup(uint64_t hash, CacheEntry* found) {
+    std::lock_guard<std::mutex> guard(s_cache_lock);
+    uint32_t now = millis();
+    int best = config.cache_distance + 1;
+    for (const CacheEntry& entry : s_cache) {
+        if (now - entry.stored_ms >= config.cache_ttl_ms) {
+            continue;
+        }
+        int distance = hashDistance(hash, entry.hash);
+        if (distance < best) {
+            best = distance;
+            *found = entry;
+        }
+    }
+    return best <= config.cache_distance;
+}
+
+static void cacheStore(uint64_t hash, int waste_type, uint8_t confidence_pct) {
+    std::lock_guard<std::mutex> guard(s_cache_lock);
+    uint32_t now = millis();
+    CacheEntry entry = {hash, waste_type, confidence_pct, now};
+
+    // Replace the oldest entry once full
+    if (s_cache.size() < CACHE_MAX) {
+        s_cache.push_back(entry);
+        return;
+    }
+    size_t oldest = 0;
+    for (size_t i = 1; i < s_cache.size(); i++) {
+        if (now - s_cache[i].stored_ms > now - s_cache[oldest].stored_ms) {
+            oldest = i;
+        }
+    }
+    s_cache[oldest] = entry;
+}
+
+// jpegDcThumbnail is not reentrant, and a few ms of hashing needs no more than one thread
+static bool hashFrame(const std::vector<uint8_t>& jpeg, uint64_t* hash) {
+    static std::mutex lock;
+    static Thumbnail thumb;
+    std::lock_guard<std::mutex> guard(lock);
+    if (!jpegDcThumbnail(jpeg.data(), jpeg.size(), &thumb)) {
+        return false;
+    }
+    *hash = thumbnailHash(&thumb);
+    return true;
+}
+
+// MARK: Backend Connection
+struct BackendResponse {
+    int status = 0;
+    uint32_t retry_after_ms = 0;
+    bool keep_alive = true;
+    std::string body;
+};
+
+static bool writeFully(VisionConn* conn, const char* data, size_t len) {
+    return len == 0 || visionConnWrite(conn, (const uint8_t*)data, len) == len;
+}
+
+static bool sendRequest(VisionConn* conn, const char* path, VisionEncoder* body) {
+    char head[512];
+    int len = snprintf(head, sizeof(head),
+                       "POST %s HTTP/1.1\r\n"
+                       "Host: %s\r\n"
+                       "Content-Type: %s\r\n"
+                       "Content-Length: %u\r\n"
+                       "Connection: keep-alive\r\n"
+                       "\r\n",
+                       path, backend.host, backend.ops->content_type, (unsigned)visionEncoderLength(body));
+    if (len < 0 || (size_t)len >= sizeof(head) || !writeFully(conn, head, len)) {
+        return false;
+    }
+
+    char chunk[4096];
+    while (size_t n = visionEncoderRead(body, chunk, sizeof(chunk))) {
+        if (!writeFully(conn, chunk, n)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Decode a chunked body
+ * @return true once the terminating chunk is in
+ */
+static bool decodeChunked(const std::string& raw, size_t start, std::string* body) {
+    body->clear();
+    size_t in = start;
+    for (;;) {
+        size_t eol = raw.find('\n', in);
+        if (eol == std::string::npos) {
+            return false;
+        }
+        size_t chunk = strtoul(raw.c_str() + in, NULL, 16);
+        if (chunk == 0) {
+            return true;
+        }
+        if (eol + 1 + chunk + 2 > raw.size()) {
+            return false;
+        }
+        body->append(raw, eol + 1, chunk);
+        in = eol + 1 + chunk + 2;
+    }
+}
+
+/**
+ * Read one response off a kept-alive connection
+ * @return false if the connection failed; response->status stays 0 if no byte arrived
+ */
+static bool readResponse(VisionConn* conn, BackendResponse* response) {
+    std::string raw;
+    size_t header_len = 0;
+    long content_length = -1;
+    bool chunked = false;
+    uint32_t last_data = millis();
+
+    for (;;) {
+        if (!header_len) {
+            size_t end = raw.find("\r\n\r\n");
+            if (end != std::string::npos) {
+                header_len = end + 4;
+                response->status = atoi(raw.c_str() + raw.find(' ') + 1);
+                size_t line = raw.find('\n') + 1;
+                while (line < header_len) {
+                    const char* p = raw.c_str() + line;
+                    if (strncasecmp(p, "Content-Length:", 15) == 0) {
+                        content_length = atol(p + 15);
+                    } else if (strncasecmp(p, "Retry-After:", 12) == 0) {
+                        response->retry_after_ms = strtoul(p + 12, NULL, 10) * 1000;
+                    } else if (strncasecmp(p, "Transfer-Encoding:", 18) == 0) {
+                        chunked = strncasecmp(p + 18 + strspn(p + 18, " "), "chunked", 7) == 0;
+                    } else if (strncasecmp(p, "Connection:", 11) == 0) {
+                        response->keep_alive = strncasecmp(p + 11 + strspn(p + 11, " "), "close", 5) != 0;
+                    }
+                    line = raw.find('\n', line) + 1;
+                }
+            }
+        }
+        if (header_len) {
+            if (chunked && decodeChunked(raw, header_len, &response->body)) {
+                return true;
+            }
+            if (!chunked && content_length >= 0 && raw.size() - header_len >= (size_t)content_length) {
+                response->body.assign(raw, header_len, content_length);
+                return true;
+            }
+        }
+
+        uint8_t buffer[4096];
+        int n = visionConnRead(conn, buffer, sizeof(buffer));
+        if (n < 0) {
+            // Without a length the body runs to the close
+            if (header_len && !chunked && content_length < 0) {
+                response->body.assign(raw, header_len, std::string::npos);
+                response->keep_alive = false;
+                return true;
+            }
+            return false;
+        }
+        if (n == 0) {
+            if (millis() - last_data > RESPONSE_TIMEOUT_MS) {
+                return false;
+            }
+            delay(1);
+            continue;
+        }
+        raw.append((const char*)buffer, n);
+        last_data = millis();
+    }
+}
+
+/**
+ * A worker's persistent connection; reopened when the backend closes it
+ */
+struct BackendLink {
+    VisionConn* conn = NULL;
+
+    void close() {
+        if (conn) {
+            visionConnClose(conn);
+            conn = NULL;
+        }
+    }
+
+    bool exchange(const char* path, VisionEncoder* body, BackendResponse* response) {
+        // A kept-alive connection may have been dropped while idle: retry once on a fresh one
+        for (int attempt = 0; attempt < 2; attempt++) {
+            bool reused = conn != NULL;
+            if (!conn) {
+                conn = visionConnOpen(&backend, CONNECT_TIMEOUT_MS);
+                if (!conn) {
+                    return false;
+                }
+                stat_connects++;
+            }
+            visionEncoderRewind(body);
+            *response = BackendResponse();
+            bool ok = sendRequest(conn, path, body) && readResponse(conn, response);
+            if (!ok || !response->keep_alive) {
+                close();
+            }
+            if (ok) {
+                return true;
+            }
+            if (!reused || response->status != 0) {
+                return false;
+            }
+        }
+        return false;
+    }
+};
+
+// MARK: Workers
+static void finishJob(const std::shared_ptr<Job>& job) {
+    std::lock_guard<std::mutex> guard(s_jobs_lock);
+    job->done = true;
+    for (size_t i = 0; i < s_in_flight.size(); i++) {
+        if (s_in_flight[i] == job) {
+            s_in_flight.erase(s_in_flight.begin() + i);
+            break;
+        }
+    }
+    s_jobs_done.notify_all();
+}
+
+static void runJob(BackendLink* link, Job* job) {
+    char path[256];
+    VisionRequest request = {WASTE_PROMPT, job->jpeg.data(), job->jpeg.size(), NULL, WASTE_RESPONSE_ENUM,
+                             config.logprobs};
+    VisionEncoder body;
+    if (backend.ops->buildPath(&backend, config.api_key.c_str(), path, sizeof(path)) == 0 ||
+        !visionEncoderInit(&body, &backend, &request)) {
+        stat_failed++;
+        return;
+    }
+
+    uint32_t start = millis();
+    BackendResponse response;
+    stat_requests++;
+    bool ok = link->exchange(path, &body, &response);
+    recordLatency(&s_backend_latency, millis() - start);
+    job->status = response.status;
+    job->retry_after_ms = response.retry_after_ms;
+
+    if (response.status == 429 || response.status == 503) {
+        stat_throttled++;
+        uint32_t retry_ms = response.retry_after_ms ? response.retry_after_ms : 5000;
+        s_throttled_until = millis() + retry_ms;
+        job->retry_after_ms = retry_ms;
+        return;
+    }
+    if (!ok || response.status < 200 || response.status >= 300) {
+        stat_failed++;
+        return;
+    }
+
+    WasteVerdict verdict = parseVerdict(response.body.c_str());
+    job->waste_type = verdict.waste_type;
+    job->confidence_pct = verdict.confidence < 0 ? 255 : (uint8_t)(verdict.confidence * 100 + 0.5f);
+    if (verdict.waste_type == TYPE_ERROR) {
+        stat_failed++;
+        return;
+    }
+    bool sure = verdict.confidence < 0 || verdict.confidence >= CACHE_MIN_CONFIDENCE;
+    if (job->hashed && sure && verdict.finish != VISION_FINISH_MAX_TOKENS) {
+        cacheStore(job->hash, verdict.waste_type, job->confidence_pct);
+    }
+}
+
+static void runWorker() {
+    BackendLink link;
+    for (;;) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> guard(s_jobs_lock);
+            s_jobs_ready.wait(guard, [] { return !s_queue.empty(); });
+            job = s_queue.front();
+            s_queue.pop_front();
+        }
+
+        // The camera has stopped waiting by now; don't spend quota on it
+        if (millis() - job->received_ms >= config.fresh_ms) {
+            stat_stale++;
+        } else {
+            runJob(&link, job.get());
+        }
+        finishJob(job);
+    }
+}
+
+/**
+ * Join an in-flight request for a near-identical frame, or queue a new one
+ * @return The job whose verdict answers this frame
+ */
+static std::shared_ptr<Job> submitFrame(std::vector<uint8_t>* jpeg, bool hashed, uint64_t hash, uint32_t received_ms) {
+    std::lock_guard<std::mutex> guard(s_jobs_lock);
+    if (hashed) {
+        for (const std::shared_ptr<Job>& job : s_in_flight) {
+            if (job->hashed && hashDistance(hash, job->hash) <= config.cache_distance) {
+                stat_coalesced++;
+                return job;
+            }
+        }
+    }
+
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->jpeg.swap(*jpeg);
+    job->hashed = hashed;
+    job->hash = hash;
+    job->received_ms = received_ms;
+    s_queue.push_back(job);
+    s_in_flight.push_back(job);
+    s_jobs_ready.notify_one();
+    return job;
+}
+
+// MARK: Device Requests
+struct DeviceRequest {
+    std::string method;
+    std::string path;
+    bool keep_alive = true;
+    bool binary = false;              // Accept: application/octet-stream
+    long content_length = -1;         // -1 without a Content-Length header
+};
+
+// Buffered reader so header and body parsing share one receive buffer
+struct DeviceReader {
+    int fd;
+    std::string buf;
+    size_t pos = 0;
+
+    bool fill() {
+        if (pos > 0 && pos == buf.size()) {
+            buf.clear();
+            pos = 0;
+        }
+        char tmp[16384];
+        ssize_t n = recv(fd, tmp, sizeof(tmp), 0);
+        if (n <= 0) {
+            return false;
+        }
+        buf.append(tmp, n);
+        return true;
+    }
+
+    bool readLine(std::string* line) {
+        for (;;) {
+            size_t eol = buf.find('\n', pos);
+            if (eol != std::string::npos) {
+                line->assign(buf, pos, eol - pos);
+                if (!line->empty() && line->back() == '\r') {
+                    line->pop_back();
+                }
+                pos = eol + 1;
+                return true;
+            }
+            if (!fill()) {
+                return false;
+            }
+        }
+    }
+
+    // Read len bytes into out, or discard them if out is NULL
+    bool read(size_t len, std::vector<uint8_t>* out) {
+        while (len > 0) {
+            if (pos == buf.size() && !fill()) {
+                return false;
+            }
+            size_t n = std::min(len, buf.size() - pos);
+            if (out) {
+                out->insert(out->end(), buf.begin() + pos, buf.begin() + pos + n);
+            }
+            pos += n;
+            len -= n;
+        }
+        return true;
+    }
+};
+
+static bool readRequestHead(DeviceReader* reader, DeviceRequest* req) {
+    std::string line;
+    if (!reader->readLine(&line) || line.empty()) {
+        return false;
+    }
+    size_t sp1 = line.find(' ');
+    size_t sp2 = line.find(' ', sp1 + 1);
+    if (sp1 == std::string::npos || sp2 == std::string::npos) {
+        return false;
+    }
+    req->method = line.substr(0, sp1);
+    req->path = line.substr(sp1 + 1, sp2 - sp1 - 1);
+
+    while (reader->readLine(&line) && !line.empty()) {
+        if (strncasecmp(line.c_str(), "Content-Length:", 15) == 0) {
+            req->content_length = atol(line.c_str() + 15);
+        } else if (strncasecmp(line.c_str(), "Connection:", 11) == 0) {
+            req->keep_alive = strcasestr(line.c_str(), "close") == NULL;
+        } else if (strncasecmp(line.c_str(), "Accept:", 7) == 0) {
+            req->binary = strcasestr(line.c_str(), "application/octet-stream") != NULL;
+        }
+    }
+    return true;
+}
+
+static bool sendAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool sendReply(int fd, const char* status, const char* type, const void* body, size_t body_len,
+                      bool keep_alive, uint32_t retry_after_ms = 0) {
+    char retry_after[48] = "";
+    if (retry_after_ms > 0) {
+        snprintf(retry_after, sizeof(retry_after), "Retry-After: %u\r\n", (unsigned)((retry_after_ms + 999) / 1000));
+    }
+    char head[320];
+    int len = snprintf(head, sizeof(head),
+                       "HTTP/1.1 %s\r\n"
+                       "Content-Type: %s\r\n"
+                       "Content-Length: %zu\r\n"
+                       "Cache-Control: no-store\r\n"
+                       "Connection: %s\r\n"
+                       "%s"
+                       "\r\n",
+                       status, type, body_len, keep_alive ? "keep-alive" : "close", retry_after);
+    return sendAll(fd, head, len) && sendAll(fd, (const char*)body, body_len);
+}
+
+static bool sendText(int fd, const char* status, const char* text, bool keep_alive, uint32_t retry_after_ms = 0) {
+    return sendReply(fd, status, "text/plain", text, strlen(text), keep_alive, retry_after_ms);
+}
+
+static bool sendVerdict(int fd, const DeviceRequest& req, int waste_type, uint8_t confidence_pct, bool cached) {
+    if (req.binary) {
+        uint8_t body[4] = {(uint8_t)waste_type, confidence_pct, (uint8_t)(cached ? 0x01 : 0x00), 0};
+        return sendReply(fd, "200 OK", "application/octet-stream", body, sizeof(body), req.keep_alive);
+    }
+    // Plain label text, which the camera's matcher reads as it would a model answer
+    return sendText(fd, "200 OK", wasteTypeName(waste_type), req.keep_alive);
+}
+
+static bool validSourceName(const std::string& path) {
+    size_t query = path.find("?source=");
+    if (path.compare(0, 6, "/frame") != 0 || query != 6 || query + 8 == path.size()) {
+        return false;
+    }
+    for (size_t i = query + 8; i < path.size(); i++) {
+        char c = path[i];
+        if (!isalnum((unsigned char)c) && c != '-' && c != '_') {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool handleFrame(int fd, DeviceReader* reader, const DeviceRequest& req) {
+    // Without a length, or with too long a body, the body is not read: close after the reply
+    if (req.content_length < 0) {
+        sendText(fd, "411 Length Required", "Missing Content-Length", false);
+        return false;
+    }
+    if ((size_t)req.content_length > FRAME_MAX) {
+        sendText(fd, "413 Payload Too Large", "Frame too large", false);
+        return false;
+    }
+    if (req.content_length == 0) {
+        return sendText(fd, "400 Bad Request", "Empty frame", req.keep_alive);
+    }
+    std::vector<uint8_t> jpeg;
+    jpeg.reserve(req.content_length);
+    if (!reader->read(req.content_length, &jpeg)) {
+        return false;
+    }
+    if (!validSourceName(req.path)) {
+        return sendText(fd, "400 Bad Request", "Missing source", req.keep_alive);
+    }
+
+    uint32_t received = millis();
+    stat_frames++;
+
+    uint64_t hash = 0;
+    bool hashed = hashFrame(jpeg, &hash);
+    CacheEntry cached = {};
+    if (hashed && cacheLookup(hash, &cached)) {
+        stat_cache_hits++;
+        recordLatency(&s_device_latency, millis() - received);
+        return sendVerdict(fd, req, cached.waste_type, cached.confidence_pct, true);
+    }
+
+    uint32_t throttled_for = s_throttled_until.load() - received;
+    if ((int32_t)throttled_for > 0) {
+        return sendText(fd, "503 Service Unavailable", "Backend throttled", req.keep_alive, throttled_for);
+    }
+
+    std::shared_ptr<Job> job = submitFrame(&jpeg, hashed, hash, received);
+    {
+        // Workers finish every job, stale ones included, so the wait ends
+        std::unique_lock<std::mutex> guard(s_jobs_lock);
+        s_jobs_done.wait(guard, [&] { return job->done; });
+    }
+    recordLatency(&s_device_latency, millis() - received);
+
+    if (job->status == 429 || job->status == 503) {
+        return sendText(fd, "503 Service Unavailable", "Backend throttled", req.keep_alive, job->retry_after_ms);
+    }
+    if (job->waste_type == TYPE_ERROR) {
+        return sendText(fd, "502 Bad Gateway", "No verdict", req.keep_alive);
+    }
+    return sendVerdict(fd, req, job->waste_type, job->confidence_pct, false);
+}
+
+static std::string statusJson() {
+    uint32_t device_p50, device_p90, backend_p50, backend_p90;
+    {
+        std::lock_guard<std::mutex> guard(s_latency_lock);
+        device_p50 = latencyPercentile(&s_device_latency, 50);
+        device_p90 = latencyPercentile(&s_device_latency, 90);
+        backend_p50 = latencyPercentile(&s_backend_latency, 50);
+        backend_p90 = latencyPercentile(&s_backend_latency, 90);
+    }
+    size_t cache_entries;
+    {
+        std::lock_guard<std::mutex> guard(s_cache_lock);
+        cache_entries = s_cache.size();
+    }
+    char json[640];
+    snprintf(json, sizeof(json),
+             "{\"frames\":%llu,\"cache_hits\":%llu,\"coalesced\":%llu,\"requests\":%llu,"
+             "\"failed\":%llu,\"throttled\":%llu,\"stale\":%llu,\"connects\":%llu,\"devices\":%llu,"
+             "\"cache_entries\":%zu,\"device_ms\":{\"p50\":%u,\"p90\":%u},\"backend_ms\":{\"p50\":%u,\"p90\":%u}}",
+             (unsigned long long)stat_frames.load(), (unsigned long long)stat_cache_hits.load(),
+             (unsigned long long)stat_coalesced.load(), (unsigned long long)stat_requests.load(),
+             (unsigned long long)stat_failed.load(), (unsigned long long)stat_throttled.load(),
+             (unsigned long long)stat_stale.load(), (unsigned long long)stat_connects.load(),
+             (unsigned long long)stat_devices.load(), cache_entries,
+             (unsigned)device_p50, (unsigned)device_p90, (unsigned)backend_p50, (unsigned)backend_p90);
+    return json;
+}
+
+static void serveDevice(int fd) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    timeval idle = {DEVICE_IDLE_SEC, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &idle, sizeof(idle));
+    stat_devices++;
+
+    DeviceReader reader;
+    reader.fd = fd;
+    DeviceRequest req;
+    while (readRequestHead(&reader, &req)) {
+        bool ok;
+        if (req.method == "POST" && req.path.compare(0, 6, "/frame") == 0) {
+            ok = handleFrame(fd, &reader, req);
+        } else if (req.method == "GET" && req.path == "/status") {
+            std::string json = statusJson();
+            ok = sendReply(fd, "200 OK", "application/json", json.data(), json.size(), req.keep_alive);
+        } else {
+            ok = reader.read(req.content_length > 0 ? req.content_length : 0, NULL) &&
+                 sendText(fd, "404 Not Found", "Not found", req.keep_alive);
+        }
+        if (!ok || !req.keep_alive) {
+            break;
+        }
+        req = DeviceRequest();
+    }
+    close(fd);
+}
+
+// MARK: Setup
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s [--port N] [--key API_KEY] [--model NAME] [--pool N] [--fresh-ms N]\n"
+            "          [--cache-ttl-sec N] [--cache-distance BITS] [--logprobs] [--stats-sec N]\n"
+            "          [--host H --backend-port N [--tls]]   (a Gemini-compatible mock instead of Gemini)\n",
+            prog);
+}
+
+static bool parseArgs(int argc, char** argv) {
+    if (const char* key = getenv("GEMINI_API_KEY")) {
+        config.api_key = key;
+    }
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--tls") {
+            config.backend_tls = true;
+            continue;
+        }
+        if (arg == "--logprobs") {
+            config.logprobs = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--port") config.port = atoi(value);
+        else if (arg == "--key") config.api_key = value;
+        else if (arg == "--model") config.model = value;
+        else if (arg == "--pool") config.pool = atoi(value);
+        else if (arg == "--fresh-ms") config.fresh_ms = atoi(value);
+        else if (arg == "--cache-ttl-sec") config.cache_ttl_ms = atoi(value) * 1000u;
+        else if (arg == "--cache-distance") config.cache_distance = atoi(value);
+        else if (arg == "--stats-sec") config.stats_sec = atoi(value);
+        else if (arg == "--host") config.host = value;
+        else if (arg == "--backend-port") config.backend_port = atoi(value);
+        else return false;
+    }
+    if (config.api_key.empty() && !config.host.empty()) {
+        config.api_key = "gateway";
+    }
+    return !config.api_key.empty() && config.pool > 0 && config.cache_distance >= 0 && config.cache_distance <= 64;
+}
+
+static void statsLoop() {
+    for (;;) {
+        std::this_thread::sleep_for(std::chrono::seconds(config.stats_sec));
+        printf("[gateway] %s\n", statusJson().c_str());
+        fflush(stdout);
+    }
+}
+
+int main(int argc, char** argv) {
+    if (!parseArgs(argc, argv)) {
+        usage(argv[0]);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    if (config.host.empty()) {
+        backend = visionGeminiBackend(config.model.c_str());
+    } else {
+        backend = visionMockBackend(config.host.c_str(), config.backend_port, config.backend_tls);
+    }
+    visionSetBackend(&backend);
+
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(config.port);
+    if (bind(server, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(server, 128) < 0) {
+        perror("bind");
+        return 1;
+    }
+
+    for (int i = 0; i < config.pool; i++) {
+        std::thread(runWorker).detach();
+    }
+    if (config.stats_sec > 0) {
+        std::thread(statsLoop).detach();
+    }
+    printf("[gateway] listening on http://0.0.0.0:%d, %d connection(s) to %s://%s:%u, cache %u s within %d bits\n",
+           config.port, config.pool, backend.use_tls ? "https" : "http", backend.host, (unsigned)backend.port,
+           (unsigned)(config.cache_ttl_ms / 1000), config.cache_distance);
+    fflush(stdout);
+
+    for (;;) {
+        int fd = accept(server, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+        std::thread(serveDevice, fd).detach();
+    }
+}
@@ -0,0 +1,36 @@
+#include "host_camera.h"
+#include "vision_backend.h"
+#include <stdlib.h>
+
+static const uint8_t* s_frame = NULL;
+static size_t s_frame_len = 0;
+
+void hostCameraSetFrame(const uint8_t* jpeg, size_t len) {
+    s_frame = jpeg;
+    s_frame_len = len;
+}
+
+char* captureImageAsGeminiJson(const char* prompt, size_t* encoded_size, const char* gemini_key) {
+    if (!prompt || !gemini_key || !s_frame) {
+        return NULL;
+    }
+
+    VisionRequest request = {prompt, s_frame, s_frame_len, NULL, NULL, false};
+    VisionEncoder encoder;
+    if (!visionEncoderInit(&encoder, visionGetBackend(), &request)) {
+        return NULL;
+    }
+
+    size_t json_len = visionEncoderLength(&encoder);
+    char* json_buffer = (char*)malloc(json_len + 1);
+    if (!json_buffer) {
+        return NULL;
+    }
+    json_len = visionEncoderRead(&encoder, json_buffer, json_len);
+    json_buffer[json_len] = '\0';
+
+    if (encoded_size) {
+        *encoded_size = json_len;
+    }
+    return json_buffer;
+}
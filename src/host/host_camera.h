@@ -0,0 +1,27 @@
+#ifndef HOST_CAMERA_H
+#define HOST_CAMERA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Host stand-in for the camera: set the JPEG the next capture returns
+ * @param jpeg JPEG bytes, must stay valid until the next call
+ * @param len JPEG length
+ */
+void hostCameraSetFrame(const uint8_t* jpeg, size_t len);
+
+/**
+ * Same contract as the device version in custom_cam.h, backed by hostCameraSetFrame
+ */
+char* captureImageAsGeminiJson(const char* prompt, size_t* encoded_size, const char* gemini_key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_CAMERA_H */
@@ -0,0 +1,191 @@
+// Benchmark for the DC-coefficient thumbnail extractor.
+//
+// Times jpegDcThumbnail against libjpeg decoding the same JPEGs in full and
+// at libjpeg's own 1/8 scale, and reports how far the DC thumbnail is from
+// libjpeg's 1/8-scale luma.
+//
+//   pio run -e jpeg_dc_bench
+//   .pio/build/jpeg_dc_bench/program [--iterations N] [frame.jpg ...]
+//
+// Without files it encodes a synthetic UXGA 4:2:2 frame, like the OV2640's.
+
+#include "jpeg_dc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <jpeglib.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// MARK: Timing
+static double nowUs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+template <typename Fn>
+static double medianUs(int iterations, Fn fn) {
+    std::vector<double> samples;
+    for (int i = 0; i < iterations; i++) {
+        double start = nowUs();
+        fn();
+        samples.push_back(nowUs() - start);
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+// MARK: libjpeg
+/**
+ * Decode with libjpeg
+ * @param scale_denom 1 for a full decode, 8 for libjpeg's DC-only scaling
+ * @param luma Receives the Y plane if not NULL
+ */
+static bool libjpegDecode(const std::vector<uint8_t>& jpeg, int scale_denom, std::vector<uint8_t>* luma,
+                          int* width, int* height) {
+    jpeg_decompress_struct cinfo;
+    jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, jpeg.data(), jpeg.size());
+    if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = scale_denom;
+    if (luma) {
+        cinfo.out_color_space = JCS_GRAYSCALE;
+    }
+    jpeg_start_decompress(&cinfo);
+
+    size_t stride = cinfo.output_width * cinfo.output_components;
+    std::vector<uint8_t> rows(stride * cinfo.output_height);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = rows.data() + cinfo.output_scanline * stride;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    if (width) *width = cinfo.output_width;
+    if (height) *height = cinfo.output_height;
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+
+    if (luma) {
+        luma->swap(rows);
+    }
+    return true;
+}
+
+/**
+ * Encode a synthetic frame: gradients, edges and noise, 4:2:2 like the OV2640
+ */
+static std::vector<uint8_t> syntheticFrame(int width, int height, int quality) {
+    std::vector<uint8_t> rgb(width * height * 3);
+    srand(1);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint8_t* p = &rgb[(y * width + x) * 3];
+            bool box = x > width / 3 && x < width / 2 && y > height / 4 && y < height * 3 / 4;
+            int noise = rand() % 8;
+            p[0] = box ? 200 + noise / 2 : (x * 255 / width + noise) & 255;
+            p[1] = box ? 60 + noise : (y * 255 / height + noise) & 255;
+            p[2] = ((x / 40 + y / 40) & 1) ? 180 : 40 + noise;
+        }
+    }
+
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    unsigned char* out = NULL;
+    unsigned long out_len = 0;
+    jpeg_mem_dest(&cinfo, &out, &out_len);
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    cinfo.comp_info[0].h_samp_factor = 2;
+    cinfo.comp_info[0].v_samp_factor = 1;
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        JSAMPROW row = &rgb[cinfo.next_scanline * width * 3];
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    std::vector<uint8_t> jpeg(out, out + out_len);
+    free(out);
+    return jpeg;
+}
+
+// MARK: Bench
+static bool bench(const std::string& name, const std::vector<uint8_t>& jpeg, int iterations) {
+    static Thumbnail thumb;
+    if (!jpegDcThumbnail(jpeg.data(), jpeg.size(), &thumb)) {
+        printf("%s: not a baseline JPEG the extractor supports\n", name.c_str());
+        return false;
+    }
+
+    std::vector<uint8_t> reference;
+    int ref_width = 0;
+    int ref_height = 0;
+    libjpegDecode(jpeg, 8, &reference, &ref_width, &ref_height);
+
+    // libjpeg's 1/8 output is the same per-block average, up to rounding
+    double error = 0;
+    int worst = 0;
+    int compared = 0;
+    for (int y = 0; y < thumb.height && y < ref_height; y++) {
+        for (int x = 0; x < thumb.width && x < ref_width; x++) {
+            int diff = abs((int)thumb.pixels[y * thumb.width + x] - (int)reference[y * ref_width + x]);
+            error += diff;
+            worst = std::max(worst, diff);
+            compared++;
+        }
+    }
+
+    double dc = medianUs(iterations, [&] { jpegDcThumbnail(jpeg.data(), jpeg.size(), &thumb); });
+    double full = medianUs(iterations, [&] { libjpegDecode(jpeg, 1, NULL, NULL, NULL); });
+    double eighth = medianUs(iterations, [&] { libjpegDecode(jpeg, 8, NULL, NULL, NULL); });
+
+    printf("%s: %zu bytes -> %ux%u thumbnail\n", name.c_str(), jpeg.size(), thumb.width, thumb.height);
+    printf("  jpegDcThumbnail   %8.0f us\n", dc);
+    printf("  libjpeg full      %8.0f us  (%.1fx)\n", full, full / dc);
+    printf("  libjpeg 1/8 scale %8.0f us  (%.1fx)\n", eighth, eighth / dc);
+    printf("  vs libjpeg 1/8 luma: mean abs error %.2f, max %d\n", compared ? error / compared : 0.0, worst);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int iterations = 50;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+
+    bool ok = true;
+    if (files.empty()) {
+        ok = bench("synthetic UXGA q90", syntheticFrame(1600, 1200, 90), iterations);
+        ok = bench("synthetic SVGA q70", syntheticFrame(800, 600, 70), iterations) && ok;
+    }
+    for (const std::string& file : files) {
+        std::ifstream in(file, std::ios::binary);
+        std::vector<uint8_t> jpeg((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        ok = bench(file, jpeg, iterations) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,272 @@
+// Benchmark for the budget-targeting JPEG re-encoder.
+//
+// Decodes each frame with libjpeg at 1/2 and 1/4 scale (what esp_jpg_decode
+// hands the device), then times jpegPrepare, a single jpegEncode, the
+// strip-at-a-time JpegStream and the budget search, per pixel, against
+// libjpeg encoding the same pixels. The output is decoded again by libjpeg
+// to check it and measure its PSNR; the streamed output must match it.
+//
+//   pio run -e jpeg_encode_bench
+//   .pio/build/jpeg_encode_bench/program [--iterations N] [--budget-kb N] [frame.jpg ...]
+//
+// Without files it encodes a synthetic UXGA 4:2:2 frame, like the OV2640's.
+
+#include "jpeg_encode.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <jpeglib.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// MARK: Timing
+static double nowUs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+typedef struct {
+    double us;
+    double cycles;
+} Timing;
+
+template <typename Fn>
+static Timing median(int iterations, Fn fn) {
+    std::vector<double> us;
+    std::vector<double> cyc;
+    for (int i = 0; i < iterations; i++) {
+        double start = nowUs();
+        uint64_t start_cycles = cycles();
+        fn();
+        cyc.push_back((double)(cycles() - start_cycles));
+        us.push_back(nowUs() - start);
+    }
+    std::sort(us.begin(), us.end());
+    std::sort(cyc.begin(), cyc.end());
+    return {us[us.size() / 2], cyc[cyc.size() / 2]};
+}
+
+// MARK: libjpeg
+static bool libjpegDecode(const std::vector<uint8_t>& jpeg, int scale_denom, std::vector<uint8_t>* rgb, int* width,
+                          int* height) {
+    jpeg_decompress_struct cinfo;
+    jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, jpeg.data(), jpeg.size());
+    if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = scale_denom;
+    cinfo.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&cinfo);
+
+    size_t stride = cinfo.output_width * 3;
+    rgb->resize(stride * cinfo.output_height);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = rgb->data() + cinfo.output_scanline * stride;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    *width = cinfo.output_width;
+    *height = cinfo.output_height;
+    bool clean = jerr.num_warnings == 0;
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return clean;
+}
+
+static std::vector<uint8_t> libjpegEncode(const uint8_t* rgb, int width, int height, int quality, bool subsample_422) {
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    unsigned char* out = NULL;
+    unsigned long out_len = 0;
+    jpeg_mem_dest(&cinfo, &out, &out_len);
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    if (subsample_422) {
+        cinfo.comp_info[0].h_samp_factor = 2;
+        cinfo.comp_info[0].v_samp_factor = 1;
+    }
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        JSAMPROW row = (JSAMPROW)&rgb[cinfo.next_scanline * width * 3];
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    std::vector<uint8_t> jpeg(out, out + out_len);
+    free(out);
+    return jpeg;
+}
+
+/**
+ * Synthetic frame: gradients, edges and noise, 4:2:2 like the OV2640
+ */
+static std::vector<uint8_t> syntheticFrame(int width, int height, int quality) {
+    std::vector<uint8_t> rgb(width * height * 3);
+    srand(1);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint8_t* p = &rgb[(y * width + x) * 3];
+            bool box = x > width / 3 && x < width / 2 && y > height / 4 && y < height * 3 / 4;
+            int noise = rand() % 8;
+            p[0] = box ? 200 + noise / 2 : (x * 255 / width + noise) & 255;
+            p[1] = box ? 60 + noise : (y * 255 / height + noise) & 255;
+            p[2] = ((x / 40 + y / 40) & 1) ? 180 : 40 + noise;
+        }
+    }
+    return libjpegEncode(rgb.data(), width, height, quality, true);
+}
+
+static double psnr(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b) {
+    double sum = 0;
+    size_t n = std::min(a.size(), b.size());
+    for (size_t i = 0; i < n; i++) {
+        double d = (double)a[i] - b[i];
+        sum += d * d;
+    }
+    return sum == 0 ? 99.0 : 10 * log10(255.0 * 255.0 * n / sum);
+}
+
+// MARK: Bench
+static void printTiming(const char* label, Timing t, double pixels) {
+    printf("  %-22s %8.0f us %7.1f ns/px", label, t.us, t.us * 1000 / pixels);
+    if (t.cycles > 0) printf(" %6.1f cycles/px", t.cycles / pixels);
+    printf("\n");
+}
+
+static bool bench(const std::string& name, const std::vector<uint8_t>& frame, int iterations, size_t budget) {
+    bool ok = true;
+    for (int scale = 2; scale <= 4; scale *= 2) {
+        std::vector<uint8_t> rgb;
+        int width = 0;
+        int height = 0;
+        if (!libjpegDecode(frame, scale, &rgb, &width, &height)) {
+            printf("%s: libjpeg could not decode it\n", name.c_str());
+            return false;
+        }
+        double pixels = (double)width * height;
+
+        std::vector<int16_t> coeff_buf(jpegCoefficientBytes(width, height, true) / sizeof(int16_t));
+        JpegCoefficients coeffs = {coeff_buf.data(), 0, 0, false};
+        std::vector<uint8_t> out(std::max(budget, rgb.size()));
+
+        Timing prepare = median(iterations, [&] {
+            jpegPrepare(rgb.data(), width, height, JPEG_INPUT_RGB888, &coeffs);
+        });
+        size_t len80 = 0;
+        Timing encode80 = median(iterations, [&] { len80 = jpegEncode(&coeffs, 80, out.data(), out.size()); });
+        std::vector<uint8_t> ours80(out.begin(), out.begin() + len80);
+
+        std::vector<int16_t> row_buf(jpegCoefficientBytes(width, jpegStripRows(true), true) / sizeof(int16_t));
+        JpegStream stream = {};
+        stream.coeffs = row_buf.data();
+        stream.width = width;
+        stream.height = height;
+        stream.color = true;
+        size_t streamed80 = 0;
+        Timing streamed = median(iterations, [&] {
+            jpegStreamBegin(&stream, 80, out.data(), out.size());
+            for (int y = 0; y < height; y += jpegStripRows(true)) {
+                jpegStreamStrip(&stream, rgb.data() + (size_t)y * width * 3);
+            }
+            streamed80 = jpegStreamEnd(&stream);
+        });
+        bool same = streamed80 == len80 && memcmp(out.data(), ours80.data(), len80) == 0;
+
+        uint8_t quality = 0;
+        size_t fitted = 0;
+        Timing search = median(iterations, [&] {
+            fitted = jpegEncodeToBudget(&coeffs, budget, 10, 90, out.data(), &quality);
+        });
+
+        std::vector<uint8_t> lib80;
+        Timing libjpeg = median(iterations, [&] { lib80 = libjpegEncode(rgb.data(), width, height, 80, false); });
+
+        std::vector<uint8_t> decoded;
+        int dw = 0;
+        int dh = 0;
+        bool valid = libjpegDecode(ours80, 1, &decoded, &dw, &dh) && dw == width && dh == height;
+        double ours_psnr = valid ? psnr(rgb, decoded) : 0;
+        libjpegDecode(lib80, 1, &decoded, &dw, &dh);
+        double lib_psnr = psnr(rgb, decoded);
+
+        printf("%s at 1/%d: %dx%d\n", name.c_str(), scale, width, height);
+        printTiming("jpegPrepare", prepare, pixels);
+        printTiming("jpegEncode q80", encode80, pixels);
+        printTiming("prepare + encode q80", {prepare.us + encode80.us, prepare.cycles + encode80.cycles}, pixels);
+        printTiming("jpegStream q80", streamed, pixels);
+        printTiming("prepare + budget", {prepare.us + search.us, prepare.cycles + search.cycles}, pixels);
+        printTiming("libjpeg q80", libjpeg, pixels);
+        printf("  q80: %zu bytes, %.2f dB; libjpeg q80: %zu bytes, %.2f dB\n", len80, ours_psnr, lib80.size(),
+               lib_psnr);
+        if (fitted) {
+            printf("  budget %zu bytes: q%u, %zu bytes\n", budget, quality, fitted);
+        } else {
+            printf("  budget %zu bytes: does not fit at q10\n", budget);
+        }
+        if (!valid) {
+            printf("  libjpeg rejected the output\n");
+            ok = false;
+        }
+        if (!same) {
+            printf("  streamed output differs from jpegEncode's\n");
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    int iterations = 20;
+    size_t budget = 24 * 1024;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--budget-kb") == 0 && i + 1 < argc) {
+            budget = atoi(argv[++i]) * 1024;
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+
+    bool ok = true;
+    if (files.empty()) {
+        ok = bench("synthetic UXGA q90", syntheticFrame(1600, 1200, 90), iterations, budget);
+    }
+    for (const std::string& file : files) {
+        std::ifstream in(file, std::ios::binary);
+        std::vector<uint8_t> jpeg((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        ok = bench(file, jpeg, iterations, budget) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,410 @@
+// Fleet load generator and soak test.
+//
+// Runs the host build of the device pipeline
+//   captureImageAsGeminiJson -> sendToGeminiAPI -> parseGeminiResponse
+// as N simulated devices against a backend (normally mock_server), and
+// reports throughput, latency percentiles, error rates and memory
+// high-water marks.
+//
+// Each device is a separate process, so per-device state in the client
+// (latency windows, hedge budget, warm connection) behaves as it does on
+// real hardware.
+//
+//   pio run -e loadgen
+//   .pio/build/loadgen/program --devices 20 --rate 30 --duration 120 --corpus ./images
+
+#include "host_camera.h"
+#include "platform_port.h"
+#include "request_scheduler.h"
+#include "vision_backend.h"
+#include "vision_client.h"
+#include "vision_transport.h"
+#include "waste_classifier.h"
+
+#include <dirent.h>
+#include <malloc.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+static const char* DEFAULT_PROMPT = WASTE_PROMPT;
+
+// MARK: Config
+struct LoadConfig {
+    int devices = 10;
+    double rate_per_min = 20;     // Mean triggers per device per minute
+    int duration_sec = 60;
+    std::string corpus;
+    size_t synthetic_kb = 200;    // Image size when no corpus is given
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    bool tls = false;
+    std::string model;
+    std::string api_key = "loadgen";
+    int hedge_per_min = 0;
+    bool chunked = false;
+    bool prewarm = false;
+    int rate_limit = 0;           // Scheduler requests per minute per device, 0 for backoff only
+    uint32_t fresh_for_ms = 3000; // Longest wait for a token before degrading
+    std::string csv;
+};
+
+static LoadConfig config;
+
+// MARK: Records
+enum RecordKind : uint8_t {
+    RECORD_REQUEST = 1,
+    RECORD_SUMMARY = 2
+};
+
+enum Outcome : uint8_t {
+    OUTCOME_OK = 0,
+    OUTCOME_CAPTURE_FAILED,
+    OUTCOME_REQUEST_FAILED,
+    OUTCOME_PARSE_FAILED,
+    OUTCOME_THROTTLED,            // Backend answered 429/503
+    OUTCOME_DEGRADED,             // Scheduler refused, no request sent
+    OUTCOME_COUNT
+};
+
+struct Record {
+    uint8_t kind;
+    uint8_t outcome;
+    uint16_t device;
+    uint32_t start_ms;
+    uint32_t encode_ms;
+    uint32_t request_ms;
+    uint32_t parse_us;
+    uint32_t payload_bytes;
+    // Summary only
+    uint32_t triggers;
+    uint32_t dropped;
+    uint64_t peak_heap;
+    uint64_t peak_rss_kb;
+};
+
+// MARK: Corpus
+static std::vector<std::vector<uint8_t>> loadCorpus() {
+    std::vector<std::vector<uint8_t>> images;
+    if (!config.corpus.empty()) {
+        DIR* dir = opendir(config.corpus.c_str());
+        if (dir) {
+            while (dirent* entry = readdir(dir)) {
+                std::string name = entry->d_name;
+                std::string lower = name;
+                std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+                if (lower.size() < 4 || (lower.substr(lower.size() - 4) != ".jpg" && lower.substr(lower.size() - 5) != ".jpeg")) {
+                    continue;
+                }
+                std::ifstream in(config.corpus + "/" + name, std::ios::binary);
+                images.emplace_back(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            }
+            closedir(dir);
+        }
+    }
+
+    if (images.empty()) {
+        // Random bytes behind a JPEG SOI marker; the mock never decodes them
+        std::mt19937 rng(42);
+        std::vector<uint8_t> image(config.synthetic_kb * 1024);
+        for (auto& b : image) b = (uint8_t)rng();
+        image[0] = 0xFF;
+        image[1] = 0xD8;
+        images.push_back(image);
+    }
+    return images;
+}
+
+// MARK: Device
+static uint64_t heapInUse() {
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+static void runDevice(int id, int out_fd, const std::vector<std::vector<uint8_t>>& corpus) {
+    static VisionBackend backend;
+    backend = visionMockBackend(config.host.c_str(), config.port, config.tls);
+    if (!config.model.empty()) {
+        backend.model = config.model.c_str();
+    }
+    visionSetBackend(&backend);
+    visionSetChunkedUpload(config.chunked);
+    if (config.hedge_per_min > 0) {
+        visionSetHedging(true, config.hedge_per_min);
+    }
+    if (config.rate_limit > 0) {
+        schedulerConfigure(config.rate_limit, 3);
+    }
+
+    std::mt19937 rng(1000 + id);
+    std::exponential_distribution<double> gap(config.rate_per_min / 60000.0);
+    std::uniform_int_distribution<size_t> pick(0, corpus.size() - 1);
+
+    Record summary = {};
+    summary.kind = RECORD_SUMMARY;
+    summary.device = id;
+
+    uint32_t end = millis() + config.duration_sec * 1000u;
+    double next_trigger = millis() + gap(rng);
+    while (next_trigger < end) {
+        uint32_t now = millis();
+        if (now < next_trigger) {
+            delay((uint32_t)(next_trigger - now));
+        }
+        summary.triggers++;
+
+        const std::vector<uint8_t>& image = corpus[pick(rng)];
+        hostCameraSetFrame(image.data(), image.size());
+
+        Record rec = {};
+        rec.kind = RECORD_REQUEST;
+        rec.device = id;
+        rec.start_ms = millis();
+
+        if (config.prewarm) {
+            visionConnPrewarm(visionGetBackend());
+        }
+
+        size_t encoded_size = 0;
+        char* json = captureImageAsGeminiJson(DEFAULT_PROMPT, &encoded_size, config.api_key.c_str());
+        rec.encode_ms = millis() - rec.start_ms;
+        rec.payload_bytes = encoded_size;
+        summary.peak_heap = std::max(summary.peak_heap, heapInUse());
+
+        uint32_t age = millis() - rec.start_ms;
+        if (!json) {
+            rec.outcome = OUTCOME_CAPTURE_FAILED;
+        } else if (age >= config.fresh_for_ms || !schedulerAcquire(REQUEST_FRESH, config.fresh_for_ms - age)) {
+            rec.outcome = OUTCOME_DEGRADED;
+            free(json);
+        } else {
+            uint32_t sent = millis();
+            char* response = sendToGeminiAPI(json, config.api_key.c_str());
+            rec.request_ms = millis() - sent;
+            summary.peak_heap = std::max(summary.peak_heap, heapInUse());
+            VisionResponseInfo info = visionLastResponse();
+            schedulerReportResponse(info.status, info.retry_after_ms);
+
+            if (!response) {
+                rec.outcome = info.status == 429 || info.status == 503 ? OUTCOME_THROTTLED : OUTCOME_REQUEST_FAILED;
+            } else {
+                timespec a, b;
+                clock_gettime(CLOCK_MONOTONIC, &a);
+                int verdict = parseGeminiResponse(response);
+                clock_gettime(CLOCK_MONOTONIC, &b);
+                rec.parse_us = (b.tv_sec - a.tv_sec) * 1000000 + (b.tv_nsec - a.tv_nsec) / 1000;
+                rec.outcome = verdict == TYPE_ERROR ? OUTCOME_PARSE_FAILED : OUTCOME_OK;
+                free(response);
+            }
+            free(json);
+        }
+        if (write(out_fd, &rec, sizeof(rec)) != sizeof(rec)) {
+            break;
+        }
+
+        // Triggers that arrive while busy are lost, as on the device
+        next_trigger += gap(rng);
+        while (next_trigger < millis()) {
+            summary.dropped++;
+            summary.triggers++;
+            next_trigger += gap(rng);
+        }
+    }
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    summary.peak_rss_kb = usage.ru_maxrss;
+    if (write(out_fd, &summary, sizeof(summary)) != sizeof(summary)) {
+        _exit(1);
+    }
+}
+
+// MARK: Report
+static uint32_t percentile(std::vector<uint32_t> values, double p) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    size_t index = (size_t)((values.size() - 1) * p);
+    return values[index];
+}
+
+static void printRow(const char* name, const std::vector<uint32_t>& values) {
+    printf("  %-10s %8u %8u %8u %8u %8u\n", name,
+           percentile(values, 0.50), percentile(values, 0.90),
+           percentile(values, 0.99), percentile(values, 0.999), percentile(values, 1.0));
+}
+
+static void report(const std::vector<Record>& requests, const std::vector<Record>& summaries, uint32_t wall_ms) {
+    std::vector<uint32_t> encode, request, total, parse;
+    size_t outcomes[OUTCOME_COUNT] = {};
+    uint64_t bytes = 0;
+    for (const Record& r : requests) {
+        outcomes[r.outcome]++;
+        encode.push_back(r.encode_ms);
+        bytes += r.payload_bytes;
+        if (r.outcome == OUTCOME_OK || r.outcome == OUTCOME_PARSE_FAILED) {
+            request.push_back(r.request_ms);
+            total.push_back(r.encode_ms + r.request_ms);
+            parse.push_back(r.parse_us);
+        }
+    }
+
+    uint64_t triggers = 0, dropped = 0, peak_heap = 0, heap_sum = 0, peak_rss = 0;
+    for (const Record& s : summaries) {
+        triggers += s.triggers;
+        dropped += s.dropped;
+        peak_heap = std::max(peak_heap, s.peak_heap);
+        heap_sum += s.peak_heap;
+        peak_rss = std::max(peak_rss, s.peak_rss_kb);
+    }
+
+    double secs = wall_ms / 1000.0;
+    size_t n = requests.size();
+    printf("\n== loadgen: %d devices x %.1f triggers/min for %.1f s against %s:%d ==\n",
+           config.devices, config.rate_per_min, secs, config.host.c_str(), config.port);
+    printf("triggers %llu, dropped while busy %llu, completed %zu\n",
+           (unsigned long long)triggers, (unsigned long long)dropped, n);
+    printf("throughput %.2f req/s, upload %.2f MB/s\n", n / secs, bytes / secs / 1e6);
+    if (n > 0) {
+        printf("errors %.2f%% (capture %zu, request %zu, parse %zu, throttled %zu), degraded %zu\n",
+               100.0 * (n - outcomes[OUTCOME_OK] - outcomes[OUTCOME_DEGRADED]) / n,
+               outcomes[OUTCOME_CAPTURE_FAILED], outcomes[OUTCOME_REQUEST_FAILED], outcomes[OUTCOME_PARSE_FAILED],
+               outcomes[OUTCOME_THROTTLED], outcomes[OUTCOME_DEGRADED]);
+    }
+    printf("latency ms        p50      p90      p99    p99.9      max\n");
+    printRow("encode", encode);
+    printRow("request", request);
+    printRow("total", total);
+    printf("  %-10s %8u %8u %8u %8u %8u  (us)\n", "parse",
+           percentile(parse, 0.50), percentile(parse, 0.90), percentile(parse, 0.99),
+           percentile(parse, 0.999), percentile(parse, 1.0));
+    if (!summaries.empty()) {
+        printf("memory: peak heap per device %.1f KB max, %.1f KB mean; peak RSS %llu KB\n",
+               peak_heap / 1024.0, heap_sum / 1024.0 / summaries.size(), (unsigned long long)peak_rss);
+    }
+}
+
+static void writeCsv(const std::vector<Record>& requests) {
+    FILE* f = fopen(config.csv.c_str(), "w");
+    if (!f) {
+        perror("csv");
+        return;
+    }
+    fprintf(f, "device,start_ms,outcome,encode_ms,request_ms,parse_us,payload_bytes\n");
+    for (const Record& r : requests) {
+        fprintf(f, "%u,%u,%u,%u,%u,%u,%u\n", r.device, r.start_ms, r.outcome,
+                r.encode_ms, r.request_ms, r.parse_us, r.payload_bytes);
+    }
+    fclose(f);
+}
+
+// MARK: Setup
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s [--devices N] [--rate TRIGGERS_PER_MIN] [--duration SEC]\n"
+            "          [--corpus DIR | --image-kb N] [--host H] [--port N] [--tls]\n"
+            "          [--model NAME] [--hedge N_PER_MIN] [--chunked] [--prewarm] [--csv FILE]\n"
+            "          [--rate-limit N_PER_MIN]\n",
+            prog);
+}
+
+static bool parseArgs(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--tls") { config.tls = true; continue; }
+        if (arg == "--chunked") { config.chunked = true; continue; }
+        if (arg == "--prewarm") { config.prewarm = true; continue; }
+
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--devices") config.devices = atoi(value);
+        else if (arg == "--rate") config.rate_per_min = atof(value);
+        else if (arg == "--duration") config.duration_sec = atoi(value);
+        else if (arg == "--corpus") config.corpus = value;
+        else if (arg == "--image-kb") config.synthetic_kb = atoi(value);
+        else if (arg == "--host") config.host = value;
+        else if (arg == "--port") config.port = atoi(value);
+        else if (arg == "--model") config.model = value;
+        else if (arg == "--key") config.api_key = value;
+        else if (arg == "--hedge") config.hedge_per_min = atoi(value);
+        else if (arg == "--rate-limit") config.rate_limit = atoi(value);
+        else if (arg == "--csv") config.csv = value;
+        else return false;
+    }
+    return config.devices > 0 && config.rate_per_min > 0 && config.duration_sec > 0;
+}
+
+int main(int argc, char** argv) {
+    if (!parseArgs(argc, argv)) {
+        usage(argv[0]);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<std::vector<uint8_t>> corpus = loadCorpus();
+    printf("[loadgen] %zu image(s), starting %d devices\n", corpus.size(), config.devices);
+    fflush(stdout);
+
+    std::vector<pollfd> pipes;
+    uint32_t start = millis();
+    for (int id = 0; id < config.devices; id++) {
+        int fds[2];
+        if (pipe(fds) != 0) {
+            perror("pipe");
+            return 1;
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            runDevice(id, fds[1], corpus);
+            _exit(0);
+        }
+        close(fds[1]);
+        pipes.push_back({fds[0], POLLIN, 0});
+    }
+
+    // Collect records until every device has closed its pipe
+    std::vector<Record> requests;
+    std::vector<Record> summaries;
+    size_t open_pipes = pipes.size();
+    while (open_pipes > 0) {
+        if (poll(pipes.data(), pipes.size(), -1) < 0) {
+            continue;
+        }
+        for (pollfd& p : pipes) {
+            if (p.fd < 0 || !(p.revents & (POLLIN | POLLHUP))) {
+                continue;
+            }
+            Record rec;
+            ssize_t n = read(p.fd, &rec, sizeof(rec));
+            if (n != sizeof(rec)) {
+                close(p.fd);
+                p.fd = -1;
+                open_pipes--;
+                continue;
+            }
+            (rec.kind == RECORD_SUMMARY ? summaries : requests).push_back(rec);
+        }
+    }
+    while (wait(NULL) > 0) {
+    }
+
+    report(requests, summaries, millis() - start);
+    if (!config.csv.empty()) {
+        writeCsv(requests);
+    }
+    return 0;
+}
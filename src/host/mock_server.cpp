@@ -0,0 +1,572 @@
+// Mock vision backend for Linux load tests.
+//
+// Speaks the Gemini generateContent wire format over HTTP or HTTPS and
+// replays canned answers after a configurable latency, so throughput and
+// tail latency can be measured without network access or API quota.
+//
+//   pio run -e mock_server
+//   .pio/build/mock_server/program --port 8080 --latency-ms 400 --tail-rate 0.05 --tail-ms 4000
+//
+// With --quota-per-min, requests over the quota get a 429 shaped like
+// Gemini's RESOURCE_EXHAUSTED error, with Retry-After and retryDelay.
+//
+// POST /v1beta/cachedContents creates a context cache entry that lives for
+// --cache-ttl-sec; generateContent naming an unknown or expired
+// "cachedContent" gets a 404 NOT_FOUND, like the real API.
+//
+// With --unsure-rate, that fraction of answers reports a low avgLogprobs,
+// exercising the device's re-query policy.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "waste_labels.h"
+
+// MARK: Config
+#define MOCK_ANSWER(id, name, pulse_ms) name,
+
+struct MockConfig {
+    int port = 8080;
+    int latency_ms = 300;
+    int jitter_ms = 100;
+    double tail_rate = 0.0;
+    int tail_ms = 0;
+    int stats_sec = 5;
+    int quota_per_min = 0;
+    int cache_ttl_sec = 3600;
+    double unsure_rate = 0.0;
+    std::string cert_file;
+    std::string key_file;
+    std::vector<std::string> answers = {WASTE_LABELS(MOCK_ANSWER, MOCK_ANSWER)};
+};
+
+static MockConfig config;
+static SSL_CTX* ssl_ctx = NULL;
+
+// MARK: Stats
+static std::atomic<uint64_t> stat_requests{0};
+static std::atomic<uint64_t> stat_bytes_in{0};
+static std::atomic<uint64_t> stat_connections{0};
+static std::atomic<uint64_t> answer_index{0};
+static std::atomic<uint64_t> stat_throttled{0};
+static std::atomic<uint64_t> stat_cached{0};
+
+// MARK: Stream
+struct Stream {
+    int fd;
+    SSL* ssl;
+};
+
+static int streamRead(Stream* s, char* buf, size_t len) {
+    if (s->ssl) {
+        return SSL_read(s->ssl, buf, (int)len);
+    }
+    return (int)recv(s->fd, buf, len, 0);
+}
+
+static bool streamWrite(Stream* s, const char* buf, size_t len) {
+    while (len > 0) {
+        int n = s->ssl ? SSL_write(s->ssl, buf, (int)len) : (int)send(s->fd, buf, len, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+// MARK: Request Parsing
+struct Request {
+    std::string method;
+    std::string path;
+    bool keep_alive = true;
+    size_t body_len = 0;
+    std::string body_head;  // Start of the body, enough to find "cachedContent"
+};
+
+static const size_t BODY_HEAD_SIZE = 512;
+
+// Buffered reader so header and body parsing can share one receive buffer
+struct Reader {
+    Stream* stream;
+    std::string buf;
+    size_t pos = 0;
+
+    bool fill() {
+        if (pos > 0 && pos == buf.size()) {
+            buf.clear();
+            pos = 0;
+        }
+        char tmp[16384];
+        int n = streamRead(stream, tmp, sizeof(tmp));
+        if (n <= 0) {
+            return false;
+        }
+        buf.append(tmp, n);
+        stat_bytes_in += n;
+        return true;
+    }
+
+    bool readLine(std::string* line) {
+        for (;;) {
+            size_t eol = buf.find('\n', pos);
+            if (eol != std::string::npos) {
+                line->assign(buf, pos, eol - pos);
+                if (!line->empty() && line->back() == '\r') {
+                    line->pop_back();
+                }
+                pos = eol + 1;
+                return true;
+            }
+            if (!fill()) {
+                return false;
+            }
+        }
+    }
+
+    // Skip len bytes, keeping the first ones in head until it holds BODY_HEAD_SIZE
+    bool skip(size_t len, std::string* head = NULL) {
+        while (len > 0) {
+            if (pos == buf.size() && !fill()) {
+                return false;
+            }
+            size_t n = std::min(len, buf.size() - pos);
+            if (head && head->size() < BODY_HEAD_SIZE) {
+                head->append(buf, pos, std::min(n, BODY_HEAD_SIZE - head->size()));
+            }
+            pos += n;
+            len -= n;
+        }
+        return true;
+    }
+};
+
+static bool readRequest(Reader* reader, Request* req) {
+    std::string line;
+    if (!reader->readLine(&line) || line.empty()) {
+        return false;
+    }
+
+    size_t sp1 = line.find(' ');
+    size_t sp2 = line.find(' ', sp1 + 1);
+    if (sp1 == std::string::npos || sp2 == std::string::npos) {
+        return false;
+    }
+    req->method = line.substr(0, sp1);
+    req->path = line.substr(sp1 + 1, sp2 - sp1 - 1);
+
+    long content_length = 0;
+    bool chunked = false;
+    while (reader->readLine(&line) && !line.empty()) {
+        if (strncasecmp(line.c_str(), "Content-Length:", 15) == 0) {
+            content_length = atol(line.c_str() + 15);
+        } else if (strncasecmp(line.c_str(), "Transfer-Encoding:", 18) == 0) {
+            chunked = strcasestr(line.c_str(), "chunked") != NULL;
+        } else if (strncasecmp(line.c_str(), "Connection:", 11) == 0) {
+            req->keep_alive = strcasestr(line.c_str(), "close") == NULL;
+        }
+    }
+
+    // Discard the body, we only care about its size and how it starts
+    req->body_len = 0;
+    req->body_head.clear();
+    if (chunked) {
+        for (;;) {
+            if (!reader->readLine(&line)) {
+                return false;
+            }
+            size_t chunk = strtoul(line.c_str(), NULL, 16);
+            if (chunk == 0) {
+                reader->readLine(&line); // Trailing CRLF
+                break;
+            }
+            if (!reader->skip(chunk, &req->body_head) || !reader->skip(2)) {
+                return false;
+            }
+            req->body_len += chunk;
+        }
+    } else if (content_length > 0) {
+        if (!reader->skip(content_length, &req->body_head)) {
+            return false;
+        }
+        req->body_len = content_length;
+    }
+    return true;
+}
+
+// MARK: Responses
+static std::string modelFromPath(const std::string& path) {
+    size_t start = path.find("/models/");
+    size_t end = path.find(':', start);
+    if (start == std::string::npos || end == std::string::npos) {
+        return "mock";
+    }
+    start += 8;
+    return path.substr(start, end - start);
+}
+
+static bool sendResponse(Stream* s, int status, const char* reason, const std::string& body, bool keep_alive,
+                         const std::string& extra_headers = "") {
+    char head[384];
+    int len = snprintf(head, sizeof(head),
+                       "HTTP/1.1 %d %s\r\n"
+                       "Content-Type: application/json; charset=UTF-8\r\n"
+                       "Content-Length: %zu\r\n"
+                       "Connection: %s\r\n"
+                       "%s"
+                       "\r\n",
+                       status, reason, body.size(), keep_alive ? "keep-alive" : "close", extra_headers.c_str());
+    return streamWrite(s, head, len) && streamWrite(s, body.data(), body.size());
+}
+
+// Per-token average: sure answers come back near 0, unsure ones around a probability of 0.3
+static const double SURE_LOGPROB = -0.05;
+static const double UNSURE_LOGPROB = -1.2;
+
+static std::string geminiAnswer(const std::string& model, const std::string& text, double logprob) {
+    char body[1024];
+    snprintf(body, sizeof(body),
+             "{\n"
+             "  \"candidates\": [\n"
+             "    {\n"
+             "      \"content\": {\n"
+             "        \"parts\": [\n"
+             "          {\n"
+             "            \"text\": \"%s\\n\"\n"
+             "          }\n"
+             "        ],\n"
+             "        \"role\": \"model\"\n"
+             "      },\n"
+             "      \"finishReason\": \"STOP\",\n"
+             "      \"avgLogprobs\": %.2f\n"
+             "    }\n"
+             "  ],\n"
+             "  \"usageMetadata\": {\n"
+             "    \"promptTokenCount\": 1320,\n"
+             "    \"candidatesTokenCount\": 2,\n"
+             "    \"totalTokenCount\": 1322\n"
+             "  },\n"
+             "  \"modelVersion\": \"%s\"\n"
+             "}\n",
+             text.c_str(), logprob, model.c_str());
+    return body;
+}
+
+static std::string quotaError(int retry_sec) {
+    char body[768];
+    snprintf(body, sizeof(body),
+             "{\n"
+             "  \"error\": {\n"
+             "    \"code\": 429,\n"
+             "    \"message\": \"Resource has been exhausted (e.g. check quota).\",\n"
+             "    \"status\": \"RESOURCE_EXHAUSTED\",\n"
+             "    \"details\": [\n"
+             "      {\n"
+             "        \"@type\": \"type.googleapis.com/google.rpc.RetryInfo\",\n"
+             "        \"retryDelay\": \"%ds\"\n"
+             "      }\n"
+             "    ]\n"
+             "  }\n"
+             "}\n",
+             retry_sec);
+    return body;
+}
+
+static std::string notFoundError(const std::string& message) {
+    char body[512];
+    snprintf(body, sizeof(body),
+             "{\n"
+             "  \"error\": {\n"
+             "    \"code\": 404,\n"
+             "    \"message\": \"%s\",\n"
+             "    \"status\": \"NOT_FOUND\"\n"
+             "  }\n"
+             "}\n",
+             message.c_str());
+    return body;
+}
+
+// MARK: Context Cache
+static std::mutex cache_lock;
+static std::map<std::string, std::chrono::steady_clock::time_point> cache_expiry;
+static uint64_t cache_counter = 0;
+
+static std::string cacheCreate() {
+    std::lock_guard<std::mutex> lock(cache_lock);
+    std::string name = "cachedContents/mock-" + std::to_string(++cache_counter);
+    cache_expiry[name] = std::chrono::steady_clock::now() + std::chrono::seconds(config.cache_ttl_sec);
+
+    char body[512];
+    snprintf(body, sizeof(body),
+             "{\n"
+             "  \"name\": \"%s\",\n"
+             "  \"model\": \"models/mock\",\n"
+             "  \"usageMetadata\": {\n"
+             "    \"totalTokenCount\": 4096\n"
+             "  }\n"
+             "}\n",
+             name.c_str());
+    return body;
+}
+
+/**
+ * @return The "cachedContent" a generateContent body refers to, empty if none
+ */
+static std::string cachedContentName(const std::string& body_head) {
+    static const char KEY[] = "\"cachedContent\"";
+    size_t pos = body_head.find(KEY);
+    if (pos == std::string::npos) {
+        return "";
+    }
+    size_t start = body_head.find('"', body_head.find(':', pos + sizeof(KEY) - 1));
+    size_t end = start == std::string::npos ? start : body_head.find('"', start + 1);
+    if (end == std::string::npos) {
+        return "";
+    }
+    return body_head.substr(start + 1, end - start - 1);
+}
+
+static bool cacheValid(const std::string& name) {
+    std::lock_guard<std::mutex> lock(cache_lock);
+    auto it = cache_expiry.find(name);
+    return it != cache_expiry.end() && std::chrono::steady_clock::now() < it->second;
+}
+
+// MARK: Quota
+static std::mutex quota_lock;
+static std::chrono::steady_clock::time_point quota_window_start = std::chrono::steady_clock::now();
+static int quota_used = 0;
+
+/**
+ * Count a request against the per-minute quota
+ * @return 0 if allowed, otherwise seconds until the window resets
+ */
+static int quotaTake() {
+    if (config.quota_per_min <= 0) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(quota_lock);
+    auto now = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - quota_window_start).count();
+    if (elapsed >= 60000) {
+        quota_window_start = now;
+        quota_used = 0;
+        elapsed = 0;
+    }
+    if (quota_used < config.quota_per_min) {
+        quota_used++;
+        return 0;
+    }
+    return (int)((60000 - elapsed + 999) / 1000);
+}
+
+static int sampleLatency(std::mt19937* rng) {
+    int latency = config.latency_ms;
+    if (config.jitter_ms > 0) {
+        latency += std::uniform_int_distribution<int>(0, config.jitter_ms)(*rng);
+    }
+    if (config.tail_rate > 0 && std::uniform_real_distribution<double>(0, 1)(*rng) < config.tail_rate) {
+        latency += config.tail_ms;
+    }
+    return latency;
+}
+
+// MARK: Connection
+static void serveConnection(int fd) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    stat_connections++;
+
+    Stream stream = {fd, NULL};
+    if (ssl_ctx) {
+        stream.ssl = SSL_new(ssl_ctx);
+        SSL_set_fd(stream.ssl, fd);
+        if (SSL_accept(stream.ssl) <= 0) {
+            SSL_free(stream.ssl);
+            close(fd);
+            return;
+        }
+    }
+
+    std::mt19937 rng(std::random_device{}() ^ (unsigned)fd);
+    Reader reader;
+    reader.stream = &stream;
+
+    Request req;
+    while (readRequest(&reader, &req)) {
+        stat_requests++;
+        std::string cached = cachedContentName(req.body_head);
+
+        if (req.method != "POST") {
+            if (!sendResponse(&stream, 404, "Not Found", "{}", req.keep_alive)) break;
+        } else if (int retry_sec = quotaTake()) {
+            stat_throttled++;
+            std::string retry_after = "Retry-After: " + std::to_string(retry_sec) + "\r\n";
+            if (!sendResponse(&stream, 429, "Too Many Requests", quotaError(retry_sec), req.keep_alive, retry_after)) break;
+        } else if (req.path.compare(0, 22, "/v1beta/cachedContents") == 0) {
+            if (!sendResponse(&stream, 200, "OK", cacheCreate(), req.keep_alive)) break;
+        } else if (!cached.empty() && !cacheValid(cached)) {
+            std::string message = "CachedContent not found (or permission denied): " + cached;
+            if (!sendResponse(&stream, 404, "Not Found", notFoundError(message), req.keep_alive)) break;
+        } else {
+            if (!cached.empty()) stat_cached++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(sampleLatency(&rng)));
+            const std::string& answer = config.answers[answer_index++ % config.answers.size()];
+            bool unsure = config.unsure_rate > 0 && std::uniform_real_distribution<double>(0, 1)(rng) < config.unsure_rate;
+            std::string body = geminiAnswer(modelFromPath(req.path), answer, unsure ? UNSURE_LOGPROB : SURE_LOGPROB);
+            if (!sendResponse(&stream, 200, "OK", body, req.keep_alive)) break;
+        }
+
+        if (!req.keep_alive) break;
+        req = Request();
+    }
+
+    if (stream.ssl) {
+        SSL_shutdown(stream.ssl);
+        SSL_free(stream.ssl);
+    }
+    close(fd);
+}
+
+// MARK: Setup
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s [--port N] [--latency-ms N] [--jitter-ms N] [--tail-rate P --tail-ms N]\n"
+            "          [--answers FILE] [--cert FILE --key FILE] [--stats-sec N] [--quota-per-min N]\n"
+            "          [--cache-ttl-sec N] [--unsure-rate P]\n",
+            prog);
+}
+
+static bool parseArgs(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!value) {
+            return false;
+        }
+        i++;
+
+        if (arg == "--port") config.port = atoi(value);
+        else if (arg == "--latency-ms") config.latency_ms = atoi(value);
+        else if (arg == "--jitter-ms") config.jitter_ms = atoi(value);
+        else if (arg == "--tail-rate") config.tail_rate = atof(value);
+        else if (arg == "--tail-ms") config.tail_ms = atoi(value);
+        else if (arg == "--stats-sec") config.stats_sec = atoi(value);
+        else if (arg == "--quota-per-min") config.quota_per_min = atoi(value);
+        else if (arg == "--cache-ttl-sec") config.cache_ttl_sec = atoi(value);
+        else if (arg == "--unsure-rate") config.unsure_rate = atof(value);
+        else if (arg == "--cert") config.cert_file = value;
+        else if (arg == "--key") config.key_file = value;
+        else if (arg == "--answers") {
+            std::ifstream in(value);
+            std::vector<std::string> answers;
+            std::string line;
+            while (std::getline(in, line)) {
+                if (!line.empty()) answers.push_back(line);
+            }
+            if (answers.empty()) {
+                fprintf(stderr, "no answers in %s\n", value);
+                return false;
+            }
+            config.answers = answers;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool initTls() {
+    if (config.cert_file.empty()) {
+        return true;
+    }
+    ssl_ctx = SSL_CTX_new(TLS_server_method());
+    if (!ssl_ctx ||
+        SSL_CTX_use_certificate_chain_file(ssl_ctx, config.cert_file.c_str()) <= 0 ||
+        SSL_CTX_use_PrivateKey_file(ssl_ctx, config.key_file.c_str(), SSL_FILETYPE_PEM) <= 0) {
+        ERR_print_errors_fp(stderr);
+        return false;
+    }
+    return true;
+}
+
+static void statsLoop() {
+    uint64_t last_requests = 0;
+    uint64_t last_bytes = 0;
+    for (;;) {
+        std::this_thread::sleep_for(std::chrono::seconds(config.stats_sec));
+        uint64_t requests = stat_requests;
+        uint64_t bytes = stat_bytes_in;
+        printf("[mock] %.1f req/s, %.2f MB/s in, %llu requests, %llu throttled, %llu cached, %llu connections\n",
+               (requests - last_requests) / (double)config.stats_sec,
+               (bytes - last_bytes) / (double)config.stats_sec / 1e6,
+               (unsigned long long)requests, (unsigned long long)stat_throttled.load(),
+               (unsigned long long)stat_cached.load(),
+               (unsigned long long)stat_connections.load());
+        fflush(stdout);
+        last_requests = requests;
+        last_bytes = bytes;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (!parseArgs(argc, argv)) {
+        usage(argv[0]);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    if (!initTls()) {
+        return 1;
+    }
+
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(config.port);
+    if (bind(server, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(server, 128) < 0) {
+        perror("bind");
+        return 1;
+    }
+
+    printf("[mock] listening on %s://0.0.0.0:%d, latency %d+%d ms, tail %.1f%% +%d ms, %zu answers\n",
+           ssl_ctx ? "https" : "http", config.port, config.latency_ms, config.jitter_ms,
+           config.tail_rate * 100, config.tail_ms, config.answers.size());
+    fflush(stdout);
+
+    if (config.stats_sec > 0) {
+        std::thread(statsLoop).detach();
+    }
+
+    for (;;) {
+        int fd = accept(server, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+        std::thread(serveConnection, fd).detach();
+    }
+}
@@ -0,0 +1,284 @@
+// Multi-camera controller simulation.
+//
+// Runs the controller's shared frame pipeline (frame_source.h) on Linux:
+// each simulated camera is a thread replaying corpus JPEGs at random
+// intervals into the queue, and the main thread drains it against a
+// backend (normally mock_server) the way the capture loop does between
+// items. Verdicts are routed back to the camera that queued the frame,
+// which checks it got its own answer and reports per-camera latency.
+//
+//   pio run -e multicam_sim
+//   .pio/build/multicam_sim/program --cameras 4 --rate 20 --duration 60 --corpus ./images
+
+#include "frame_source.h"
+#include "platform_port.h"
+#include "request_scheduler.h"
+#include "timer_wheel.h"
+#include "vision_backend.h"
+#include "vision_client.h"
+#include "waste_classifier.h"
+
+#include <dirent.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+static const char* DEFAULT_PROMPT = WASTE_PROMPT;
+
+// MARK: Config
+struct SimConfig {
+    int cameras = 4;
+    double rate_per_min = 20;     // Mean frames per camera per minute
+    int duration_sec = 60;
+    std::string corpus;
+    size_t synthetic_kb = 100;    // Image size when no corpus is given
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    std::string api_key = "multicam";
+    int rate_limit = 0;           // Controller requests per minute, 0 for backoff only
+    uint32_t fresh_for_ms = 3000;
+};
+
+static SimConfig config;
+static std::atomic<bool> running{true};
+
+// MARK: Simulated Camera
+struct SimCamera {
+    FrameSource source;
+    std::string name;
+    std::mutex lock;
+    std::vector<uint32_t> latencies;
+    uint32_t sent = 0;
+    uint32_t refused = 0;         // Queue full
+    uint32_t errors = 0;
+    uint32_t misrouted = 0;       // Verdict for a frame this camera never sent
+    std::atomic<int> in_flight{0};
+};
+
+/**
+ * One frame in flight; the owner pointer the queue hands back
+ */
+struct SimFrame {
+    SimCamera* camera;
+    uint8_t* jpeg;
+    uint32_t sent_ms;
+};
+
+static void simDeliver(FrameSource* source, const SourceFrame* frame, int waste_type) {
+    SimCamera* camera = (SimCamera*)source->ctx;
+    SimFrame* sim = (SimFrame*)frame->owner;
+    std::lock_guard<std::mutex> guard(camera->lock);
+    if (sim->camera != camera) {
+        camera->misrouted++;
+    }
+    if (waste_type == TYPE_ERROR) {
+        camera->errors++;
+    } else {
+        camera->latencies.push_back(millis() - sim->sent_ms);
+    }
+}
+
+static void simRelease(FrameSource* source, SourceFrame* frame) {
+    (void)source;
+    SimFrame* sim = (SimFrame*)frame->owner;
+    sim->camera->in_flight--;
+    free(sim->jpeg);
+    delete sim;
+}
+
+static const FrameSourceOps SIM_OPS = {simDeliver, simRelease};
+
+// MARK: Corpus
+static std::vector<std::vector<uint8_t>> loadCorpus() {
+    std::vector<std::vector<uint8_t>> images;
+    if (!config.corpus.empty()) {
+        DIR* dir = opendir(config.corpus.c_str());
+        if (dir) {
+            while (dirent* entry = readdir(dir)) {
+                std::string name = entry->d_name;
+                std::string lower = name;
+                std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+                if (lower.size() < 4 || (lower.substr(lower.size() - 4) != ".jpg" && lower.substr(lower.size() - 5) != ".jpeg")) {
+                    continue;
+                }
+                std::ifstream in(config.corpus + "/" + name, std::ios::binary);
+                images.emplace_back(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            }
+            closedir(dir);
+        }
+    }
+
+    if (images.empty()) {
+        // Random bytes behind a JPEG SOI marker; the mock never decodes them
+        std::mt19937 rng(42);
+        std::vector<uint8_t> image(config.synthetic_kb * 1024);
+        for (auto& b : image) b = (uint8_t)rng();
+        image[0] = 0xFF;
+        image[1] = 0xD8;
+        images.push_back(image);
+    }
+    return images;
+}
+
+static const std::vector<std::vector<uint8_t>>* s_corpus = NULL;
+
+// A camera pushes a frame per item, like a remote ESP32-CAM posting to /frame
+static void runCamera(void* arg) {
+    SimCamera* camera = (SimCamera*)arg;
+    std::mt19937 rng(1000 + camera->source.id);
+    std::exponential_distribution<double> gap(config.rate_per_min / 60000.0);
+    std::uniform_int_distribution<size_t> pick(0, s_corpus->size() - 1);
+
+    while (running) {
+        delay((uint32_t)gap(rng));
+        if (!running) {
+            break;
+        }
+        const std::vector<uint8_t>& image = (*s_corpus)[pick(rng)];
+        SimFrame* sim = new SimFrame{camera, (uint8_t*)malloc(image.size()), millis()};
+        memcpy(sim->jpeg, image.data(), image.size());
+
+        camera->in_flight++;
+        if (frameSourceSubmit(&camera->source, sim->jpeg, image.size(), sim)) {
+            std::lock_guard<std::mutex> guard(camera->lock);
+            camera->sent++;
+        } else {
+            camera->in_flight--;
+            free(sim->jpeg);
+            delete sim;
+            std::lock_guard<std::mutex> guard(camera->lock);
+            camera->refused++;
+        }
+    }
+}
+
+// MARK: Report
+static uint32_t percentile(std::vector<uint32_t> values, double p) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    size_t index = (size_t)((values.size() - 1) * p);
+    return values[index];
+}
+
+static void report(const std::vector<SimCamera*>& cameras, uint32_t wall_ms, uint32_t requests) {
+    printf("\n== multicam_sim: %d cameras x %.1f frames/min for %.1f s against %s:%d ==\n",
+           config.cameras, config.rate_per_min, wall_ms / 1000.0, config.host.c_str(), config.port);
+    printf("requests %u (%.2f req/s)\n", requests, requests * 1000.0 / wall_ms);
+    printf("camera      sent  refused   errors  misrouted      p50      p90      max\n");
+    for (SimCamera* camera : cameras) {
+        std::lock_guard<std::mutex> guard(camera->lock);
+        printf("%-8s %7u  %7u  %7u  %9u  %7u  %7u  %7u\n", camera->name.c_str(),
+               camera->sent, camera->refused, camera->errors, camera->misrouted,
+               percentile(camera->latencies, 0.50), percentile(camera->latencies, 0.90),
+               percentile(camera->latencies, 1.0));
+    }
+}
+
+// MARK: Setup
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s [--cameras N] [--rate FRAMES_PER_MIN] [--duration SEC]\n"
+            "          [--corpus DIR | --image-kb N] [--host H] [--port N] [--rate-limit N_PER_MIN]\n",
+            prog);
+}
+
+static bool parseArgs(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--cameras") config.cameras = atoi(value);
+        else if (arg == "--rate") config.rate_per_min = atof(value);
+        else if (arg == "--duration") config.duration_sec = atoi(value);
+        else if (arg == "--corpus") config.corpus = value;
+        else if (arg == "--image-kb") config.synthetic_kb = atoi(value);
+        else if (arg == "--host") config.host = value;
+        else if (arg == "--port") config.port = atoi(value);
+        else if (arg == "--key") config.api_key = value;
+        else if (arg == "--rate-limit") config.rate_limit = atoi(value);
+        else return false;
+    }
+    return config.cameras > 0 && config.cameras <= FRAME_SOURCES_MAX &&
+           config.rate_per_min > 0 && config.duration_sec > 0;
+}
+
+int main(int argc, char** argv) {
+    if (!parseArgs(argc, argv)) {
+        usage(argv[0]);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<std::vector<uint8_t>> corpus = loadCorpus();
+    s_corpus = &corpus;
+
+    static VisionBackend backend;
+    backend = visionMockBackend(config.host.c_str(), config.port, false);
+    visionSetBackend(&backend);
+    if (config.rate_limit > 0) {
+        schedulerConfigure(config.rate_limit, 3);
+    }
+    wheelBegin();
+    frameSourcesBegin();
+
+    std::vector<SimCamera*> cameras;
+    for (int i = 0; i < config.cameras; i++) {
+        SimCamera* camera = new SimCamera();
+        camera->name = "chute" + std::to_string(i + 1);
+        camera->source.name = camera->name.c_str();
+        camera->source.ops = &SIM_OPS;
+        camera->source.ctx = camera;
+        frameSourceRegister(&camera->source);
+        cameras.push_back(camera);
+    }
+    printf("[multicam_sim] %zu image(s), starting %d cameras\n", corpus.size(), config.cameras);
+    fflush(stdout);
+    for (SimCamera* camera : cameras) {
+        portTaskStart(runCamera, camera->name.c_str(), camera);
+    }
+
+    // The controller's loop: drain the queue, sleep until a camera pushes
+    uint32_t start = millis();
+    uint32_t end = start + config.duration_sec * 1000u;
+    uint32_t requests = 0;
+    while ((int32_t)(end - millis()) > 0) {
+        SourceResult result;
+        if (frameSourceService(NULL, DEFAULT_PROMPT, config.api_key.c_str(), config.fresh_for_ms, &result)) {
+            if (result.request_ms > 0) {
+                requests++;
+            }
+            continue;
+        }
+        wheelWait(end - millis());
+    }
+
+    // Answer whatever is still queued before reporting
+    running = false;
+    bool pending = true;
+    while (pending) {
+        while (frameSourceService(NULL, DEFAULT_PROMPT, config.api_key.c_str(), config.fresh_for_ms, NULL)) {
+        }
+        pending = false;
+        for (SimCamera* camera : cameras) {
+            pending = pending || camera->in_flight > 0;
+        }
+        if (pending) {
+            delay(10);
+        }
+    }
+
+    report(cameras, millis() - start, requests);
+    return 0;
+}
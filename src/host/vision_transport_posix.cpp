@@ -0,0 +1,308 @@
+// Linux implementation of vision_transport.h (BSD sockets + OpenSSL)
+
+#include "vision_transport.h"
+#include "platform_port.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/ssl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+
+struct VisionConn {
+    int fd;
+    SSL* ssl;
+};
+
+// MARK: Prewarm Config
+static const uint32_t PREWARM_TIMEOUT_MS = 10000;
+static const uint32_t WARM_MAX_IDLE_MS = 15000;
+
+// MARK: DNS Cache
+static std::mutex s_dns_lock;
+static uint32_t s_dns_ttl_ms = 600000;
+static std::string s_dns_key;
+static sockaddr_storage s_dns_addr;
+static socklen_t s_dns_addr_len = 0;
+static uint32_t s_dns_resolved_at = 0;
+
+void visionSetDnsTtl(uint32_t ttl_ms) {
+    std::lock_guard<std::mutex> lock(s_dns_lock);
+    s_dns_ttl_ms = ttl_ms;
+}
+
+static bool resolveHost(const VisionBackend* backend, sockaddr_storage* addr, socklen_t* addr_len) {
+    std::string key = std::string(backend->host) + ":" + std::to_string(backend->port);
+    {
+        std::lock_guard<std::mutex> lock(s_dns_lock);
+        if (s_dns_ttl_ms > 0 && s_dns_key == key && millis() - s_dns_resolved_at < s_dns_ttl_ms) {
+            *addr = s_dns_addr;
+            *addr_len = s_dns_addr_len;
+            return true;
+        }
+    }
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = NULL;
+    if (getaddrinfo(backend->host, std::to_string(backend->port).c_str(), &hints, &result) != 0 || !result) {
+        return false;
+    }
+    memcpy(addr, result->ai_addr, result->ai_addrlen);
+    *addr_len = result->ai_addrlen;
+    freeaddrinfo(result);
+
+    std::lock_guard<std::mutex> lock(s_dns_lock);
+    s_dns_key = key;
+    s_dns_addr = *addr;
+    s_dns_addr_len = *addr_len;
+    s_dns_resolved_at = millis();
+    return true;
+}
+
+// MARK: TLS
+static SSL_CTX* tlsContext(void) {
+    static std::once_flag once;
+    static SSL_CTX* ctx = NULL;
+    std::call_once(once, [] {
+        ctx = SSL_CTX_new(TLS_client_method());
+        // Same policy as the device: no certificate validation
+        SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, NULL);
+    });
+    return ctx;
+}
+
+static bool waitFd(int fd, short events, uint32_t timeout_ms) {
+    pollfd pfd = {fd, events, 0};
+    return poll(&pfd, 1, (int)timeout_ms) > 0;
+}
+
+// MARK: Connect
+static VisionConn* connectBackend(const VisionBackend* backend, uint32_t timeout_ms) {
+    sockaddr_storage addr;
+    socklen_t addr_len;
+    if (!resolveHost(backend, &addr, &addr_len)) {
+        return NULL;
+    }
+
+    int fd = socket(addr.ss_family, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    if (connect(fd, (sockaddr*)&addr, addr_len) != 0) {
+        int err = 0;
+        socklen_t err_len = sizeof(err);
+        if (errno != EINPROGRESS || !waitFd(fd, POLLOUT, timeout_ms) ||
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len) != 0 || err != 0) {
+            close(fd);
+            return NULL;
+        }
+    }
+
+    SSL* ssl = NULL;
+    if (backend->use_tls) {
+        ssl = SSL_new(tlsContext());
+        SSL_set_fd(ssl, fd);
+        SSL_set_tlsext_host_name(ssl, backend->host);
+        uint32_t start = millis();
+        for (;;) {
+            int ret = SSL_connect(ssl);
+            if (ret == 1) break;
+            int err = SSL_get_error(ssl, ret);
+            uint32_t elapsed = millis() - start;
+            short events = err == SSL_ERROR_WANT_READ ? POLLIN : err == SSL_ERROR_WANT_WRITE ? POLLOUT : 0;
+            if (!events || elapsed >= timeout_ms || !waitFd(fd, events, timeout_ms - elapsed)) {
+                SSL_free(ssl);
+                close(fd);
+                return NULL;
+            }
+        }
+    }
+
+    VisionConn* conn = new (std::nothrow) VisionConn();
+    if (!conn) {
+        if (ssl) SSL_free(ssl);
+        close(fd);
+        return NULL;
+    }
+    conn->fd = fd;
+    conn->ssl = ssl;
+    return conn;
+}
+
+// MARK: Warm Slot
+static std::mutex s_warm_lock;
+static VisionConn* s_warm_conn = NULL;
+static const VisionBackend* s_warm_backend = NULL;
+static uint32_t s_warm_at = 0;
+static bool s_warm_pending = false;
+static std::condition_variable s_warm_done;
+
+// Whether the parked connection can serve the backend; call with s_warm_lock held
+static bool warmUsable(const VisionBackend* backend) {
+    return s_warm_backend->port == backend->port &&
+           s_warm_backend->use_tls == backend->use_tls &&
+           strcmp(s_warm_backend->host, backend->host) == 0 &&
+           millis() - s_warm_at <= WARM_MAX_IDLE_MS;
+}
+
+void visionConnPrewarm(const VisionBackend* backend) {
+    if (!backend) {
+        return;
+    }
+    VisionConn* stale = NULL;
+    bool busy;
+    {
+        // Keep a parked connection only while takeWarm would still use it
+        std::lock_guard<std::mutex> lock(s_warm_lock);
+        if (s_warm_conn && !warmUsable(backend)) {
+            stale = s_warm_conn;
+            s_warm_conn = NULL;
+        }
+        busy = s_warm_pending || s_warm_conn;
+        if (!busy) {
+            s_warm_pending = true;
+        }
+    }
+    visionConnClose(stale);
+    if (busy) {
+        return;
+    }
+
+    std::thread([backend] {
+        VisionConn* conn = connectBackend(backend, PREWARM_TIMEOUT_MS);
+        std::lock_guard<std::mutex> lock(s_warm_lock);
+        s_warm_conn = conn;
+        s_warm_backend = backend;
+        s_warm_at = millis();
+        s_warm_pending = false;
+        s_warm_done.notify_all();
+    }).detach();
+}
+
+static VisionConn* takeWarm(const VisionBackend* backend, uint32_t timeout_ms) {
+    // A handshake already in flight is faster than starting a new one
+    std::unique_lock<std::mutex> lock(s_warm_lock);
+    if (!s_warm_done.wait_for(lock, std::chrono::milliseconds(timeout_ms), [] { return !s_warm_pending; })) {
+        return NULL;
+    }
+    VisionConn* conn = s_warm_conn;
+    s_warm_conn = NULL;
+    if (conn && !warmUsable(backend)) {
+        visionConnClose(conn);
+        conn = NULL;
+    }
+    return conn;
+}
+
+VisionConn* visionConnTakeWarm(const VisionBackend* backend) {
+    return backend ? takeWarm(backend, 0) : NULL;
+}
+
+// MARK: Open
+VisionConn* visionConnOpen(const VisionBackend* backend, uint32_t timeout_ms) {
+    if (!backend) {
+        return NULL;
+    }
+
+    VisionConn* conn = takeWarm(backend, timeout_ms);
+    if (conn) {
+        return conn;
+    }
+    return connectBackend(backend, timeout_ms);
+}
+
+// MARK: I/O
+size_t visionConnWrite(VisionConn* conn, const uint8_t* data, size_t len) {
+    if (!conn) {
+        return 0;
+    }
+
+    size_t written = 0;
+    while (written < len) {
+        int n;
+        bool want_read = false;
+        if (conn->ssl) {
+            n = SSL_write(conn->ssl, data + written, (int)(len - written));
+            if (n <= 0) {
+                int err = SSL_get_error(conn->ssl, n);
+                if (err != SSL_ERROR_WANT_WRITE && err != SSL_ERROR_WANT_READ) {
+                    break;
+                }
+                want_read = err == SSL_ERROR_WANT_READ;
+                n = 0;
+            }
+        } else {
+            n = (int)send(conn->fd, data + written, len - written, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    break;
+                }
+                n = 0;
+            }
+        }
+
+        if (n == 0 && !waitFd(conn->fd, want_read ? POLLIN : POLLOUT, 10000)) {
+            break;
+        }
+        written += n;
+    }
+    return written;
+}
+
+int visionConnRead(VisionConn* conn, uint8_t* buffer, size_t len) {
+    if (!conn) {
+        return -1;
+    }
+
+    if (conn->ssl) {
+        int n = SSL_read(conn->ssl, buffer, (int)len);
+        if (n > 0) {
+            return n;
+        }
+        int err = SSL_get_error(conn->ssl, n);
+        return err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE ? 0 : -1;
+    }
+
+    ssize_t n = recv(conn->fd, buffer, len, 0);
+    if (n > 0) {
+        return (int)n;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return 0;
+    }
+    return -1;
+}
+
+// MARK: Close
+void visionConnClose(VisionConn* conn) {
+    if (!conn) {
+        return;
+    }
+    if (conn->ssl) {
+        SSL_shutdown(conn->ssl);
+        SSL_free(conn->ssl);
+    }
+    close(conn->fd);
+    delete conn;
+}
+
+int8_t visionLinkRssi(void) {
+    return 0;
+}
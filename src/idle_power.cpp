@@ -0,0 +1,166 @@
+#include "idle_power.h"
+#include "sensor_profile.h"
+#include "platform_port.h"
+#include <Arduino.h>
+#include <WiFi.h>
+#include "driver/gpio.h"
+#include "hal/gpio_ll.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "esp_idf_version.h"
+#if CONFIG_PM_ENABLE
+#include "esp_pm.h"
+#endif
+
+// MARK: Idle Config
+static const uint32_t PARK_AFTER_MS = 10000;    // Quiet time before parking
+static const uint32_t PARKED_CPU_MHZ = 80;      // Lowest that keeps APB, and so the camera clock, at 80 MHz
+
+#if CONFIG_PM_ENABLE
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+typedef esp_pm_config_t PmConfig;
+#else
+typedef esp_pm_config_esp32_t PmConfig;
+#endif
+
+static esp_pm_lock_handle_t s_cpu_lock = NULL;      // Held while active: full clock
+static esp_pm_lock_handle_t s_awake_lock = NULL;    // Held while active, or parked without standby: no light sleep
+#endif
+
+static gpio_num_t s_pin = GPIO_NUM_NC;
+static bool s_pm = false;                   // Power management configured, clock follows the locks
+static uint32_t s_full_mhz = 240;
+static uint32_t s_last_activity = 0;
+static uint32_t s_parked_at = 0;
+static volatile bool s_parked = false;
+static volatile bool s_sleep_armed = false; // Trigger pin switched to a level wake source
+static volatile int64_t s_wake_us = 0;      // Wake not yet followed by a capture, 0 for none
+static IdleStats s_stats = {};
+
+void idleBegin(uint8_t trigger_pin) {
+    s_pin = (gpio_num_t)trigger_pin;
+    s_full_mhz = getCpuFrequencyMhz();
+    s_last_activity = millis();
+
+    // Full power save only while parked; modem sleep adds a beacon interval to every response
+    WiFi.setSleep(false);
+
+#if CONFIG_PM_ENABLE
+    // Locks first, so nothing slows down until the loop parks
+    if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "active", &s_cpu_lock) == ESP_OK &&
+        esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "awake", &s_awake_lock) == ESP_OK) {
+        esp_pm_lock_acquire(s_cpu_lock);
+        esp_pm_lock_acquire(s_awake_lock);
+
+        PmConfig config = {};
+        config.max_freq_mhz = s_full_mhz;
+        config.min_freq_mhz = PARKED_CPU_MHZ;
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+        config.light_sleep_enable = true;
+#endif
+        s_pm = esp_pm_configure(&config) == ESP_OK;
+        s_stats.light_sleep = s_pm && config.light_sleep_enable;
+    }
+#endif
+}
+
+// MARK: Park
+void idleService(void) {
+    if (s_parked || millis() - s_last_activity < PARK_AFTER_MS) {
+        return;
+    }
+    // A pin still high from the last item would wake straight away
+    if (gpio_get_level(s_pin)) {
+        return;
+    }
+
+    // Light sleep stops the camera's DMA, so only with the sensor quiet
+    bool standby = sensorProfileApply(SENSOR_PROFILE_STANDBY, NULL, 0);
+    WiFi.setSleep(WIFI_PS_MIN_MODEM);
+    s_wake_us = 0;
+    s_parked = true;
+    s_parked_at = millis();
+    s_stats.parks++;
+
+#if CONFIG_PM_ENABLE
+    if (s_pm) {
+        if (standby && s_stats.light_sleep) {
+            // Edge interrupts don't wake the chip; a level does, and the ISR masks it once seen
+            s_sleep_armed = true;
+            gpio_wakeup_enable(s_pin, GPIO_INTR_HIGH_LEVEL);
+            esp_sleep_enable_gpio_wakeup();
+            esp_pm_lock_release(s_awake_lock);
+        }
+        esp_pm_lock_release(s_cpu_lock);
+        return;
+    }
+#endif
+    setCpuFrequencyMhz(PARKED_CPU_MHZ);
+}
+
+void PORT_ISR_ATTR idleWakeFromIsr(void) {
+    if (!s_parked || !gpio_ll_get_level(&GPIO, s_pin)) {
+        return;
+    }
+    if (s_sleep_armed) {
+        gpio_ll_intr_disable(&GPIO, s_pin);
+    }
+    if (s_wake_us == 0) {
+        s_wake_us = esp_timer_get_time();
+    }
+}
+
+// MARK: Resume
+void idleResume(bool capture) {
+    s_last_activity = millis();
+    if (!s_parked) {
+        return;
+    }
+    if (!capture) {
+        s_wake_us = 0;
+    } else if (s_wake_us == 0) {
+        s_wake_us = esp_timer_get_time();   // Woken by the web server rather than the pin
+    }
+
+#if CONFIG_PM_ENABLE
+    if (s_pm) {
+        esp_pm_lock_acquire(s_cpu_lock);
+        if (s_sleep_armed) {
+            esp_pm_lock_acquire(s_awake_lock);
+            gpio_wakeup_disable(s_pin);
+            gpio_set_intr_type(s_pin, GPIO_INTR_ANYEDGE);
+            gpio_intr_enable(s_pin);
+            s_sleep_armed = false;
+        }
+    } else {
+        setCpuFrequencyMhz(s_full_mhz);
+    }
+#else
+    setCpuFrequencyMhz(s_full_mhz);
+#endif
+
+    WiFi.setSleep(false);
+    sensorProfileApply(SENSOR_PROFILE_PREVIEW, NULL, 0);
+    s_stats.parked_ms += millis() - s_parked_at;
+    s_parked = false;
+}
+
+void idleCaptured(void) {
+    int64_t wake_us = s_wake_us;
+    if (wake_us == 0) {
+        return;
+    }
+    s_wake_us = 0;
+    uint32_t ms = (uint32_t)((esp_timer_get_time() - wake_us) / 1000);
+    s_stats.wakes++;
+    s_stats.last_wake_to_capture_ms = ms;
+    if (ms > s_stats.max_wake_to_capture_ms) {
+        s_stats.max_wake_to_capture_ms = ms;
+    }
+}
+
+IdleStats idleGetStats(void) {
+    IdleStats stats = s_stats;
+    stats.parked = s_parked;
+    return stats;
+}
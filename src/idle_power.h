@@ -0,0 +1,75 @@
+#ifndef IDLE_POWER_H
+#define IDLE_POWER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Low-power parking between items
+ *
+ * Once nothing has happened for a while the capture loop parks the
+ * device: the sensor goes to standby, WiFi drops to modem sleep and the
+ * CPU is let down to 80 MHz. If the build has power management with
+ * tickless idle, the chip also enters automatic light sleep whenever the
+ * loop waits, staying associated and answering the web server between
+ * DTIM beacons; the trigger pin is then a wake source. A trigger or a
+ * preview client resumes full speed, and the time from the wake to the
+ * captured frame is recorded so parking can be checked against latency.
+ *
+ * Everything but idleWakeFromIsr() must be called from the capture loop.
+ */
+
+/**
+ * Parking counters, for /status
+ */
+typedef struct {
+    bool parked;
+    bool light_sleep;               // Automatic light sleep is available
+    uint32_t parks;
+    uint32_t parked_ms;             // Total, not counting the current park
+    uint32_t wakes;                 // Wakes followed by a capture
+    uint32_t last_wake_to_capture_ms;
+    uint32_t max_wake_to_capture_ms;
+} IdleStats;
+
+/**
+ * Set up power management and the wake source; call once the camera and WiFi are started
+ * @param trigger_pin Input that wakes the device when it goes high
+ */
+void idleBegin(uint8_t trigger_pin);
+
+/**
+ * Park if nothing has happened for long enough; call from the idle branch of the loop
+ */
+void idleService(void);
+
+/**
+ * Note activity, resuming full speed if parked
+ * @param capture A capture follows: time it from the wake
+ */
+void idleResume(bool capture);
+
+/**
+ * Close the wake-to-capture measurement; call as soon as the flash frame is in
+ */
+void idleCaptured(void);
+
+/**
+ * For the trigger pin's interrupt handler: stops a wake level from re-firing and stamps the wake
+ */
+void idleWakeFromIsr(void);
+
+/**
+ * @return Snapshot of the stats
+ */
+IdleStats idleGetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IDLE_POWER_H */
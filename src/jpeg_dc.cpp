@@ -0,0 +1,435 @@
+#include "jpeg_dc.h"
+#include <string.h>
+
+// MARK: Huffman Tables
+#define FAST_BITS 9
+#define SKIP_BITS 11
+
+typedef struct {
+    uint8_t fast_len[1 << FAST_BITS];   // Code length for a FAST_BITS prefix, 0 if the code is longer
+    uint8_t fast_sym[1 << FAST_BITS];
+    int32_t maxcode[17];                // Largest code of each length, -1 if none
+    int32_t mincode[17];
+    uint8_t valptr[17];
+    uint8_t values[256];
+    bool present;
+} HuffTable;
+
+/**
+ * AC skip table: for each SKIP_BITS prefix, the bits taken by one run/size
+ * code plus its magnitude (low byte) and how far it advances through the
+ * block (high byte, 64 for end of block), or 0 if it doesn't fit
+ */
+typedef uint16_t SkipTable[1 << SKIP_BITS];
+
+static bool buildHuffman(HuffTable* table, const uint8_t counts[16], const uint8_t* symbols, size_t total,
+                         SkipTable skip) {
+    memset(table->fast_len, 0, sizeof(table->fast_len));
+    if (skip) {
+        memset(skip, 0, sizeof(SkipTable));
+    }
+    memcpy(table->values, symbols, total);
+
+    uint32_t code = 0;
+    size_t k = 0;
+    for (int len = 1; len <= 16; len++) {
+        table->valptr[len] = k;
+        table->mincode[len] = code;
+        for (int i = 0; i < counts[len - 1]; i++, k++, code++) {
+            if (len <= FAST_BITS) {
+                uint32_t first = code << (FAST_BITS - len);
+                uint32_t span = 1u << (FAST_BITS - len);
+                for (uint32_t j = 0; j < span; j++) {
+                    table->fast_len[first + j] = len;
+                    table->fast_sym[first + j] = symbols[k];
+                }
+            }
+            uint8_t run = symbols[k] >> 4;
+            uint8_t size = symbols[k] & 15;
+            if (skip && len + size <= SKIP_BITS) {
+                uint16_t advance = size ? run + 1 : run == 15 ? 16 : 64;
+                uint32_t first = code << (SKIP_BITS - len);
+                uint32_t span = 1u << (SKIP_BITS - len);
+                for (uint32_t j = 0; j < span; j++) {
+                    skip[first + j] = advance << 8 | (len + size);
+                }
+            }
+        }
+        table->maxcode[len] = counts[len - 1] ? (int32_t)code - 1 : -1;
+        if (code > (1u << len)) {
+            return false;
+        }
+        code <<= 1;
+    }
+    table->present = true;
+    return true;
+}
+
+// MARK: Bit Reader
+// Native word: 32 bits on the ESP32, 64 on the host
+typedef size_t BitWord;
+static const int WORD_BITS = sizeof(BitWord) * 8;
+
+typedef struct {
+    const uint8_t* data;
+    const uint8_t* end;
+    BitWord bits;       // Left aligned
+    int count;
+    bool marker;        // Reached a marker, feeding zeros from here on
+} BitReader;
+
+static void fill(BitReader* br) {
+    while (br->count <= WORD_BITS - 8) {
+        uint32_t byte = 0;
+        if (!br->marker && br->data < br->end) {
+            byte = *br->data;
+            if (byte == 0xFF) {
+                uint8_t next = br->data + 1 < br->end ? br->data[1] : 0xD9;
+                if (next == 0x00) {
+                    br->data += 2;  // Stuffed zero
+                } else {
+                    br->marker = true;
+                    byte = 0;
+                }
+            } else {
+                br->data++;
+            }
+        }
+        br->bits |= (BitWord)byte << (WORD_BITS - 8 - br->count);
+        br->count += 8;
+    }
+}
+
+static inline void consume(BitReader* br, int n) {
+    br->bits <<= n;
+    br->count -= n;
+}
+
+static inline int decodeSymbol(BitReader* br, const HuffTable* table) {
+    if (br->count < 16) {
+        fill(br);
+    }
+    uint32_t peek = br->bits >> (WORD_BITS - FAST_BITS);
+    int len = table->fast_len[peek];
+    if (len) {
+        consume(br, len);
+        return table->fast_sym[peek];
+    }
+
+    uint32_t top = br->bits >> (WORD_BITS - 16);
+    for (len = FAST_BITS + 1; len <= 16; len++) {
+        int32_t code = top >> (16 - len);
+        if (code <= table->maxcode[len]) {
+            consume(br, len);
+            return table->values[table->valptr[len] + code - table->mincode[len]];
+        }
+    }
+    return -1;
+}
+
+static inline int receiveExtend(BitReader* br, int s) {
+    if (s == 0) {
+        return 0;
+    }
+    if (br->count < s) {
+        fill(br);
+    }
+    int v = br->bits >> (WORD_BITS - s);
+    consume(br, s);
+    return v < (1 << (s - 1)) ? v - (1 << s) + 1 : v;
+}
+
+/**
+ * Walk past a block's AC terms without decoding their values
+ */
+static bool skipAc(BitReader* br, const HuffTable* ac, const SkipTable skip) {
+    for (int k = 1; k < 64;) {
+        if (br->count < 16) {
+            fill(br);
+        }
+        uint16_t entry = skip[br->bits >> (WORD_BITS - SKIP_BITS)];
+        if (entry) {
+            consume(br, entry & 0xFF);
+            k += entry >> 8;
+            continue;
+        }
+
+        int rs = decodeSymbol(br, ac);
+        if (rs < 0) {
+            return false;
+        }
+        int s = rs & 15;
+        if (br->count < s) {
+            fill(br);
+        }
+        consume(br, s);
+
+        if (s == 0) {
+            if (rs != 0xF0) {
+                break;  // End of block
+            }
+            k += 16;
+        } else {
+            k += (rs >> 4) + 1;
+        }
+    }
+    return true;
+}
+
+// MARK: Frame Header
+typedef struct {
+    uint8_t id;
+    uint8_t h;
+    uint8_t v;
+    uint8_t tq;
+    uint8_t td;
+    uint8_t ta;
+    int pred;
+} Component;
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint8_t ncomp;
+    Component comp[3];
+    uint16_t q_dc[4];       // DC quantizer of each table
+    HuffTable dc[2];        // Baseline allows two of each
+    HuffTable ac[2];
+    SkipTable ac_skip[2];
+    uint16_t restart_interval;
+} JpegInfo;
+
+static inline uint16_t be16(const uint8_t* p) {
+    return (p[0] << 8) | p[1];
+}
+
+// MARK: Scan
+static bool restart(BitReader* br, JpegInfo* info) {
+    // Skip to the RSTn marker the stream must be at now
+    const uint8_t* p = br->data;
+    while (p + 1 < br->end && !(p[0] == 0xFF && p[1] >= 0xD0 && p[1] <= 0xD7)) {
+        p++;
+    }
+    if (p + 1 >= br->end) {
+        return false;
+    }
+    br->data = p + 2;
+    br->bits = 0;
+    br->count = 0;
+    br->marker = false;
+    for (int i = 0; i < info->ncomp; i++) {
+        info->comp[i].pred = 0;
+    }
+    return true;
+}
+
+static inline uint8_t dcToLuma(int dc, uint16_t q) {
+    // A block's mean is DC / 8, level shifted by 128
+    int level = (dc * q + 1028) >> 3;
+    return level < 0 ? 0 : level > 255 ? 255 : level;
+}
+
+static bool decodeScan(const uint8_t* data, const uint8_t* end, JpegInfo* info,
+                       const uint8_t* scan_comps, uint8_t scan_count, Thumbnail* thumb) {
+    Component* y = &info->comp[0];
+    uint8_t hmax = 1;
+    uint8_t vmax = 1;
+    for (int i = 0; i < info->ncomp; i++) {
+        if (info->comp[i].h > hmax) hmax = info->comp[i].h;
+        if (info->comp[i].v > vmax) vmax = info->comp[i].v;
+    }
+    if (y->h != hmax || y->v != vmax) {
+        return false;  // Subsampled luma is not something a camera produces
+    }
+
+    uint16_t q = info->q_dc[y->tq & 3];
+    BitReader br = {data, end, 0, 0, false};
+
+    // A single-component scan codes blocks in raster order, not in MCUs
+    bool single = scan_count == 1;
+    if (single && scan_comps[0] != 0) {
+        return false;
+    }
+    uint32_t mcu_cols = single ? thumb->width : (info->width + 8 * hmax - 1) / (8 * hmax);
+    uint32_t mcu_rows = single ? thumb->height : (info->height + 8 * vmax - 1) / (8 * vmax);
+    uint32_t mcus = mcu_cols * mcu_rows;
+
+    for (uint32_t m = 0; m < mcus; m++) {
+        if (info->restart_interval && m > 0 && m % info->restart_interval == 0 && !restart(&br, info)) {
+            return false;
+        }
+
+        uint32_t mcu_x = m % mcu_cols;
+        uint32_t mcu_y = m / mcu_cols;
+        for (int s = 0; s < scan_count; s++) {
+            Component* c = &info->comp[scan_comps[s]];
+            const HuffTable* dc = &info->dc[c->td];
+            const HuffTable* ac = &info->ac[c->ta];
+            const uint16_t* skip = info->ac_skip[c->ta];
+            uint8_t bh = single ? 1 : c->h;
+            uint8_t bv = single ? 1 : c->v;
+
+            for (uint8_t by = 0; by < bv; by++) {
+                for (uint8_t bx = 0; bx < bh; bx++) {
+                    int t = decodeSymbol(&br, dc);
+                    if (t < 0 || t > 11) {
+                        return false;
+                    }
+                    c->pred += receiveExtend(&br, t);
+                    if (!skipAc(&br, ac, skip)) {
+                        return false;
+                    }
+
+                    if (scan_comps[s] == 0) {
+                        uint32_t x = mcu_x * bh + bx;
+                        uint32_t row = mcu_y * bv + by;
+                        if (x < thumb->width && row < thumb->height) {
+                            thumb->pixels[row * thumb->width + x] = dcToLuma(c->pred, q);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// MARK: Markers
+bool jpegDcThumbnail(const uint8_t* jpeg, size_t len, Thumbnail* thumb) {
+    if (!jpeg || !thumb || len < 4 || jpeg[0] != 0xFF || jpeg[1] != 0xD8) {
+        return false;
+    }
+
+    // Huffman and skip tables are ~11 KB, too much for the caller's stack
+    static JpegInfo info;
+    memset(&info, 0, sizeof(info));
+
+    const uint8_t* end = jpeg + len;
+    const uint8_t* p = jpeg + 2;
+    bool have_frame = false;
+
+    while (p + 4 <= end) {
+        if (p[0] != 0xFF) {
+            p++;
+            continue;
+        }
+        uint8_t marker = p[1];
+        if (marker == 0xFF) {
+            p++;  // Fill byte
+            continue;
+        }
+        if (marker == 0xD9) {
+            return false;  // EOI before any scan
+        }
+        uint16_t seg_len = be16(p + 2);
+        const uint8_t* seg = p + 4;
+        const uint8_t* seg_end = p + 2 + seg_len;
+        if (seg_len < 2 || seg_end > end) {
+            return false;
+        }
+
+        switch (marker) {
+        case 0xC0:  // Baseline
+            if (seg_len < 8 || seg[0] != 8) {
+                return false;
+            }
+            info.height = be16(seg + 1);
+            info.width = be16(seg + 3);
+            info.ncomp = seg[5];
+            if ((info.ncomp != 1 && info.ncomp != 3) || seg_len < 8 + 3 * info.ncomp) {
+                return false;
+            }
+            for (int i = 0; i < info.ncomp; i++) {
+                const uint8_t* c = seg + 6 + 3 * i;
+                info.comp[i].id = c[0];
+                info.comp[i].h = c[1] >> 4;
+                info.comp[i].v = c[1] & 15;
+                info.comp[i].tq = c[2] & 3;
+                if (info.comp[i].h < 1 || info.comp[i].h > 4 || info.comp[i].v < 1 || info.comp[i].v > 4) {
+                    return false;
+                }
+            }
+            have_frame = true;
+            break;
+
+        case 0xC4: {  // DHT
+            const uint8_t* t = seg;
+            while (t + 17 <= seg_end) {
+                uint8_t tc = t[0] >> 4;
+                uint8_t th = t[0] & 15;
+                size_t total = 0;
+                for (int i = 1; i <= 16; i++) {
+                    total += t[i];
+                }
+                if (tc > 1 || th > 1 || total > 256 || t + 17 + total > seg_end) {
+                    return false;
+                }
+                HuffTable* table = tc == 0 ? &info.dc[th] : &info.ac[th];
+                if (!buildHuffman(table, t + 1, t + 17, total, tc == 0 ? NULL : info.ac_skip[th])) {
+                    return false;
+                }
+                t += 17 + total;
+            }
+            break;
+        }
+
+        case 0xDB: {  // DQT, only the DC entry is needed
+            const uint8_t* t = seg;
+            while (t + 65 <= seg_end) {
+                uint8_t precision = t[0] >> 4;
+                uint8_t id = t[0] & 3;
+                info.q_dc[id] = precision ? be16(t + 1) : t[1];
+                t += precision ? 129 : 65;
+            }
+            break;
+        }
+
+        case 0xDD:  // DRI
+            info.restart_interval = be16(seg);
+            break;
+
+        case 0xDA: {  // SOS
+            if (!have_frame || seg_len < 6) {
+                return false;
+            }
+            uint8_t scan_count = seg[0];
+            if (scan_count < 1 || scan_count > info.ncomp || seg_len < 6 + 2 * scan_count) {
+                return false;
+            }
+            uint8_t scan_comps[3];
+            for (int i = 0; i < scan_count; i++) {
+                uint8_t id = seg[1 + 2 * i];
+                int index = -1;
+                for (int c = 0; c < info.ncomp; c++) {
+                    if (info.comp[c].id == id) index = c;
+                }
+                if (index < 0) {
+                    return false;
+                }
+                scan_comps[i] = index;
+                info.comp[index].td = seg[2 + 2 * i] >> 4 & 1;
+                info.comp[index].ta = seg[2 + 2 * i] & 1;
+                if (!info.dc[info.comp[index].td].present || !info.ac[info.comp[index].ta].present) {
+                    return false;
+                }
+            }
+
+            thumb->width = (info.width + 7) / 8;
+            thumb->height = (info.height + 7) / 8;
+            if (thumb->width == 0 || thumb->height == 0 ||
+                thumb->width > THUMB_MAX_WIDTH || thumb->height > THUMB_MAX_HEIGHT) {
+                return false;
+            }
+            return decodeScan(seg_end, end, &info, scan_comps, scan_count, thumb);
+        }
+
+        default:
+            if (marker >= 0xC2 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+                return false;  // Progressive, lossless or arithmetic coded
+            }
+            break;
+        }
+        p = seg_end;
+    }
+    return false;
+}
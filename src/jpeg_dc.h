@@ -0,0 +1,35 @@
+#ifndef JPEG_DC_H
+#define JPEG_DC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "frame_analysis.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Extract a 1/8-scale luma thumbnail from a baseline JPEG
+ *
+ * Each 8x8 block's average brightness is its DC coefficient, so only the
+ * Huffman stream is walked: luma DC terms are accumulated and everything
+ * else (AC terms, chroma blocks) is skipped without being stored,
+ * dequantized or transformed. Meant for the OV2640's baseline 4:2:2
+ * output, straight from camera_fb_t::buf. Not reentrant: call it from
+ * one task only.
+ *
+ * @param jpeg JPEG data
+ * @param len JPEG length
+ * @param thumb Receives the thumbnail, (width + 7) / 8 by (height + 7) / 8
+ * @return true if successful, false for progressive, arithmetic-coded,
+ *         oversized or malformed JPEGs
+ */
+bool jpegDcThumbnail(const uint8_t* jpeg, size_t len, Thumbnail* thumb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JPEG_DC_H */
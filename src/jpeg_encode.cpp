@@ -0,0 +1,642 @@
+#include "jpeg_encode.h"
+#include <string.h>
+
+// MARK: Tables
+// Zigzag position to natural (row-major) index
+static const uint8_t NATURAL_ORDER[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+// ITU T.81 Annex K quantization tables, natural order
+static const uint8_t STD_LUMA_QUANT[64] = {
+    16, 11, 10, 16,  24,  40,  51,  61,
+    12, 12, 14, 19,  26,  58,  60,  55,
+    14, 13, 16, 24,  40,  57,  69,  56,
+    14, 17, 22, 29,  51,  87,  80,  62,
+    18, 22, 37, 56,  68, 109, 103,  77,
+    24, 35, 55, 64,  81, 104, 113,  92,
+    49, 64, 78, 87, 103, 121, 120, 101,
+    72, 92, 95, 98, 112, 100, 103,  99,
+};
+
+static const uint8_t STD_CHROMA_QUANT[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99,
+    18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99,
+    47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+};
+
+// ITU T.81 Annex K Huffman tables: code counts per length, then symbols
+static const uint8_t DC_LUMA_BITS[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+static const uint8_t DC_CHROMA_BITS[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+static const uint8_t DC_VALUES[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+
+static const uint8_t AC_LUMA_BITS[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+static const uint8_t AC_LUMA_VALUES[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+
+static const uint8_t AC_CHROMA_BITS[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+static const uint8_t AC_CHROMA_VALUES[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+
+typedef struct {
+    uint16_t code[256];
+    uint8_t size[256];
+} HuffCodes;
+
+static HuffCodes s_dc_luma, s_ac_luma, s_dc_chroma, s_ac_chroma;
+static bool s_codes_built = false;
+
+static void buildCodes(HuffCodes* codes, const uint8_t bits[16], const uint8_t* values) {
+    memset(codes->size, 0, sizeof(codes->size));
+    uint16_t code = 0;
+    size_t k = 0;
+    for (int len = 1; len <= 16; len++) {
+        for (int i = 0; i < bits[len - 1]; i++, k++, code++) {
+            codes->code[values[k]] = code;
+            codes->size[values[k]] = len;
+        }
+        code <<= 1;
+    }
+}
+
+static void ensureCodes(void) {
+    if (s_codes_built) {
+        return;
+    }
+    buildCodes(&s_dc_luma, DC_LUMA_BITS, DC_VALUES);
+    buildCodes(&s_ac_luma, AC_LUMA_BITS, AC_LUMA_VALUES);
+    buildCodes(&s_dc_chroma, DC_CHROMA_BITS, DC_VALUES);
+    buildCodes(&s_ac_chroma, AC_CHROMA_BITS, AC_CHROMA_VALUES);
+    s_codes_built = true;
+}
+
+// MARK: Layout
+// One MCU is 16x16 pixels as 4 Y + Cb + Cr blocks for color, one 8x8 block for gray
+static inline uint8_t mcuSize(bool color) {
+    return color ? 16 : 8;
+}
+
+static inline uint8_t mcuBlocks(bool color) {
+    return color ? 6 : 1;
+}
+
+size_t jpegCoefficientBytes(uint16_t width, uint16_t height, bool color) {
+    size_t mcu = mcuSize(color);
+    size_t mcus = ((width + mcu - 1) / mcu) * ((height + mcu - 1) / mcu);
+    return mcus * mcuBlocks(color) * 64 * sizeof(int16_t);
+}
+
+// MARK: Forward DCT
+// Integer LL&M DCT as in libjpeg's jfdctint.c; outputs are scaled up by 8
+#define DCT_CONST_BITS 13
+#define DCT_PASS1_BITS 2
+#define FIX_0_298631336 2446
+#define FIX_0_390180644 3196
+#define FIX_0_541196100 4433
+#define FIX_0_765366865 6270
+#define FIX_0_899976223 7373
+#define FIX_1_175875602 9633
+#define FIX_1_501321110 12299
+#define FIX_1_847759065 15137
+#define FIX_1_961570560 16069
+#define FIX_2_053119869 16819
+#define FIX_2_562915447 20995
+#define FIX_3_072711026 25172
+#define DESCALE(x, n) (((x) + (1 << ((n) - 1))) >> (n))
+
+/**
+ * Transform one level-shifted block in place and store it in zigzag order
+ */
+static void forwardDct(int32_t* data, int16_t* out) {
+    // Rows
+    for (int32_t* p = data; p < data + 64; p += 8) {
+        int32_t tmp0 = p[0] + p[7], tmp7 = p[0] - p[7];
+        int32_t tmp1 = p[1] + p[6], tmp6 = p[1] - p[6];
+        int32_t tmp2 = p[2] + p[5], tmp5 = p[2] - p[5];
+        int32_t tmp3 = p[3] + p[4], tmp4 = p[3] - p[4];
+
+        int32_t tmp10 = tmp0 + tmp3, tmp13 = tmp0 - tmp3;
+        int32_t tmp11 = tmp1 + tmp2, tmp12 = tmp1 - tmp2;
+        p[0] = (tmp10 + tmp11) << DCT_PASS1_BITS;
+        p[4] = (tmp10 - tmp11) << DCT_PASS1_BITS;
+        int32_t z1 = (tmp12 + tmp13) * FIX_0_541196100;
+        p[2] = DESCALE(z1 + tmp13 * FIX_0_765366865, DCT_CONST_BITS - DCT_PASS1_BITS);
+        p[6] = DESCALE(z1 - tmp12 * FIX_1_847759065, DCT_CONST_BITS - DCT_PASS1_BITS);
+
+        z1 = tmp4 + tmp7;
+        int32_t z2 = tmp5 + tmp6, z3 = tmp4 + tmp6, z4 = tmp5 + tmp7;
+        int32_t z5 = (z3 + z4) * FIX_1_175875602;
+        tmp4 *= FIX_0_298631336;
+        tmp5 *= FIX_2_053119869;
+        tmp6 *= FIX_3_072711026;
+        tmp7 *= FIX_1_501321110;
+        z1 *= -FIX_0_899976223;
+        z2 *= -FIX_2_562915447;
+        z3 = z3 * -FIX_1_961570560 + z5;
+        z4 = z4 * -FIX_0_390180644 + z5;
+        p[7] = DESCALE(tmp4 + z1 + z3, DCT_CONST_BITS - DCT_PASS1_BITS);
+        p[5] = DESCALE(tmp5 + z2 + z4, DCT_CONST_BITS - DCT_PASS1_BITS);
+        p[3] = DESCALE(tmp6 + z2 + z3, DCT_CONST_BITS - DCT_PASS1_BITS);
+        p[1] = DESCALE(tmp7 + z1 + z4, DCT_CONST_BITS - DCT_PASS1_BITS);
+    }
+
+    // Columns
+    for (int32_t* p = data; p < data + 8; p++) {
+        int32_t tmp0 = p[0] + p[56], tmp7 = p[0] - p[56];
+        int32_t tmp1 = p[8] + p[48], tmp6 = p[8] - p[48];
+        int32_t tmp2 = p[16] + p[40], tmp5 = p[16] - p[40];
+        int32_t tmp3 = p[24] + p[32], tmp4 = p[24] - p[32];
+
+        int32_t tmp10 = tmp0 + tmp3, tmp13 = tmp0 - tmp3;
+        int32_t tmp11 = tmp1 + tmp2, tmp12 = tmp1 - tmp2;
+        p[0] = DESCALE(tmp10 + tmp11, DCT_PASS1_BITS);
+        p[32] = DESCALE(tmp10 - tmp11, DCT_PASS1_BITS);
+        int32_t z1 = (tmp12 + tmp13) * FIX_0_541196100;
+        p[16] = DESCALE(z1 + tmp13 * FIX_0_765366865, DCT_CONST_BITS + DCT_PASS1_BITS);
+        p[48] = DESCALE(z1 - tmp12 * FIX_1_847759065, DCT_CONST_BITS + DCT_PASS1_BITS);
+
+        z1 = tmp4 + tmp7;
+        int32_t z2 = tmp5 + tmp6, z3 = tmp4 + tmp6, z4 = tmp5 + tmp7;
+        int32_t z5 = (z3 + z4) * FIX_1_175875602;
+        tmp4 *= FIX_0_298631336;
+        tmp5 *= FIX_2_053119869;
+        tmp6 *= FIX_3_072711026;
+        tmp7 *= FIX_1_501321110;
+        z1 *= -FIX_0_899976223;
+        z2 *= -FIX_2_562915447;
+        z3 = z3 * -FIX_1_961570560 + z5;
+        z4 = z4 * -FIX_0_390180644 + z5;
+        p[56] = DESCALE(tmp4 + z1 + z3, DCT_CONST_BITS + DCT_PASS1_BITS);
+        p[40] = DESCALE(tmp5 + z2 + z4, DCT_CONST_BITS + DCT_PASS1_BITS);
+        p[24] = DESCALE(tmp6 + z2 + z3, DCT_CONST_BITS + DCT_PASS1_BITS);
+        p[8] = DESCALE(tmp7 + z1 + z4, DCT_CONST_BITS + DCT_PASS1_BITS);
+    }
+
+    for (int k = 0; k < 64; k++) {
+        out[k] = (int16_t)data[NATURAL_ORDER[k]];
+    }
+}
+
+// MARK: Prepare
+// Edges repeat the last row and column
+static void prepareGray(const uint8_t* rows, uint16_t width, uint32_t row_count, int16_t* out) {
+    int32_t block[64];
+    for (uint32_t x0 = 0; x0 < width; x0 += 8) {
+        for (uint32_t r = 0; r < 8; r++) {
+            const uint8_t* row = rows + (size_t)(r < row_count ? r : row_count - 1) * width;
+            for (uint32_t c = 0; c < 8; c++) {
+                block[r * 8 + c] = row[x0 + c < width ? x0 + c : width - 1] - 128;
+            }
+        }
+        forwardDct(block, out);
+        out += 64;
+    }
+}
+
+static void prepareColor(const uint8_t* rows, uint16_t width, uint32_t row_count, int16_t* out) {
+    int32_t luma[4][64];
+    int32_t cb[64];
+    int32_t cr[64];
+    uint32_t xs[16];
+    for (uint32_t x0 = 0; x0 < width; x0 += 16) {
+        for (int c = 0; c < 16; c++) {
+            xs[c] = (x0 + c < width ? x0 + c : width - 1) * 3;
+        }
+
+        // Two rows at a time so each 2x2 quad is summed for the chroma sample
+        for (uint32_t r = 0; r < 16; r += 2) {
+            const uint8_t* row_a = rows + (size_t)(r < row_count ? r : row_count - 1) * width * 3;
+            const uint8_t* row_b = rows + (size_t)(r + 1 < row_count ? r + 1 : row_count - 1) * width * 3;
+            int32_t* luma_a = luma[(r >> 3) * 2] + (r & 7) * 8;
+            int32_t* luma_b = luma_a + 8;
+            int chroma_index = (r >> 1) * 8;
+
+            for (int c = 0; c < 16; c += 2) {
+                const uint8_t* p[4] = {row_a + xs[c], row_a + xs[c + 1], row_b + xs[c], row_b + xs[c + 1]};
+                int32_t* dst[4] = {luma_a, luma_a, luma_b, luma_b};
+                int32_t sum_r = 0, sum_g = 0, sum_b = 0;
+                for (int i = 0; i < 4; i++) {
+                    int32_t R = p[i][0], G = p[i][1], B = p[i][2];
+                    sum_r += R;
+                    sum_g += G;
+                    sum_b += B;
+                    // Right-hand 8 columns go to the next block of the pair
+                    int col = c + (i & 1);
+                    int32_t* block_row = col < 8 ? dst[i] : dst[i] + 64;
+                    block_row[col & 7] = ((19595 * R + 38470 * G + 7471 * B + 32768) >> 16) - 128;
+                }
+                // Average of the quad, already centred on zero
+                cb[chroma_index] = (-11059 * sum_r - 21709 * sum_g + 32768 * sum_b + (1 << 17)) >> 18;
+                cr[chroma_index] = (32768 * sum_r - 27439 * sum_g - 5329 * sum_b + (1 << 17)) >> 18;
+                chroma_index++;
+            }
+        }
+
+        for (int i = 0; i < 4; i++) {
+            forwardDct(luma[i], out);
+            out += 64;
+        }
+        forwardDct(cb, out);
+        out += 64;
+        forwardDct(cr, out);
+        out += 64;
+    }
+}
+
+static void prepareStrip(const uint8_t* rows, uint16_t width, uint32_t row_count, bool color, int16_t* out) {
+    if (color) {
+        prepareColor(rows, width, row_count, out);
+    } else {
+        prepareGray(rows, width, row_count, out);
+    }
+}
+
+bool jpegPrepare(const uint8_t* pixels, uint16_t width, uint16_t height, JpegInput format, JpegCoefficients* coeffs) {
+    if (!pixels || !coeffs || !coeffs->coeffs || width == 0 || height == 0) {
+        return false;
+    }
+    coeffs->width = width;
+    coeffs->height = height;
+    coeffs->color = format == JPEG_INPUT_RGB888;
+    uint8_t mcu = mcuSize(coeffs->color);
+    size_t stride = (size_t)width * (coeffs->color ? 3 : 1);
+    size_t row_blocks = (size_t)((width + mcu - 1) / mcu) * mcuBlocks(coeffs->color) * 64;
+    for (uint32_t y = 0; y < height; y += mcu) {
+        uint32_t row_count = height - y < mcu ? height - y : mcu;
+        prepareStrip(pixels + y * stride, width, row_count, coeffs->color, coeffs->coeffs + (y / mcu) * row_blocks);
+    }
+    return true;
+}
+
+// MARK: Bit Writer
+typedef struct {
+    uint8_t* out;
+    size_t pos;
+    size_t cap;
+    uint32_t bits;      // Only the low count bits are pending
+    int count;
+} BitWriter;
+
+static inline void putByte(BitWriter* w, uint8_t byte) {
+    if (w->pos < w->cap) {
+        w->out[w->pos] = byte;
+    }
+    w->pos++;
+}
+
+static inline void putBits(BitWriter* w, uint32_t code, int size) {
+    w->bits = (w->bits << size) | code;
+    w->count += size;
+    while (w->count >= 8) {
+        w->count -= 8;
+        uint8_t byte = (uint8_t)(w->bits >> w->count);
+        putByte(w, byte);
+        if (byte == 0xFF) {
+            putByte(w, 0);     // Byte stuffing
+        }
+    }
+}
+
+static void flushBits(BitWriter* w) {
+    if (w->count > 0) {
+        putBits(w, (1u << (8 - w->count)) - 1, 8 - w->count);
+    }
+}
+
+static void putWord(BitWriter* w, uint16_t word) {
+    putByte(w, word >> 8);
+    putByte(w, word & 0xFF);
+}
+
+// MARK: Headers
+static void writeQuantTable(BitWriter* w, uint8_t id, const uint8_t* table) {
+    putByte(w, id);
+    for (int k = 0; k < 64; k++) {
+        putByte(w, table[k]);
+    }
+}
+
+static void writeHuffTable(BitWriter* w, uint8_t id, const uint8_t bits[16], const uint8_t* values) {
+    size_t total = 0;
+    putByte(w, id);
+    for (int i = 0; i < 16; i++) {
+        putByte(w, bits[i]);
+        total += bits[i];
+    }
+    for (size_t i = 0; i < total; i++) {
+        putByte(w, values[i]);
+    }
+}
+
+static void writeHeaders(BitWriter* w, uint16_t width, uint16_t height, bool color, const uint8_t* luma_quant,
+                         const uint8_t* chroma_quant) {
+    static const uint8_t JFIF[] = {0xFF, 0xD8, 0xFF, 0xE0, 0, 16, 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0};
+    for (size_t i = 0; i < sizeof(JFIF); i++) {
+        putByte(w, JFIF[i]);
+    }
+    uint8_t components = color ? 3 : 1;
+
+    putWord(w, 0xFFDB);
+    putWord(w, 2 + 65 * (color ? 2 : 1));
+    writeQuantTable(w, 0, luma_quant);
+    if (color) {
+        writeQuantTable(w, 1, chroma_quant);
+    }
+
+    putWord(w, 0xFFC0);
+    putWord(w, 8 + 3 * components);
+    putByte(w, 8);
+    putWord(w, height);
+    putWord(w, width);
+    putByte(w, components);
+    putByte(w, 1);
+    putByte(w, color ? 0x22 : 0x11);
+    putByte(w, 0);
+    if (color) {
+        putByte(w, 2);
+        putByte(w, 0x11);
+        putByte(w, 1);
+        putByte(w, 3);
+        putByte(w, 0x11);
+        putByte(w, 1);
+    }
+
+    putWord(w, 0xFFC4);
+    putWord(w, 2 + (17 + 12) + (17 + 162) + (color ? (17 + 12) + (17 + 162) : 0));
+    writeHuffTable(w, 0x00, DC_LUMA_BITS, DC_VALUES);
+    writeHuffTable(w, 0x10, AC_LUMA_BITS, AC_LUMA_VALUES);
+    if (color) {
+        writeHuffTable(w, 0x01, DC_CHROMA_BITS, DC_VALUES);
+        writeHuffTable(w, 0x11, AC_CHROMA_BITS, AC_CHROMA_VALUES);
+    }
+
+    putWord(w, 0xFFDA);
+    putWord(w, 6 + 2 * components);
+    putByte(w, components);
+    putByte(w, 1);
+    putByte(w, 0x00);
+    if (color) {
+        putByte(w, 2);
+        putByte(w, 0x11);
+        putByte(w, 3);
+        putByte(w, 0x11);
+    }
+    putByte(w, 0);
+    putByte(w, 63);
+    putByte(w, 0);
+}
+
+// MARK: Encode
+static void scaleQuant(const uint8_t* base, uint8_t quality, uint8_t* zigzag, uint16_t* divisors) {
+    // libjpeg's quality scaling, clamped to baseline's 8-bit tables
+    int scale = quality < 50 ? 5000 / quality : 200 - 2 * quality;
+    for (int k = 0; k < 64; k++) {
+        int q = (base[NATURAL_ORDER[k]] * scale + 50) / 100;
+        q = q < 1 ? 1 : q > 255 ? 255 : q;
+        zigzag[k] = q;
+        divisors[k] = q * 8;    // The DCT output is scaled by 8
+    }
+}
+
+static inline uint8_t bitLength(uint32_t value) {
+    return value ? 32 - __builtin_clz(value) : 0;
+}
+
+static void encodeBlock(BitWriter* w, const int16_t* block, const uint16_t* divisors, int* last_dc,
+                        const HuffCodes* dc, const HuffCodes* ac) {
+    int coef = block[0];
+    int half = divisors[0] >> 1;
+    int dc_value = coef < 0 ? -((half - coef) / divisors[0]) : (coef + half) / divisors[0];
+    int diff = dc_value - *last_dc;
+    *last_dc = dc_value;
+
+    uint32_t magnitude = diff < 0 ? -diff : diff;
+    uint8_t nbits = bitLength(magnitude);
+    putBits(w, dc->code[nbits], dc->size[nbits]);
+    if (nbits) {
+        putBits(w, diff < 0 ? (uint32_t)(diff - 1) & ((1u << nbits) - 1) : (uint32_t)diff, nbits);
+    }
+
+    int run = 0;
+    for (int k = 1; k < 64; k++) {
+        coef = block[k];
+        uint32_t absolute = coef < 0 ? -coef : coef;
+        half = divisors[k] >> 1;
+        // Most coefficients round to zero: skip the division for them
+        if (absolute < (uint32_t)half) {
+            run++;
+            continue;
+        }
+        magnitude = (absolute + half) / divisors[k];
+        if (magnitude > 1023) {
+            magnitude = 1023;   // Baseline AC range
+        }
+        while (run > 15) {
+            putBits(w, ac->code[0xF0], ac->size[0xF0]);
+            run -= 16;
+        }
+        nbits = bitLength(magnitude);
+        uint8_t symbol = (run << 4) | nbits;
+        putBits(w, ac->code[symbol], ac->size[symbol]);
+        putBits(w, coef < 0 ? ~magnitude & ((1u << nbits) - 1) : magnitude, nbits);
+        run = 0;
+    }
+    if (run > 0) {
+        putBits(w, ac->code[0x00], ac->size[0x00]);    // End of block
+    }
+}
+
+// Blocks in encode order; false as soon as the output is over its capacity
+static bool encodeMcus(BitWriter* w, const int16_t* block, size_t mcus, bool color, const uint16_t* luma_div,
+                       const uint16_t* chroma_div, int last_dc[3]) {
+    for (size_t i = 0; i < mcus; i++) {
+        if (color) {
+            for (int b = 0; b < 4; b++, block += 64) {
+                encodeBlock(w, block, luma_div, &last_dc[0], &s_dc_luma, &s_ac_luma);
+            }
+            encodeBlock(w, block, chroma_div, &last_dc[1], &s_dc_chroma, &s_ac_chroma);
+            block += 64;
+            encodeBlock(w, block, chroma_div, &last_dc[2], &s_dc_chroma, &s_ac_chroma);
+            block += 64;
+        } else {
+            encodeBlock(w, block, luma_div, &last_dc[0], &s_dc_luma, &s_ac_luma);
+            block += 64;
+        }
+        if (w->pos > w->cap) {
+            return false;   // Over budget, no point finishing
+        }
+    }
+    return true;
+}
+
+size_t jpegEncode(const JpegCoefficients* coeffs, uint8_t quality, uint8_t* out, size_t out_cap) {
+    if (!coeffs || !coeffs->coeffs || !out || coeffs->width == 0 || coeffs->height == 0) {
+        return 0;
+    }
+    ensureCodes();
+    quality = quality < 1 ? 1 : quality > 100 ? 100 : quality;
+
+    uint8_t luma_quant[64];
+    uint8_t chroma_quant[64];
+    uint16_t luma_div[64];
+    uint16_t chroma_div[64];
+    scaleQuant(STD_LUMA_QUANT, quality, luma_quant, luma_div);
+    scaleQuant(STD_CHROMA_QUANT, quality, chroma_quant, chroma_div);
+
+    BitWriter w = {out, 0, out_cap, 0, 0};
+    writeHeaders(&w, coeffs->width, coeffs->height, coeffs->color, luma_quant, chroma_quant);
+
+    uint8_t mcu = mcuSize(coeffs->color);
+    size_t mcus = (size_t)((coeffs->width + mcu - 1) / mcu) * ((coeffs->height + mcu - 1) / mcu);
+    int last_dc[3] = {0, 0, 0};
+    if (!encodeMcus(&w, coeffs->coeffs, mcus, coeffs->color, luma_div, chroma_div, last_dc)) {
+        return 0;
+    }
+
+    flushBits(&w);
+    putWord(&w, 0xFFD9);
+    return w.pos <= out_cap ? w.pos : 0;
+}
+
+// MARK: Stream
+// The bit writer lives in the caller's JpegStream between strips
+static BitWriter streamWriter(const JpegStream* stream) {
+    BitWriter w = {stream->out, stream->pos, stream->cap, stream->bits, stream->count};
+    return w;
+}
+
+static void streamSave(JpegStream* stream, const BitWriter* w) {
+    stream->pos = w->pos;
+    stream->bits = w->bits;
+    stream->count = w->count;
+}
+
+uint8_t jpegStripRows(bool color) {
+    return mcuSize(color);
+}
+
+bool jpegStreamBegin(JpegStream* stream, uint8_t quality, uint8_t* out, size_t out_cap) {
+    if (!stream || !stream->coeffs || !out || stream->width == 0 || stream->height == 0) {
+        return false;
+    }
+    ensureCodes();
+    quality = quality < 1 ? 1 : quality > 100 ? 100 : quality;
+
+    uint8_t luma_quant[64];
+    uint8_t chroma_quant[64];
+    scaleQuant(STD_LUMA_QUANT, quality, luma_quant, stream->luma_div);
+    scaleQuant(STD_CHROMA_QUANT, quality, chroma_quant, stream->chroma_div);
+
+    BitWriter w = {out, 0, out_cap, 0, 0};
+    writeHeaders(&w, stream->width, stream->height, stream->color, luma_quant, chroma_quant);
+    stream->out = out;
+    stream->cap = out_cap;
+    stream->next_y = 0;
+    stream->last_dc[0] = stream->last_dc[1] = stream->last_dc[2] = 0;
+    streamSave(stream, &w);
+    return w.pos <= out_cap;
+}
+
+bool jpegStreamStrip(JpegStream* stream, const uint8_t* rows) {
+    uint8_t mcu = mcuSize(stream->color);
+    if (!rows || !stream->out || stream->next_y >= stream->height || stream->pos > stream->cap) {
+        return false;
+    }
+    uint32_t row_count = stream->height - stream->next_y < mcu ? stream->height - stream->next_y : mcu;
+    prepareStrip(rows, stream->width, row_count, stream->color, stream->coeffs);
+
+    BitWriter w = streamWriter(stream);
+    bool fits = encodeMcus(&w, stream->coeffs, (stream->width + mcu - 1) / mcu, stream->color, stream->luma_div,
+                           stream->chroma_div, stream->last_dc);
+    streamSave(stream, &w);
+    stream->next_y += row_count;
+    return fits;
+}
+
+size_t jpegStreamEnd(JpegStream* stream) {
+    if (!stream->out || stream->next_y < stream->height || stream->pos > stream->cap) {
+        return 0;
+    }
+    BitWriter w = streamWriter(stream);
+    flushBits(&w);
+    putWord(&w, 0xFFD9);
+    streamSave(stream, &w);
+    return w.pos <= w.cap ? w.pos : 0;
+}
+
+// MARK: Budget
+size_t jpegSearchQuality(JpegEncodeFn encode, void* arg, size_t budget, uint8_t min_quality, uint8_t max_quality,
+                         uint8_t* out, uint8_t* quality) {
+    // Usually the first try fits, and then nothing is searched
+    size_t len = encode(arg, max_quality, out, budget);
+    if (len) {
+        if (quality) *quality = max_quality;
+        return len;
+    }
+
+    int low = min_quality;
+    int high = max_quality - 1;
+    int best = 0;
+    size_t best_len = 0;
+    int last_tried = 0;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        len = encode(arg, mid, out, budget);
+        last_tried = mid;
+        if (len) {
+            best = mid;
+            best_len = len;
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    if (best == 0) {
+        return 0;
+    }
+    // A later, failed step overwrote the output
+    if (last_tried != best) {
+        best_len = encode(arg, best, out, budget);
+    }
+    if (quality) *quality = best;
+    return best_len;
+}
+
+static size_t encodeCoefficients(void* arg, uint8_t quality, uint8_t* out, size_t out_cap) {
+    return jpegEncode((const JpegCoefficients*)arg, quality, out, out_cap);
+}
+
+size_t jpegEncodeToBudget(const JpegCoefficients* coeffs, size_t budget, uint8_t min_quality, uint8_t max_quality,
+                          uint8_t* out, uint8_t* quality) {
+    return jpegSearchQuality(encodeCoefficients, (void*)coeffs, budget, min_quality, max_quality, out, quality);
+}
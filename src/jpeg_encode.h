@@ -0,0 +1,134 @@
+#ifndef JPEG_ENCODE_H
+#define JPEG_ENCODE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Baseline JPEG encoder that hits a byte budget
+ *
+ * Encoding is split in two: jpegPrepare converts the pixels to YCbCr
+ * 4:2:0 (or grayscale) and runs the forward DCT once, keeping the
+ * coefficients in encode order; jpegEncode then only quantizes and
+ * Huffman-codes them, so searching for the quality that fits a budget
+ * costs one entropy pass per step instead of a full encode. Buffers are
+ * the caller's, so on the ESP32 they can live in PSRAM.
+ *
+ * Callers that get the pixels a strip at a time use JpegStream instead,
+ * which transforms and codes each strip as it arrives and only ever holds
+ * one MCU row of coefficients.
+ */
+
+typedef enum {
+    JPEG_INPUT_GRAY,        // One byte per pixel
+    JPEG_INPUT_RGB888,      // R, G, B
+} JpegInput;
+
+typedef struct {
+    int16_t* coeffs;        // jpegCoefficientBytes() long, filled by jpegPrepare
+    uint16_t width;
+    uint16_t height;
+    bool color;             // YCbCr 4:2:0 if true, grayscale otherwise
+} JpegCoefficients;
+
+/**
+ * @return Size of the coefficient buffer for an image
+ */
+size_t jpegCoefficientBytes(uint16_t width, uint16_t height, bool color);
+
+/**
+ * Color-convert and transform an image
+ * @param pixels Image, width * height pixels in format, rows packed
+ * @param coeffs coeffs->coeffs must hold jpegCoefficientBytes(); the rest is filled in
+ * @return false for an empty image
+ */
+bool jpegPrepare(const uint8_t* pixels, uint16_t width, uint16_t height, JpegInput format, JpegCoefficients* coeffs);
+
+/**
+ * Quantize and entropy-code prepared coefficients into a JFIF file
+ * @param quality 1..100, as in libjpeg
+ * @param out Output buffer
+ * @param out_cap Output capacity; encoding stops as soon as it is exceeded
+ * @return JPEG size, 0 if it did not fit
+ */
+size_t jpegEncode(const JpegCoefficients* coeffs, uint8_t quality, uint8_t* out, size_t out_cap);
+
+/**
+ * Encode at the highest quality that fits a budget
+ *
+ * Tries max_quality first, then binary-searches down to min_quality.
+ * Steps that overflow the budget stop early, so they are cheap.
+ *
+ * @param budget Largest acceptable size; out must hold this many bytes
+ * @param quality Receives the quality used, if not NULL
+ * @return JPEG size, 0 if even min_quality does not fit
+ */
+size_t jpegEncodeToBudget(const JpegCoefficients* coeffs, size_t budget, uint8_t min_quality, uint8_t max_quality,
+                          uint8_t* out, uint8_t* quality);
+
+// MARK: Streaming
+
+typedef struct {
+    int16_t* coeffs;        // One MCU row: jpegCoefficientBytes(width, jpegStripRows(color), color) long
+    uint16_t width;
+    uint16_t height;
+    bool color;             // YCbCr 4:2:0 if true, grayscale otherwise
+    // Encoder state, set by jpegStreamBegin
+    uint16_t next_y;
+    uint8_t* out;
+    size_t pos;
+    size_t cap;
+    uint32_t bits;
+    int count;
+    int last_dc[3];
+    uint16_t luma_div[64];
+    uint16_t chroma_div[64];
+} JpegStream;
+
+/**
+ * @return Rows per jpegStreamStrip() call: 16 for color, 8 for grayscale
+ */
+uint8_t jpegStripRows(bool color);
+
+/**
+ * Start a JFIF file whose pixels come a strip at a time
+ * @param stream coeffs, width, height and color set by the caller
+ * @param quality 1..100, as in libjpeg
+ * @return false for an empty image or if the headers alone overflow out_cap
+ */
+bool jpegStreamBegin(JpegStream* stream, uint8_t quality, uint8_t* out, size_t out_cap);
+
+/**
+ * Transform and entropy-code the next strip, top to bottom
+ * @param rows jpegStripRows() RGB888 or gray rows, fewer for the last strip, whose last row is repeated
+ * @return false once the output is over out_cap, or past the last strip; stop feeding then
+ */
+bool jpegStreamStrip(JpegStream* stream, const uint8_t* rows);
+
+/**
+ * @return JPEG size, 0 if a strip is missing or it did not fit
+ */
+size_t jpegStreamEnd(JpegStream* stream);
+
+/**
+ * One encode at a quality, for jpegSearchQuality()
+ * @return JPEG size, 0 if it did not fit out_cap
+ */
+typedef size_t (*JpegEncodeFn)(void* arg, uint8_t quality, uint8_t* out, size_t out_cap);
+
+/**
+ * jpegEncodeToBudget's search over any encoder, e.g. one that re-decodes the source per step
+ */
+size_t jpegSearchQuality(JpegEncodeFn encode, void* arg, size_t budget, uint8_t min_quality, uint8_t max_quality,
+                         uint8_t* out, uint8_t* quality);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JPEG_ENCODE_H */
@@ -0,0 +1,32 @@
+#include "latency_stats.h"
+#include <string.h>
+
+void latencyRecord(LatencyWindow* window, uint32_t ms) {
+    window->samples[window->next] = ms;
+    window->next = (window->next + 1) % LATENCY_WINDOW_SIZE;
+    if (window->count < LATENCY_WINDOW_SIZE) {
+        window->count++;
+    }
+}
+
+uint32_t latencyPercentile(const LatencyWindow* window, uint8_t percentile) {
+    if (window->count == 0) {
+        return 0;
+    }
+
+    // Insertion sort a copy, the window is small
+    uint32_t sorted[LATENCY_WINDOW_SIZE];
+    memcpy(sorted, window->samples, window->count * sizeof(uint32_t));
+    for (int i = 1; i < window->count; i++) {
+        uint32_t v = sorted[i];
+        int j = i - 1;
+        while (j >= 0 && sorted[j] > v) {
+            sorted[j + 1] = sorted[j];
+            j--;
+        }
+        sorted[j + 1] = v;
+    }
+
+    size_t index = (size_t)(window->count - 1) * percentile / 100;
+    return sorted[index];
+}
@@ -0,0 +1,38 @@
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LATENCY_WINDOW_SIZE 64
+
+/**
+ * Sliding window of the most recent latency samples
+ */
+typedef struct {
+    uint32_t samples[LATENCY_WINDOW_SIZE];
+    uint16_t count;
+    uint16_t next;
+} LatencyWindow;
+
+/**
+ * Add a sample, evicting the oldest one once the window is full
+ */
+void latencyRecord(LatencyWindow* window, uint32_t ms);
+
+/**
+ * @param percentile 0-100
+ * @return The requested percentile of the window, 0 if it is empty
+ */
+uint32_t latencyPercentile(const LatencyWindow* window, uint8_t percentile);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LATENCY_STATS_H */
@@ -0,0 +1,140 @@
+#include "link_estimator.h"
+#include <string.h>
+
+// MARK: Estimator Config
+static const int8_t BAND_MIN_RSSI = -95;
+static const uint8_t BAND_WIDTH_DB = 5;
+static const uint8_t BAND_COUNT = 11;                   // -95..-45 dBm and stronger
+static const uint32_t DEFAULT_BPS = 60000;              // Until the first upload is measured
+static const size_t MIN_SAMPLE_BYTES = 8 * 1024;        // Smaller uploads measure latency, not throughput
+static const uint8_t STRONGER_DERATE_PCT = 70;          // Per band when borrowing from a stronger band
+
+// Starting guesses for 1/2 and 1/4 scale, refined by linkRecordReencode
+static const uint32_t DEFAULT_REENCODE_MS[LINK_LEVELS] = {0, 700, 350};
+static const uint16_t DEFAULT_SIZE_PERMILLE[LINK_LEVELS] = {1000, 300, 90};
+
+static uint32_t s_band_bps[BAND_COUNT];
+static uint32_t s_any_bps = 0;      // Across all bands, for when RSSI is unknown
+static LinkStats s_stats;
+static bool s_initialized = false;
+
+static void ensureInit(void) {
+    if (s_initialized) {
+        return;
+    }
+    memset(s_band_bps, 0, sizeof(s_band_bps));
+    memset(&s_stats, 0, sizeof(s_stats));
+    memcpy(s_stats.reencode_ms, DEFAULT_REENCODE_MS, sizeof(s_stats.reencode_ms));
+    memcpy(s_stats.size_permille, DEFAULT_SIZE_PERMILLE, sizeof(s_stats.size_permille));
+    s_initialized = true;
+}
+
+static int bandOf(int8_t rssi) {
+    int band = (rssi - BAND_MIN_RSSI) / BAND_WIDTH_DB;
+    if (band < 0) return 0;
+    if (band >= BAND_COUNT) return BAND_COUNT - 1;
+    return band;
+}
+
+// Weighted 3:1 to the history, like the other running averages
+static uint32_t blend(uint32_t average, uint32_t sample) {
+    return average ? (3 * average + sample) / 4 : sample;
+}
+
+// MARK: Samples
+void linkRecordUpload(int8_t rssi, size_t bytes, uint32_t ms) {
+    ensureInit();
+    s_stats.uploads++;
+    s_stats.last_upload_ms = ms;
+    if (rssi != 0) {
+        s_stats.rssi = rssi;
+    }
+    if (bytes < MIN_SAMPLE_BYTES) {
+        return;
+    }
+
+    uint32_t bps = (uint32_t)((uint64_t)bytes * 1000 / (ms ? ms : 1));
+    s_any_bps = blend(s_any_bps, bps);
+    if (rssi != 0) {
+        int band = bandOf(rssi);
+        s_band_bps[band] = blend(s_band_bps[band], bps);
+    }
+}
+
+void linkRecordReencode(uint8_t level, uint32_t ms, size_t full_bytes, size_t bytes) {
+    ensureInit();
+    if (level == 0 || level >= LINK_LEVELS || full_bytes == 0) {
+        return;
+    }
+    s_stats.reencode_ms[level] = blend(s_stats.reencode_ms[level], ms);
+    uint32_t permille = (uint32_t)((uint64_t)bytes * 1000 / full_bytes);
+    s_stats.size_permille[level] = blend(s_stats.size_permille[level], permille > 1000 ? 1000 : permille);
+}
+
+// MARK: Prediction
+static uint32_t throughputAt(int8_t rssi) {
+    if (rssi == 0) {
+        return s_any_bps ? s_any_bps : DEFAULT_BPS;
+    }
+    int band = bandOf(rssi);
+    if (s_band_bps[band]) {
+        return s_band_bps[band];
+    }
+    // A weaker band's throughput is a safe lower bound
+    for (int b = band - 1; b >= 0; b--) {
+        if (s_band_bps[b]) {
+            return s_band_bps[b];
+        }
+    }
+    uint64_t derate = 100;
+    for (int b = band + 1; b < BAND_COUNT; b++) {
+        derate = derate * STRONGER_DERATE_PCT / 100;
+        if (s_band_bps[b]) {
+            uint32_t bps = (uint32_t)(s_band_bps[b] * derate / 100);
+            return bps ? bps : 1;
+        }
+    }
+    return s_any_bps ? s_any_bps : DEFAULT_BPS;
+}
+
+uint32_t linkPredictUploadMs(int8_t rssi, size_t bytes) {
+    ensureInit();
+    return (uint32_t)((uint64_t)bytes * 1000 / throughputAt(rssi));
+}
+
+size_t linkBytesWithin(int8_t rssi, uint32_t ms) {
+    ensureInit();
+    return (size_t)((uint64_t)throughputAt(rssi) * ms / 1000);
+}
+
+uint8_t linkChooseLevel(int8_t rssi, size_t full_bytes, uint32_t budget_ms) {
+    ensureInit();
+    s_stats.rssi = rssi;
+    s_stats.throughput_bps = throughputAt(rssi);
+
+    uint8_t best = 0;
+    uint32_t best_ms = linkPredictUploadMs(rssi, full_bytes);
+    // Never downgrade on the default guess, only on a measured link
+    if (best_ms > budget_ms && s_any_bps) {
+        for (uint8_t level = 1; level < LINK_LEVELS; level++) {
+            size_t bytes = full_bytes * s_stats.size_permille[level] / 1000;
+            uint32_t total_ms = s_stats.reencode_ms[level] + linkPredictUploadMs(rssi, bytes);
+            if (total_ms < best_ms) {
+                best = level;
+                best_ms = total_ms;
+            }
+            if (total_ms <= budget_ms) {
+                break;
+            }
+        }
+    }
+
+    s_stats.decisions[best]++;
+    s_stats.last_predicted_ms = best_ms;
+    return best;
+}
+
+LinkStats linkGetStats(void) {
+    ensureInit();
+    return s_stats;
+}
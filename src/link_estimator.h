@@ -0,0 +1,90 @@
+#ifndef LINK_ESTIMATOR_H
+#define LINK_ESTIMATOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Upload time prediction from link quality
+ *
+ * Every request body upload is timed and folded into a throughput
+ * estimate for the RSSI band it was sent at (5 dB bands), so the same
+ * payload can be predicted to take 300 ms at -55 dBm and 3 s at -85 dBm.
+ * Bands without samples borrow from the nearest weaker band if there is
+ * one, otherwise from the nearest stronger band derated per step.
+ */
+
+#define LINK_LEVELS 3   // Full frame, 1/2 scale, 1/4 scale
+
+/**
+ * Counters and last values, for /status
+ */
+typedef struct {
+    int8_t rssi;                        // Last sampled, dBm (0 if unknown)
+    uint32_t throughput_bps;            // Estimate at that RSSI, bytes/s
+    uint32_t uploads;                   // Uploads measured
+    uint32_t last_upload_ms;            // Measured
+    uint32_t last_predicted_ms;         // Predicted for the last payload sent
+    uint32_t decisions[LINK_LEVELS];    // Payloads sent at each level
+    uint32_t reencode_ms[LINK_LEVELS];  // Estimated cost of producing each level
+    uint16_t size_permille[LINK_LEVELS];// Estimated size of each level relative to the full frame
+} LinkStats;
+
+/**
+ * Record a timed upload
+ * @param rssi Signal strength while sending, 0 if unknown
+ * @param bytes Bytes written
+ * @param ms Time to write them
+ */
+void linkRecordUpload(int8_t rssi, size_t bytes, uint32_t ms);
+
+/**
+ * @return Predicted time to upload bytes at rssi
+ */
+uint32_t linkPredictUploadMs(int8_t rssi, size_t bytes);
+
+/**
+ * @return How many bytes can be uploaded at rssi within ms
+ */
+size_t linkBytesWithin(int8_t rssi, uint32_t ms);
+
+/**
+ * Record how long producing a downgraded payload took and how big it came out
+ * @param level 1..LINK_LEVELS-1
+ * @param ms Time to re-encode
+ * @param full_bytes Size of the full-frame payload
+ * @param bytes Size of the downgraded payload
+ */
+void linkRecordReencode(uint8_t level, uint32_t ms, size_t full_bytes, size_t bytes);
+
+/**
+ * Pick the payload level that gets the upload done soonest within budget
+ *
+ * Level 0 is kept while its predicted upload fits the budget, or until an
+ * upload has been measured. Otherwise
+ * each smaller level is considered, with its size and re-encode cost
+ * taken from past re-encodes, and the first one that fits (or else the
+ * fastest overall) is chosen.
+ *
+ * @param rssi Current signal strength
+ * @param full_bytes Upload size of the full-frame payload
+ * @param budget_ms Upload time budget
+ * @return Chosen level, counted in the stats
+ */
+uint8_t linkChooseLevel(int8_t rssi, size_t full_bytes, uint32_t budget_ms);
+
+/**
+ * @return Snapshot of the stats
+ */
+LinkStats linkGetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LINK_ESTIMATOR_H */
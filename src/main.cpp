@@ -1,37 +1,118 @@
 #include <Arduino.h>
 #include <WiFi.h>
-#include <WebServer.h>
 #include "credentials.h" // Contains WIFI_SSID, WIFI_PASSWORD and GEMINI_API_KEY
 #include "custom_cam.h"
+#include "vision_backend.h"
+#include "vision_transport.h"
+#include "shared_state.h"
+#include "web_server.h"
+#include "frame_hub.h"
+#include "waste_classifier.h"
+#include "request_scheduler.h"
+#include "context_cache.h"
+#include "fewshot_store.h"
+#include "capture_log.h"
+#include "capture_archive.h"
+#include "boot_sequence.h"
+#include "link_estimator.h"
+#include "timer_wheel.h"
+#include "idle_power.h"
+#include "verdict_policy.h"
+#include "frame_source.h"
+#include "esp_timer.h"
 
 // Pin definitions
 #define TRIGGER_PIN  12   // Input pin to trigger image capture
 #define OUTPUT_PIN   13   // Output pin for signaling results
 
-// Waste type definitions
-#define TYPE_PLASTIC    1
-#define TYPE_CARDBOARD  2
-#define TYPE_PAPER      3
-#define TYPE_OTHER      4
-#define TYPE_NONE       5
-#define TYPE_ERROR      6
+// How long a captured frame is worth sending; after that the item has moved on
+#define FRESH_FOR_MS  3000
 
-WebServer server(80);
-bool processingImage = false;
-bool wifiTrigger = false;
-char* lastJsonPayload = NULL;
+#ifndef REQUEST_BURST
+#define REQUEST_BURST 3
+#endif
 
-// Default prompt for trash classification
-const char* DEFAULT_PROMPT = "I want a short answer for which trash type do you see in the image [plastic, cardboard, paper or other], don't write anything else other than one of this list, if you can't see any trash just say None";
+// Lifetime of the server-side cache holding the prompt and few-shot examples
+#ifndef CONTEXT_CACHE_TTL_SEC
+#define CONTEXT_CACHE_TTL_SEC 3600
+#endif
+
+// Upload time above which a smaller re-encode of the frame is considered
+#ifndef UPLOAD_BUDGET_MS
+#define UPLOAD_BUDGET_MS 1500
+#endif
+
+// Smallest re-encode worth sending, however slow the link
+#define MIN_DOWNSCALE_BYTES (8 * 1024)
+
+// Ask for the answer's token log-probabilities; models without support reject the request,
+// and most still report an average without it
+#ifdef RESPONSE_LOGPROBS
+#define REQUEST_LOGPROBS true
+#else
+#define REQUEST_LOGPROBS false
+#endif
+
+// Idle work cadence; the trigger wakes the loop on its own
+#define BOOT_SERVICE_MS  50
+#define HOUSEKEEPING_MS  250
+
+#ifdef MOCK_SERVER_HOST
+#ifndef MOCK_SERVER_PORT
+#define MOCK_SERVER_PORT 8080
+#endif
+// Local mock backend for load tests (see src/host/mock_server.cpp)
+const VisionBackend mockBackend = visionMockBackend(MOCK_SERVER_HOST, MOCK_SERVER_PORT, false);
+#endif
+
+#ifdef CONTROLLER_HOST
+#ifndef CONTROLLER_PORT
+#define CONTROLLER_PORT 80
+#endif
+#ifndef CAMERA_NAME
+#define CAMERA_NAME "chute"
+#endif
+// Remote camera: a controller on the LAN classifies for this chute (see frame_source.h)
+const VisionBackend controllerBackend = visionControllerBackend(CONTROLLER_HOST, CONTROLLER_PORT, CAMERA_NAME);
+#endif
+
+StatusSnapshot status = {};
+
+// Default prompt for trash classification, listing the labels from waste_labels.h
+const char* DEFAULT_PROMPT = WASTE_PROMPT;
+
+// Labelled example images loaded from /fewshot on LittleFS
+VisionExample fewShotExamples[VISION_MAX_EXAMPLES];
+
+// Background work run between items, see timer_wheel.h
+WheelTask bootTask = {};
+WheelTask housekeepingTask = {};
+
+// A GPIO trigger counts once per rising edge, even if the pin stays high past the result
+bool triggerArmed = true;
+
+// Rising edge seen by onTriggerEdge, kept until a capture takes it, so a pulse that
+// ends while the loop is busy with another camera's frame is still classified
+volatile bool triggerEdge = false;
+
+// Ends the result pulse on time whatever the loop is doing
+esp_timer_handle_t pulseTimer = NULL;
 
 // Function prototypes
-void setupServer();
-int parseGeminiResponse(const char* response);
+char* requestVerdict(const VisionRequest* request, uint32_t triggerTime, bool* throttled, int* httpStatus);
+WasteVerdict confirmVerdict(WasteVerdict verdict, SharedFrame** frame, uint32_t triggerTime, CaptureLogRecord* record);
+void logCapture(CaptureLogRecord* record, uint32_t triggerTime, int wasteType, const Thumbnail* thumb);
+void serviceQueuedFrame();
+uint8_t* downscaleForLink(const camera_fb_t* fb, size_t* imageLen);
+void storeLastPayload(SharedFrame* frame);
 void signalResult(int wasteType);
+void serviceBoot(void* arg);
+void housekeeping(void* arg);
+void endPulse(void* arg);
+void IRAM_ATTR onTriggerEdge();
 
 void setup() {
   Serial.begin(9600);
-  delay(1000);
   
   Serial.println("ESP32-CAM Trash Classifier");
   
@@ -39,19 +120,16 @@ void setup() {
   pinMode(TRIGGER_PIN, INPUT_PULLDOWN);
   pinMode(OUTPUT_PIN, OUTPUT);
   
-  // Connect to WiFi
-  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-  Serial.print("Connecting to WiFi");
-  
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(500);
-    Serial.print(".");
-    // Add connection timeout/retry logic here if needed
-  }
+  // The loop sleeps between items; trigger edges and web triggers wake it
+  wheelBegin();
+  const esp_timer_create_args_t pulseArgs = {.callback = endPulse, .name = "pulse"};
+  esp_timer_create(&pulseArgs, &pulseTimer);
   
-  Serial.println();
-  Serial.print("IP address: ");
-  Serial.println(WiFi.localIP());
+  // Associate in the background while the camera and storage come up
+  bootStartNetwork(WIFI_SSID, WIFI_PASSWORD);
+  bootTask.fn = serviceBoot;
+  bootTask.period_ms = BOOT_SERVICE_MS;
+  wheelStart(&bootTask, BOOT_SERVICE_MS);
 
   // Initialize camera
   if (!initCamera()) {
@@ -61,124 +139,400 @@ void setup() {
   }
   Serial.println("Camera initialized");
   
-  // Setup and start server
-  setupServer();
-  server.begin();
+  // After the camera driver, which installs the shared GPIO interrupt service
+  attachInterrupt(digitalPinToInterrupt(TRIGGER_PIN), onTriggerEdge, CHANGE);
   
+  // Park the sensor, CPU and radio between items; the trigger pin wakes them
+  idleBegin(TRIGGER_PIN);
+
+#ifdef MOCK_SERVER_HOST
+  visionSetBackend(&mockBackend);
+  Serial.printf("Using mock backend at %s:%d\n", MOCK_SERVER_HOST, MOCK_SERVER_PORT);
+#endif
+
+#ifdef CONTROLLER_HOST
+  visionSetBackend(&controllerBackend);
+  Serial.printf("Classifying through the controller at %s:%d as %s\n", CONTROLLER_HOST, CONTROLLER_PORT, CAMERA_NAME);
+#endif
+
+#ifdef CHUNKED_UPLOAD
+  // Overlap base64 encoding with transmission
+  visionSetChunkedUpload(true);
+#endif
+
+#ifdef HEDGE_MAX_PER_MINUTE
+  // Duplicate slow requests on a second connection, capped per minute
+  visionSetHedging(true, HEDGE_MAX_PER_MINUTE);
+#endif
+
+#ifdef REQUESTS_PER_MINUTE
+  // Pace requests to stay under the backend quota
+  schedulerConfigure(REQUESTS_PER_MINUTE, REQUEST_BURST);
+#endif
+
+  // Send the prompt and few-shot examples once as a cached context instead of with every image
+  uint8_t exampleCount = fewShotLoad("/fewshot", fewShotExamples, VISION_MAX_EXAMPLES);
+  if (exampleCount > 0) {
+    contextCacheConfigure(DEFAULT_PROMPT, fewShotExamples, exampleCount, CONTEXT_CACHE_TTL_SEC);
+    Serial.printf("Loaded %u few-shot examples\n", exampleCount);
+  }
+
+  // History of every classification in flash, served as CSV at /log
+  if (!captureLogBegin()) {
+    Serial.println("Capture log unavailable");
+  }
+
+  // Thumbnails of recent captures for reviewing verdicts at /captures
+  if (!archiveBegin()) {
+    Serial.println("Capture archive unavailable");
+  }
+
+  // Frames pushed by other chutes' cameras, classified between this camera's items
+  frameSourcesBegin();
+
+  // Start the HTTP control server on its own task
+  if (!startWebServer(80)) {
+    Serial.println("Web server failed to start");
+  }
+  
+  // Refresh the context cache and write the log between items, never while one is waiting
+  housekeepingTask.fn = housekeeping;
+  housekeepingTask.period_ms = HOUSEKEEPING_MS;
+  wheelStart(&housekeepingTask, HOUSEKEEPING_MS);
+  
+  Serial.printf("Ready to capture after %lu ms\n", (unsigned long)millis());
   Serial.println("Waiting for trigger...");
 }
 
 void loop() {
-  // Handle web requests
-  server.handleClient();
+  // Check for a new rising edge on the trigger pin or a WiFi trigger, unless already processing
+  bool triggerHigh = digitalRead(TRIGGER_PIN) == HIGH;
+  if (!triggerHigh) triggerArmed = true;
+  bool gpioTrigger = (triggerHigh && triggerArmed) || triggerEdge;
   
-  // Check if trigger pin is HIGH or WiFi trigger is set, and not already processing
-  if ((digitalRead(TRIGGER_PIN) == HIGH || wifiTrigger) && !processingImage) {
-    processingImage = true;
-    wifiTrigger = false; // Reset WiFi trigger flag
+  // A trigger or a preview client brings the device out of parking
+  bool remoteTrigger = pipelineGetState() == PIPELINE_TRIGGERED;
+  bool triggered = gpioTrigger || remoteTrigger;
+  if (triggered || webStreamClients() > 0) idleResume(triggered);
+  
+  if (pipelineBegin(gpioTrigger)) {
+    uint32_t triggerTime = millis();
+    if (triggerHigh) triggerArmed = false;
+    // A WiFi trigger is served first; a latched edge then gets its own capture
+    if (gpioTrigger && !remoteTrigger) triggerEdge = false;
+    CaptureLogRecord logRecord = {};
+    logRecord.trigger_ms = triggerTime;
     Serial.println("Taking image...");
     
-    // Capture image as JSON for Gemini
-    size_t encodedSize = 0;
-    char* jsonPayload = captureImageAsGeminiJson(DEFAULT_PROMPT, &encodedSize, GEMINI_API_KEY);
+    // Resolve and handshake with the backend while flash and capture run
+    if (bootNetworkReady()) visionConnPrewarm(visionGetBackend());
+    
+    // Free the preview frame so the driver has a buffer for the capture
+    frameHubFlush();
     
-    if (!jsonPayload) {
+    // Capture frame with flash, shared with preview clients without copying
+    SharedFrame* frame = frameWrap(captureFlashFrame());
+    idleCaptured();
+    
+    if (!frame) {
       Serial.println("Capture failed");
-      processingImage = false;
+      logCapture(&logRecord, triggerTime, TYPE_ERROR, NULL);
+      status.failures++;
+      statusPublish(&status);
+      pipelineEnd();
       return;
     }
     
-    // Send to Gemini API
-    char* geminiResponse = sendToGeminiAPI(jsonPayload, GEMINI_API_KEY);
+    frameHubPublish(frame);
+    const camera_fb_t* fb = frameBuffer(frame);
+    logRecord.capture_ms = millis() - triggerTime;
+    logRecord.jpeg_len = fb->len;
+    
+    // Local checks on the capture thumbnail take milliseconds, a request takes a second
+    const Thumbnail* thumb = lastCaptureThumbnail();
+    if (thumb) {
+      status.last_sharpness = thumbnailSharpness(thumb);
+      Serial.printf("Sharpness: %u\n", status.last_sharpness);
+      logRecord.sharpness = status.last_sharpness;
+    }
+    
+    char* geminiResponse = NULL;
+    bool throttled = false;
+    int wasteType = TYPE_ERROR;
+    logRecord.analysis_ms = millis() - triggerTime - logRecord.capture_ms;
+    if (thumb && backgroundMatches(thumb)) {
+      // Same as the empty chute the backend confirmed before, no need to ask again
+      Serial.println("Chute empty, skipping request");
+      wasteType = TYPE_NONE;
+      status.local_results++;
+      logRecord.flags |= CAPTURE_LOG_LOCAL;
+    } else {
+      // Send to Gemini API, encoding straight from the frame buffer unless the link is too slow for it
+      size_t imageLen = fb->len;
+      uint8_t* downscaled = downscaleForLink(fb, &imageLen);
+      if (downscaled) logRecord.flags |= CAPTURE_LOG_DOWNGRADED;
+      VisionRequest request = {DEFAULT_PROMPT, downscaled ? downscaled : fb->buf, imageLen,
+                               contextCacheCurrent(), WASTE_RESPONSE_ENUM, REQUEST_LOGPROBS};
+      uint32_t requestStart = millis();
+      int httpStatus = 0;
+      geminiResponse = requestVerdict(&request, triggerTime, &throttled, &httpStatus);
+      logRecord.request_ms = millis() - requestStart;
+      logRecord.http_status = httpStatus;
+      if (request.context && request.context->cache_name) logRecord.flags |= CAPTURE_LOG_CACHED;
+      free(downscaled);
+      
+      if (geminiResponse) {
+        // A second look if the backend was unsure; a new capture replaces frame and thumbnail
+        WasteVerdict verdict = confirmVerdict(parseVerdict(geminiResponse), &frame, triggerTime, &logRecord);
+        if (logRecord.flags & CAPTURE_LOG_RECAPTURED) {
+          fb = frameBuffer(frame);
+          thumb = lastCaptureThumbnail();
+          logRecord.jpeg_len = fb->len;
+        }
+        wasteType = verdict.waste_type;
+        classifierRemember(wasteType, fb->len, thumb ? thumbnailHash(thumb) : 0);
+        if (thumb && wasteType == TYPE_NONE) backgroundLearn(thumb);
+      } else if (throttled) {
+        // Over quota: fall back to a local guess instead of failing
+        wasteType = classifyLocally(fb->len, thumb ? thumbnailHash(thumb) : 0);
+        if (wasteType != TYPE_ERROR) {
+          Serial.println("Over quota, using local verdict");
+          status.degraded++;
+          logRecord.flags |= CAPTURE_LOG_DEGRADED;
+        }
+      }
+    }
     
-    if (!geminiResponse) {
+    if (!geminiResponse && wasteType == TYPE_ERROR) {
       Serial.println("API request failed");
+      logCapture(&logRecord, triggerTime, TYPE_ERROR, thumb);
       // Save JSON for web viewing even if Gemini fails
-      if (lastJsonPayload) free(lastJsonPayload);
-      lastJsonPayload = jsonPayload;
-      processingImage = false;
+      storeLastPayload(frame);
+      status.failures++;
+      statusPublish(&status);
+      pipelineEnd();
       return;
     }
     
-    // Parse response and signal result
-    int wasteType = parseGeminiResponse(geminiResponse);
     Serial.print("Result: ");
-    
-    switch(wasteType) {
-      case TYPE_PLASTIC: Serial.println("Plastic"); break;
-      case TYPE_CARDBOARD: Serial.println("Cardboard"); break;
-      case TYPE_PAPER: Serial.println("Paper"); break;
-      case TYPE_OTHER: Serial.println("Other"); break;
-      case TYPE_NONE: Serial.println("None"); break;
-      default: Serial.println("Error"); break;
-    }
+    Serial.println(wasteTypeName(wasteType));
     
     signalResult(wasteType);
+    logCapture(&logRecord, triggerTime, wasteType, thumb);
     
-    // Cleanup
-    free(geminiResponse);
-    if (lastJsonPayload) free(lastJsonPayload);
-    lastJsonPayload = jsonPayload;
+    status.captures++;
+    status.last_result = wasteType;
+    status.last_latency_ms = millis() - triggerTime;
+    status.last_result_at = millis();
+    statusPublish(&status);
     
-    // Wait for trigger to go LOW again
-    while (digitalRead(TRIGGER_PIN) == HIGH) {
-      server.handleClient();
-      delay(10);
-    }
+    // Cleanup, the JSON for web viewing is built after the result is out
+    free(geminiResponse);
+    storeLastPayload(frame);
     
     Serial.println("Waiting for trigger...");
-    processingImage = false;
+    pipelineEnd();
+    return;
+  }
+  
+  // Other chutes' frames go out back to back on the same warm connection, one per
+  // pass; a frame can take a few seconds, and a trigger edge meanwhile is latched
+  // by onTriggerEdge and picked up on the next pass
+  if (frameSourcePending() > 0) {
+    idleResume(false);
+    serviceQueuedFrame();
+    return;
   }
   
-  delay(10); // Small delay to prevent watchdog issues
+  // Idle: run whatever is due, park once it has been quiet for a while, then sleep
+  // until the next deadline or a trigger
+  uint32_t nextDue = wheelRunDue();
+  idleService();
+  wheelWait(nextDue);
 }
 
-void setupServer() {
-  // Home page
-  server.on("/", HTTP_GET, []() {
-    String html = "<html><body>";
-    html += "<h1>ESP32-CAM Trash Classifier</h1>";
-    html += "<p><a href='/photo'>View Latest Capture</a></p>";
-    html += "<p><a href='/trigger'>Trigger New Capture</a></p>";
-    html += "</body></html>";
-    server.send(200, "text/html", html);
-  });
-  
-  // Latest image JSON
-  server.on("/photo", HTTP_GET, []() {
-    if (!lastJsonPayload) {
-      server.send(404, "text/plain", "No image captured yet");
-      return;
-    }
-    server.send(200, "application/json", lastJsonPayload);
-  });
-  
-  // WiFi trigger endpoint
-  server.on("/trigger", HTTP_GET, []() {
-    if (!processingImage) {
-      wifiTrigger = true;
-      server.send(200, "text/plain", "Triggered successfully");
-    } else {
-      server.send(409, "text/plain", "Already processing an image");
+void serviceBoot(void* arg) {
+  // Finish bringing the network up without holding back captures
+  bootService();
+  if (bootNetworkReady()) wheelStop(&bootTask);
+}
+
+void housekeeping(void* arg) {
+  if (bootNetworkReady()) contextCacheMaintain(GEMINI_API_KEY);
+  captureLogFlush(false);
+}
+
+void IRAM_ATTR onTriggerEdge() {
+  if (digitalRead(TRIGGER_PIN) == HIGH) triggerEdge = true;
+  idleWakeFromIsr();
+  wheelWakeFromIsr();
+}
+
+char* requestVerdict(const VisionRequest* request, uint32_t triggerTime, bool* throttled, int* httpStatus) {
+  // Just after boot the network may still be coming up: wait while the frame stays fresh
+  uint32_t age = millis() - triggerTime;
+  if (age >= FRESH_FOR_MS || !bootWaitForNetwork(FRESH_FOR_MS - age)) {
+    return NULL;
+  }
+  
+  // Wait for quota only as long as the frame stays fresh
+  age = millis() - triggerTime;
+  if (age >= FRESH_FOR_MS || !schedulerAcquire(REQUEST_FRESH, FRESH_FOR_MS - age)) {
+    *throttled = true;
+    return NULL;
+  }
+  
+  char* response = visionSendRequest(request, GEMINI_API_KEY);
+  VisionResponseInfo info = visionLastResponse();
+  schedulerReportResponse(info.status, info.retry_after_ms);
+  *httpStatus = info.status;
+  // The request already went out inline; stop referencing the cache until it is recreated
+  if (info.cache_rejected) contextCacheInvalidate();
+  *throttled = info.status == 429 || info.status == 503;
+  
+  // Retry once if the backend asked for a pause short enough to keep the frame fresh
+  age = millis() - triggerTime;
+  if (!response && *throttled && age < FRESH_FOR_MS &&
+      schedulerAcquire(REQUEST_BACKGROUND, FRESH_FOR_MS - age)) {
+    response = visionSendRequest(request, GEMINI_API_KEY);
+    info = visionLastResponse();
+    schedulerReportResponse(info.status, info.retry_after_ms);
+    *httpStatus = info.status;
+    *throttled = info.status == 429 || info.status == 503;
+  }
+  return response;
+}
+
+WasteVerdict confirmVerdict(WasteVerdict verdict, SharedFrame** frame, uint32_t triggerTime, CaptureLogRecord* record) {
+  // The second attempt costs about the first round trip, plus the full upload or a new capture
+  bool downscaled = record->flags & CAPTURE_LOG_DOWNGRADED;
+  uint32_t age = millis() - triggerTime;
+  uint32_t remaining = age < FRESH_FOR_MS ? FRESH_FOR_MS - age : 0;
+  size_t fullPayload = (frameBuffer(*frame)->len + 2) / 3 * 4;
+  uint32_t retryMs = record->request_ms +
+                     (downscaled ? linkPredictUploadMs(visionLinkRssi(), fullPayload) : record->capture_ms);
+  VerdictAction action = verdictPolicyDecide(&verdict, downscaled, remaining, retryMs);
+  if (action == VERDICT_ACCEPT) {
+    verdictPolicyRecord(&verdict);
+    return verdict;
+  }
+  
+  if (action == VERDICT_RECAPTURE) {
+    Serial.println("Unsure, capturing again");
+    frameHubFlush();
+    SharedFrame* retry = frameWrap(captureFlashFrame());
+    if (!retry) {
+      verdictPolicyRecord(&verdict);
+      return verdict;
     }
-  });
+    frameHubPublish(retry);
+    frameRelease(*frame);
+    *frame = retry;
+    record->flags |= CAPTURE_LOG_RECAPTURED;
+  } else {
+    Serial.println("Unsure, asking again with the full frame");
+  }
+  record->flags |= CAPTURE_LOG_REQUERIED;
+  
+  // Only with quota to spare: the next trigger's request outranks a second opinion
+  const camera_fb_t* fb = frameBuffer(*frame);
+  VisionRequest request = {DEFAULT_PROMPT, fb->buf, fb->len, contextCacheCurrent(), WASTE_RESPONSE_ENUM, REQUEST_LOGPROBS};
+  char* response = NULL;
+  age = millis() - triggerTime;
+  if (age < FRESH_FOR_MS && schedulerAcquire(REQUEST_BACKGROUND, FRESH_FOR_MS - age)) {
+    response = visionSendRequest(&request, GEMINI_API_KEY);
+    VisionResponseInfo info = visionLastResponse();
+    schedulerReportResponse(info.status, info.retry_after_ms);
+    if (info.cache_rejected) contextCacheInvalidate();
+  }
+  
+  WasteVerdict second = {TYPE_ERROR, VISION_FINISH_UNKNOWN, -1};
+  if (response) {
+    second = parseVerdict(response);
+    free(response);
+  }
+  if (verdictPolicyPreferSecond(&verdict, &second)) verdict = second;
+  verdictPolicyRecord(&verdict);
+  return verdict;
 }
 
-int parseGeminiResponse(const char* response) {
-  String resp = String(response);
-  resp.toLowerCase();
+uint8_t* downscaleForLink(const camera_fb_t* fb, size_t* imageLen) {
+  // Base64 makes the upload a third bigger than the JPEG
+  int8_t rssi = visionLinkRssi();
+  uint8_t level = linkChooseLevel(rssi, (fb->len + 2) / 3 * 4, UPLOAD_BUDGET_MS);
+  if (level == 0) {
+    return NULL;
+  }
   
-  if (resp.indexOf("plastic") >= 0) return TYPE_PLASTIC;
-  if (resp.indexOf("cardboard") >= 0) return TYPE_CARDBOARD;
-  if (resp.indexOf("paper") >= 0) return TYPE_PAPER;
-  if (resp.indexOf("other") >= 0) return TYPE_OTHER;
-  if (resp.indexOf("none") >= 0) return TYPE_NONE;
+  // Whatever upload time the re-encode leaves sets the JPEG's byte budget
+  uint32_t reencodeMs = linkGetStats().reencode_ms[level];
+  uint32_t uploadMs = UPLOAD_BUDGET_MS > reencodeMs ? UPLOAD_BUDGET_MS - reencodeMs : 0;
+  size_t budget = linkBytesWithin(rssi, uploadMs) / 4 * 3;
+  if (budget < MIN_DOWNSCALE_BYTES) budget = MIN_DOWNSCALE_BYTES;
+  if (budget > fb->len) budget = fb->len;
   
-  return TYPE_ERROR;
+  uint32_t start = millis();
+  size_t len = 0;
+  uint8_t* downscaled = frameDownscale(fb, level, budget, &len);
+  if (!downscaled) {
+    return NULL;
+  }
+  linkRecordReencode(level, millis() - start, fb->len, len);
+  Serial.printf("Weak link, sending %u bytes instead of %u\n", (unsigned)len, (unsigned)fb->len);
+  *imageLen = len;
+  return downscaled;
+}
+
+void serviceQueuedFrame() {
+  SourceResult result;
+  if (!frameSourceService(contextCacheCurrent(), DEFAULT_PROMPT, GEMINI_API_KEY, FRESH_FOR_MS, &result)) {
+    return;
+  }
+  if (result.cache_rejected) contextCacheInvalidate();
+  Serial.printf("Camera %u: %s\n", result.source_id, wasteTypeName(result.waste_type));
+  
+  CaptureLogRecord record = {};
+  record.trigger_ms = result.queued_ms;
+  record.jpeg_len = result.jpeg_len;
+  record.request_ms = result.request_ms;
+  record.http_status = result.http_status;
+  record.source = result.source_id;
+  logCapture(&record, result.queued_ms, result.waste_type, NULL);
+}
+
+void logCapture(CaptureLogRecord* record, uint32_t triggerTime, int wasteType, const Thumbnail* thumb) {
+  record->total_ms = millis() - triggerTime;
+  record->verdict = wasteType;
+  record->rssi = WiFi.RSSI();
+  captureLogAppend(record);
+  
+  // Archive the thumbnail already decoded for the local checks, never the full frame
+  if (thumb) {
+    ArchiveEntry entry = {};
+    entry.trigger_ms = triggerTime;
+    entry.jpeg_len = record->jpeg_len;
+    entry.latency_ms = record->total_ms;
+    entry.verdict = wasteType;
+    archiveAdd(thumb, &entry);
+  }
+}
+
+void storeLastPayload(SharedFrame* frame) {
+  size_t jsonLen = 0;
+  char* jsonPayload = encodeFrameAsGeminiJson(frameBuffer(frame), DEFAULT_PROMPT, &jsonLen);
+  frameRelease(frame);
+  
+  // Readers still sending the previous payload keep their own reference
+  if (jsonPayload) payloadPublish(jsonPayload, jsonLen);
 }
 
 void signalResult(int wasteType) {
+  // Length corresponds to waste type; the timer ends it while the loop moves on
+  esp_timer_stop(pulseTimer);
   digitalWrite(OUTPUT_PIN, HIGH);
-  delay(50 * wasteType);  // Length corresponds to waste type
+  esp_timer_start_once(pulseTimer, (uint64_t)wastePulseMs(wasteType) * 1000);
+}
+
+void endPulse(void* arg) {
   digitalWrite(OUTPUT_PIN, LOW);
 }
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include "platform_port.h"
+#include <stdlib.h>
+
+typedef struct {
+    void (*fn)(void*);
+    void* arg;
+} TaskStart;
+
+#ifdef ARDUINO
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+static const uint32_t PORT_TASK_STACK = 8192;  // Enough for an mbedTLS handshake
+
+// MARK: Semaphores
+PortSem portSemCreate(unsigned initial) {
+    return xSemaphoreCreateCounting(8, initial);
+}
+
+void portSemTake(PortSem sem) {
+    xSemaphoreTake((SemaphoreHandle_t)sem, portMAX_DELAY);
+}
+
+void portSemGive(PortSem sem) {
+    xSemaphoreGive((SemaphoreHandle_t)sem);
+}
+
+bool portSemTakeTimeout(PortSem sem, uint32_t timeout_ms) {
+    return xSemaphoreTake((SemaphoreHandle_t)sem, pdMS_TO_TICKS(timeout_ms)) == pdTRUE;
+}
+
+void PORT_ISR_ATTR portSemGiveFromIsr(PortSem sem) {
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR((SemaphoreHandle_t)sem, &woken);
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+void portSemDelete(PortSem sem) {
+    if (sem) {
+        vSemaphoreDelete((SemaphoreHandle_t)sem);
+    }
+}
+
+// MARK: Tasks
+static void taskTrampoline(void* arg) {
+    TaskStart start = *(TaskStart*)arg;
+    free(arg);
+    start.fn(start.arg);
+    vTaskDelete(NULL);
+}
+
+bool portTaskStart(void (*fn)(void*), const char* name, void* arg) {
+    TaskStart* start = (TaskStart*)malloc(sizeof(TaskStart));
+    if (!start) {
+        return false;
+    }
+    start->fn = fn;
+    start->arg = arg;
+
+    // Same priority as the caller so producer and consumer interleave fairly
+    if (xTaskCreate(taskTrampoline, name, PORT_TASK_STACK, start, uxTaskPriorityGet(NULL), NULL) != pdPASS) {
+        free(start);
+        return false;
+    }
+    return true;
+}
+
+#else
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#include <unistd.h>
+
+// MARK: Time
+static uint64_t monotonicMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static const uint64_t s_start_ms = monotonicMs();
+
+uint32_t millis(void) {
+    return (uint32_t)(monotonicMs() - s_start_ms);
+}
+
+void delay(uint32_t ms) {
+    usleep(ms * 1000);
+}
+
+// MARK: Semaphores
+PortSem portSemCreate(unsigned initial) {
+    sem_t* sem = (sem_t*)malloc(sizeof(sem_t));
+    if (sem && sem_init(sem, 0, initial) != 0) {
+        free(sem);
+        return NULL;
+    }
+    return sem;
+}
+
+void portSemTake(PortSem sem) {
+    while (sem_wait((sem_t*)sem) != 0) {
+    }
+}
+
+void portSemGive(PortSem sem) {
+    sem_post((sem_t*)sem);
+}
+
+bool portSemTakeTimeout(PortSem sem, uint32_t timeout_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    while (sem_timedwait((sem_t*)sem, &deadline) != 0) {
+        if (errno == ETIMEDOUT) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void portSemGiveFromIsr(PortSem sem) {
+    sem_post((sem_t*)sem);
+}
+
+void portSemDelete(PortSem sem) {
+    if (sem) {
+        sem_destroy((sem_t*)sem);
+        free(sem);
+    }
+}
+
+// MARK: Threads
+static void* threadTrampoline(void* arg) {
+    TaskStart start = *(TaskStart*)arg;
+    free(arg);
+    start.fn(start.arg);
+    return NULL;
+}
+
+bool portTaskStart(void (*fn)(void*), const char* name, void* arg) {
+    (void)name;
+    TaskStart* start = (TaskStart*)malloc(sizeof(TaskStart));
+    if (!start) {
+        return false;
+    }
+    start->fn = fn;
+    start->arg = arg;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, threadTrampoline, start) != 0) {
+        free(start);
+        return false;
+    }
+    pthread_detach(thread);
+    return true;
+}
+
+#endif /* ARDUINO */
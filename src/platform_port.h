@@ -0,0 +1,66 @@
+#ifndef PLATFORM_PORT_H
+#define PLATFORM_PORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#define PORT_ISR_ATTR IRAM_ATTR     // Functions an interrupt handler calls must live in IRAM
+#else
+#define PORT_ISR_ATTR
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef ARDUINO
+
+/**
+ * Milliseconds since process start (host stand-in for the Arduino core)
+ */
+uint32_t millis(void);
+
+/**
+ * Block the calling thread for the given number of milliseconds
+ */
+void delay(uint32_t ms);
+#endif /* ARDUINO */
+
+/**
+ * Counting semaphore (FreeRTOS on the ESP32, POSIX on Linux)
+ */
+typedef void* PortSem;
+
+/**
+ * @param initial Initial count
+ * @return Semaphore handle or NULL on failure
+ */
+PortSem portSemCreate(unsigned initial);
+void portSemTake(PortSem sem);
+void portSemGive(PortSem sem);
+
+/**
+ * @return true if taken, false if timeout_ms passed first
+ */
+bool portSemTakeTimeout(PortSem sem, uint32_t timeout_ms);
+
+/**
+ * portSemGive for interrupt handlers
+ */
+void portSemGiveFromIsr(PortSem sem);
+void portSemDelete(PortSem sem);
+
+/**
+ * Run fn(arg) on a new task/thread; the task ends when fn returns
+ * @return true if the task was started
+ */
+bool portTaskStart(void (*fn)(void*), const char* name, void* arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PLATFORM_PORT_H */
@@ -0,0 +1,146 @@
+#include "request_scheduler.h"
+#include "platform_port.h"
+
+// MARK: Scheduler Config
+static const uint32_t TOKEN_SCALE = 60000;          // per_minute / 60000 ms refills exactly
+static const uint32_t BACKOFF_INITIAL_MS = 1000;
+static const uint32_t BACKOFF_MAX_MS = 60000;
+
+static uint16_t s_per_minute = 0;
+static uint32_t s_capacity = 0;
+static uint32_t s_tokens = 0;
+static uint32_t s_refilled_at = 0;
+
+static uint32_t s_paused_until = 0;
+static bool s_paused = false;
+static uint32_t s_backoff_ms = BACKOFF_INITIAL_MS;
+
+static SchedulerStats s_stats;
+
+// Given when the budget is reconfigured, so a waiting caller re-reads it
+static PortSem budgetChanged(void) {
+    static PortSem sem = portSemCreate(0);
+    return sem;
+}
+
+void schedulerConfigure(uint16_t per_minute, uint8_t burst) {
+    s_per_minute = per_minute;
+    s_capacity = (burst ? burst : 1) * TOKEN_SCALE;
+    s_tokens = s_capacity;
+    s_refilled_at = millis();
+    if (PortSem changed = budgetChanged()) {
+        portSemGive(changed);
+    }
+}
+
+// MARK: Bucket
+static uint32_t tokensAt(uint32_t now) {
+    if ((int32_t)(now - s_refilled_at) <= 0) {
+        return s_tokens;
+    }
+    uint64_t tokens = s_tokens + (uint64_t)(now - s_refilled_at) * s_per_minute;
+    return tokens > s_capacity ? s_capacity : (uint32_t)tokens;
+}
+
+static void refill(uint32_t now) {
+    if ((int32_t)(now - s_refilled_at) > 0) {
+        s_tokens = tokensAt(now);
+        s_refilled_at = now;
+    }
+}
+
+static bool tryTake(RequestPriority priority, uint32_t now) {
+    if (s_paused) {
+        if ((int32_t)(now - s_paused_until) < 0) {
+            return false;
+        }
+        s_paused = false;
+    }
+    if (s_per_minute == 0) {
+        return true;
+    }
+
+    refill(now);
+    // Background requests leave the last token for the next trigger
+    uint32_t needed = priority == REQUEST_FRESH ? TOKEN_SCALE : 2 * TOKEN_SCALE;
+    if (s_tokens < needed) {
+        return false;
+    }
+    s_tokens -= TOKEN_SCALE;
+    return true;
+}
+
+/**
+ * @return ms until tryTake could succeed, if no throttling arrives meanwhile
+ */
+static uint32_t tokenWait(RequestPriority priority, uint32_t now) {
+    uint32_t wait = 0;
+    if (s_paused && (int32_t)(s_paused_until - now) > 0) {
+        wait = s_paused_until - now;
+    }
+    if (s_per_minute == 0) {
+        return wait;
+    }
+    uint32_t tokens = tokensAt(now + wait);
+    uint32_t needed = priority == REQUEST_FRESH ? TOKEN_SCALE : 2 * TOKEN_SCALE;
+    if (tokens < needed) {
+        wait += (needed - tokens + s_per_minute - 1) / s_per_minute;
+    }
+    return wait;
+}
+
+bool schedulerAcquire(RequestPriority priority, uint32_t max_wait_ms) {
+    uint32_t start = millis();
+    for (;;) {
+        uint32_t now = millis();
+        if (tryTake(priority, now)) {
+            s_stats.granted++;
+            return true;
+        }
+
+        // The refill is a known time away: sleep until then, or degrade now if it is too late
+        uint32_t waited = now - start;
+        uint32_t wait = tokenWait(priority, now);
+        PortSem changed = budgetChanged();
+        if (waited >= max_wait_ms || wait > max_wait_ms - waited || !changed) {
+            if (priority == REQUEST_FRESH) {
+                s_stats.degraded++;
+            }
+            return false;
+        }
+        portSemTakeTimeout(changed, wait ? wait : 1);
+    }
+}
+
+// MARK: Backend Feedback
+void schedulerReportResponse(int http_status, uint32_t retry_after_ms) {
+    if (http_status != 429 && http_status != 503) {
+        if (http_status >= 200 && http_status < 300) {
+            s_backoff_ms = BACKOFF_INITIAL_MS;
+        }
+        return;
+    }
+
+    // Without a Retry-After, back off exponentially
+    s_stats.throttled++;
+    uint32_t pause = retry_after_ms;
+    if (pause == 0) {
+        pause = s_backoff_ms;
+        s_backoff_ms = s_backoff_ms * 2 > BACKOFF_MAX_MS ? BACKOFF_MAX_MS : s_backoff_ms * 2;
+    }
+    s_paused = true;
+    s_paused_until = millis() + pause;
+
+    // The backend's window is full, so start again from an empty bucket
+    s_tokens = 0;
+    s_refilled_at = s_paused_until;
+}
+
+SchedulerStats schedulerGetStats(void) {
+    SchedulerStats stats = s_stats;
+    uint32_t now = millis();
+    // Don't refill from here, the web task only reads
+    stats.tokens = s_per_minute > 0 ? tokensAt(now) / TOKEN_SCALE : 0;
+    stats.paused_ms = s_paused && (int32_t)(s_paused_until - now) > 0 ? s_paused_until - now : 0;
+    return stats;
+}
@@ -0,0 +1,68 @@
+#ifndef REQUEST_SCHEDULER_H
+#define REQUEST_SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Quota-aware pacing of backend requests
+ *
+ * A token bucket keeps bursts of triggers under the backend's per-minute
+ * quota, and a 429/503 from the backend pauses all requests for its
+ * Retry-After. Fresh triggers may spend the last token; retries and hedges
+ * only run while the bucket has tokens to spare, so they never push a
+ * fresh capture into the quota.
+ */
+
+typedef enum {
+    REQUEST_FRESH = 0,    // A trigger that just happened
+    REQUEST_BACKGROUND    // Retries and hedged duplicates
+} RequestPriority;
+
+/**
+ * Counters and current bucket state
+ */
+typedef struct {
+    uint32_t granted;       // Requests allowed through
+    uint32_t throttled;     // 429/503 responses from the backend
+    uint32_t degraded;      // Fresh requests refused because no token came in time
+    uint16_t tokens;        // Whole tokens available now
+    uint32_t paused_ms;     // Remaining backoff after a throttled response
+} SchedulerStats;
+
+/**
+ * Set the request budget
+ * @param per_minute Sustained requests per minute, 0 to only honour backend throttling
+ * @param burst Bucket size, requests allowed back to back after an idle period
+ */
+void schedulerConfigure(uint16_t per_minute, uint8_t burst);
+
+/**
+ * Wait for a request token
+ * @param priority REQUEST_FRESH may take the last token, REQUEST_BACKGROUND may not
+ * @param max_wait_ms Give up if no token is available within this time
+ * @return true if the caller may send, false to degrade instead
+ */
+bool schedulerAcquire(RequestPriority priority, uint32_t max_wait_ms);
+
+/**
+ * Report how the backend answered a granted request
+ * @param http_status Response status, 0 if no response arrived
+ * @param retry_after_ms Backend's requested delay, 0 if none was given
+ */
+void schedulerReportResponse(int http_status, uint32_t retry_after_ms);
+
+/**
+ * @return Counters since boot and the current bucket state
+ */
+SchedulerStats schedulerGetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REQUEST_SCHEDULER_H */
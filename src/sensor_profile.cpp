@@ -0,0 +1,178 @@
+#include "sensor_profile.h"
+#include <Arduino.h>
+#include "esp_camera.h"
+#include <string.h>
+
+// MARK: OV2640 Registers
+#define OV2640_REG_GAIN   0x100
+#define OV2640_REG_REG04  0x104     // AEC[1:0]
+#define OV2640_REG_COM2   0x109
+#define OV2640_REG_AEC    0x110     // AEC[9:2]
+#define OV2640_REG_COM8   0x113
+#define OV2640_REG_REG45  0x145     // AEC[15:10]
+#define OV2640_REG_QS     0x044     // DSP bank: JPEG quantization scale, as set_quality writes it
+
+#define COM2_STANDBY      0x10
+#define COM8_AUTO         0x05      // AEC and AGC enable bits
+
+// MARK: Profiles
+static const SensorReg PREVIEW_REGS[] = {
+    {OV2640_REG_COM2, COM2_STANDBY, 0},
+    {OV2640_REG_COM8, COM8_AUTO, COM8_AUTO},
+    {OV2640_REG_QS, 0xFF, 12},      // The stream doesn't need the classifier's detail
+};
+
+static const SensorReg CLASSIFY_REGS[] = {
+    {OV2640_REG_COM2, COM2_STANDBY, 0},
+    {OV2640_REG_COM8, COM8_AUTO, COM8_AUTO},    // Unless an exposure lock overrides it
+    {OV2640_REG_QS, 0xFF, 10},
+};
+
+// Only standby changes, so resuming into preview is a single write
+static const SensorReg STANDBY_REGS[] = {
+    {OV2640_REG_COM2, COM2_STANDBY, COM2_STANDBY},
+};
+
+typedef struct {
+    const SensorReg* regs;
+    size_t count;
+} ProfileTable;
+
+static const ProfileTable PROFILES[SENSOR_PROFILE_COUNT] = {
+    {PREVIEW_REGS, sizeof(PREVIEW_REGS) / sizeof(PREVIEW_REGS[0])},
+    {CLASSIFY_REGS, sizeof(CLASSIFY_REGS) / sizeof(CLASSIFY_REGS[0])},
+    {STANDBY_REGS, sizeof(STANDBY_REGS) / sizeof(STANDBY_REGS[0])},
+};
+
+static const size_t PROFILE_REGS_MAX = 4;
+
+// MARK: Register Cache
+static uint8_t s_shadow[0x200];
+static uint8_t s_known[0x200 / 8];
+static bool s_ready = false;
+static SensorProfileStats s_stats = {};
+
+static bool isKnown(uint16_t reg) {
+    return s_known[reg >> 3] & (1 << (reg & 7));
+}
+
+static void setKnown(uint16_t reg, uint8_t value) {
+    s_shadow[reg] = value;
+    s_known[reg >> 3] |= 1 << (reg & 7);
+}
+
+// Written by the sensor itself while AEC/AGC run
+static bool isVolatile(uint16_t reg) {
+    return reg == OV2640_REG_GAIN || reg == OV2640_REG_REG04 ||
+           reg == OV2640_REG_AEC || reg == OV2640_REG_REG45;
+}
+
+static sensor_t* knownSensor(void) {
+    sensor_t* sensor = esp_camera_sensor_get();
+    return sensor && sensor->id.PID == OV2640_PID ? sensor : NULL;
+}
+
+// MARK: Batch
+// Fold regs into batch, combining writes to the same register
+static size_t mergeRegs(SensorReg* batch, size_t count, const SensorReg* regs, size_t reg_count) {
+    for (size_t i = 0; i < reg_count; i++) {
+        uint16_t reg = regs[i].reg & 0x1FF;
+        size_t j = 0;
+        while (j < count && batch[j].reg != reg) {
+            j++;
+        }
+        if (j == count) {
+            batch[count++] = {reg, 0, 0};
+        }
+        batch[j].value = (batch[j].value & ~regs[i].mask) | (regs[i].value & regs[i].mask);
+        batch[j].mask |= regs[i].mask;
+    }
+    return count;
+}
+
+// DSP bank first, then the sensor bank, keeping the order within each so
+// AEC/AGC are switched off before exposure values are loaded
+static void sortByBank(SensorReg* batch, size_t count) {
+    for (size_t i = 1; i < count; i++) {
+        SensorReg item = batch[i];
+        size_t j = i;
+        while (j > 0 && (batch[j - 1].reg >> 8) > (item.reg >> 8)) {
+            batch[j] = batch[j - 1];
+            j--;
+        }
+        batch[j] = item;
+    }
+}
+
+static bool writeReg(sensor_t* sensor, const SensorReg* entry) {
+    uint16_t reg = entry->reg;
+    bool cached = !isVolatile(reg) && isKnown(reg);
+    if (cached && ((s_shadow[reg] ^ entry->value) & entry->mask) == 0) {
+        s_stats.skipped++;
+        return true;
+    }
+
+    s_stats.writes++;
+    if (sensor->set_reg(sensor, reg, entry->mask, entry->value) < 0) {
+        s_stats.failures++;
+        s_known[reg >> 3] &= ~(1 << (reg & 7));
+        return false;
+    }
+    if (cached) {
+        setKnown(reg, (s_shadow[reg] & ~entry->mask) | (entry->value & entry->mask));
+    } else if (entry->mask == 0xFF && !isVolatile(reg)) {
+        setKnown(reg, entry->value);
+    }
+    return true;
+}
+
+// MARK: Profile Switch
+bool sensorProfilesBegin(void) {
+    sensor_t* sensor = knownSensor();
+    if (!sensor) {
+        return false;
+    }
+    memset(s_known, 0, sizeof(s_known));
+    for (int p = 0; p < SENSOR_PROFILE_COUNT; p++) {
+        for (size_t i = 0; i < PROFILES[p].count; i++) {
+            uint16_t reg = PROFILES[p].regs[i].reg;
+            if (isVolatile(reg) || isKnown(reg)) {
+                continue;
+            }
+            int value = sensor->get_reg(sensor, reg, 0xFF);
+            if (value < 0) {
+                return false;
+            }
+            setKnown(reg, (uint8_t)value);
+        }
+    }
+    s_ready = true;
+    return sensorProfileApply(SENSOR_PROFILE_PREVIEW, NULL, 0);
+}
+
+bool sensorProfileApply(SensorProfile profile, const SensorReg* extra, size_t extra_count) {
+    sensor_t* sensor = knownSensor();
+    if (!s_ready || !sensor || profile >= SENSOR_PROFILE_COUNT || extra_count > SENSOR_EXTRA_MAX) {
+        return false;
+    }
+    uint32_t start = micros();
+
+    SensorReg batch[PROFILE_REGS_MAX + SENSOR_EXTRA_MAX];
+    size_t count = mergeRegs(batch, 0, PROFILES[profile].regs, PROFILES[profile].count);
+    if (extra) {
+        count = mergeRegs(batch, count, extra, extra_count);
+    }
+    sortByBank(batch, count);
+
+    bool ok = true;
+    for (size_t i = 0; i < count; i++) {
+        ok = writeReg(sensor, &batch[i]) && ok;
+    }
+    s_stats.switches++;
+    s_stats.last_switch_us = micros() - start;
+    return ok;
+}
+
+SensorProfileStats sensorProfileGetStats(void) {
+    return s_stats;
+}
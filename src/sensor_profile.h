@@ -0,0 +1,84 @@
+#ifndef SENSOR_PROFILE_H
+#define SENSOR_PROFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Batched sensor register writes for switching between capture modes
+ *
+ * Every sensor_t setter is a read-modify-write over SCCB. Here each mode
+ * is a table of raw registers; a switch merges the table with any extra
+ * registers, orders the writes by register bank and writes only the
+ * registers whose cached value differs, so going from preview to classify
+ * and back costs a few transactions instead of a dozen setter calls.
+ *
+ * The cache is filled by reading the registers back once at startup and
+ * is then kept up to date by this module's writes, so other code must not
+ * change these registers through sensor_t. Exposure and gain are never
+ * cached, since the sensor writes them itself while AEC/AGC run.
+ *
+ * Only the OV2640 register map is known; on other sensors the switches do
+ * nothing.
+ */
+
+/**
+ * One register write
+ */
+typedef struct {
+    uint16_t reg;       // Bit 8 selects the sensor bank (1) or the DSP bank (0), as in sensor_t's get_reg
+    uint8_t mask;       // Bits of value to write, the rest are kept
+    uint8_t value;
+} SensorReg;
+
+#define SENSOR_EXTRA_MAX 8
+
+typedef enum {
+    SENSOR_PROFILE_PREVIEW = 0,     // Between captures: auto exposure, lighter JPEGs for the stream
+    SENSOR_PROFILE_CLASSIFY,        // Flash capture sent to the vision backend
+    SENSOR_PROFILE_STANDBY,         // Parked between items: no frames, the sensor stops driving the bus
+    SENSOR_PROFILE_COUNT
+} SensorProfile;
+
+/**
+ * Switch counters, for /status
+ */
+typedef struct {
+    uint32_t switches;
+    uint32_t writes;        // Registers written
+    uint32_t skipped;       // Registers already holding the value
+    uint32_t failures;      // Writes the sensor rejected
+    uint32_t last_switch_us;
+} SensorProfileStats;
+
+/**
+ * Read the registers the profiles touch and apply the preview profile
+ * Call once after the camera is initialized
+ * @return false if the sensor is unknown or could not be read
+ */
+bool sensorProfilesBegin(void);
+
+/**
+ * Switch to a profile
+ * @param extra Registers to write on top of the profile (e.g. a loaded exposure), may be NULL;
+ *              they override the profile where both set the same bits
+ * @param extra_count Entries in extra, at most SENSOR_EXTRA_MAX
+ * @return false if a write failed or the sensor is unknown
+ */
+bool sensorProfileApply(SensorProfile profile, const SensorReg* extra, size_t extra_count);
+
+/**
+ * @return Snapshot of the stats
+ */
+SensorProfileStats sensorProfileGetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SENSOR_PROFILE_H */
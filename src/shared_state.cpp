@@ -0,0 +1,108 @@
+#include "shared_state.h"
+#include "platform_port.h"
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+
+// MARK: Pipeline State
+static std::atomic<uint8_t> s_state(PIPELINE_IDLE);
+
+bool pipelineRequestTrigger(void) {
+    uint8_t expected = PIPELINE_IDLE;
+    return s_state.compare_exchange_strong(expected, PIPELINE_TRIGGERED);
+}
+
+bool pipelineBegin(bool gpio_trigger) {
+    uint8_t expected = PIPELINE_TRIGGERED;
+    if (s_state.compare_exchange_strong(expected, PIPELINE_PROCESSING)) {
+        return true;
+    }
+    expected = PIPELINE_IDLE;
+    return gpio_trigger && s_state.compare_exchange_strong(expected, PIPELINE_PROCESSING);
+}
+
+void pipelineEnd(void) {
+    s_state.store(PIPELINE_IDLE);
+}
+
+PipelineState pipelineGetState(void) {
+    return (PipelineState)s_state.load();
+}
+
+// MARK: Status Snapshot
+static std::atomic<uint32_t> s_status_seq(0);
+static StatusSnapshot s_status;
+
+void statusPublish(const StatusSnapshot* status) {
+    // Odd sequence while the copy is in progress
+    s_status_seq.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&s_status, status, sizeof(s_status));
+    std::atomic_thread_fence(std::memory_order_release);
+    s_status_seq.fetch_add(1, std::memory_order_relaxed);
+}
+
+void statusRead(StatusSnapshot* status) {
+    uint32_t before;
+    uint32_t after;
+    do {
+        before = s_status_seq.load(std::memory_order_acquire);
+        memcpy(status, &s_status, sizeof(s_status));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = s_status_seq.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+}
+
+// MARK: Payload Slot
+struct SharedPayload {
+    std::atomic<int> refs;
+    char* data;
+    size_t len;
+};
+
+static std::atomic<SharedPayload*> s_payload(nullptr);
+static std::atomic<int> s_payload_readers(0);
+
+void payloadRelease(SharedPayload* payload) {
+    if (payload && payload->refs.fetch_sub(1) == 1) {
+        free(payload->data);
+        delete payload;
+    }
+}
+
+SharedPayload* payloadAcquire(void) {
+    // The publisher waits for this window to close before dropping its reference
+    s_payload_readers.fetch_add(1);
+    SharedPayload* payload = s_payload.load();
+    if (payload) {
+        payload->refs.fetch_add(1);
+    }
+    s_payload_readers.fetch_sub(1);
+    return payload;
+}
+
+void payloadPublish(char* data, size_t len) {
+    SharedPayload* payload = new (std::nothrow) SharedPayload();
+    if (!payload) {
+        free(data);
+        return;
+    }
+    payload->refs.store(1);
+    payload->data = data;
+    payload->len = len;
+
+    SharedPayload* old = s_payload.exchange(payload);
+    while (s_payload_readers.load() != 0) {
+        delay(1);
+    }
+    payloadRelease(old);
+}
+
+const char* payloadData(const SharedPayload* payload) {
+    return payload->data;
+}
+
+size_t payloadLength(const SharedPayload* payload) {
+    return payload->len;
+}
@@ -0,0 +1,99 @@
+#ifndef SHARED_STATE_H
+#define SHARED_STATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * State shared between the capture loop and the HTTP server task
+ *
+ * The loop is the only writer. Server handlers never block it: they read
+ * status through a sequence-locked snapshot and hold reference-counted
+ * payloads, so a slow client can't stall classification.
+ */
+
+// MARK: Pipeline State
+typedef enum {
+    PIPELINE_IDLE = 0,
+    PIPELINE_TRIGGERED,   // Trigger requested over WiFi, not yet picked up
+    PIPELINE_PROCESSING
+} PipelineState;
+
+/**
+ * Request a capture from another task
+ * @return true if accepted, false if a capture is already pending or running
+ */
+bool pipelineRequestTrigger(void);
+
+/**
+ * Start processing if idle (and gpio_trigger is set) or a trigger is pending
+ * @return true if the caller now owns the pipeline
+ */
+bool pipelineBegin(bool gpio_trigger);
+
+/**
+ * Return the pipeline to idle after pipelineBegin
+ */
+void pipelineEnd(void);
+
+/**
+ * @return Current pipeline state
+ */
+PipelineState pipelineGetState(void);
+
+// MARK: Status Snapshot
+typedef struct {
+    uint32_t captures;          // Captures since boot
+    uint32_t failures;          // Capture or request failures since boot
+    int last_result;            // Last waste type
+    uint32_t last_latency_ms;   // Trigger to result of the last capture
+    uint32_t last_result_at;    // millis() when the last result was signalled
+    uint32_t degraded;          // Results guessed locally because the quota was exhausted
+    uint32_t local_results;     // Empty-chute results decided on-device without a request
+    uint16_t last_sharpness;    // thumbnailSharpness of the last capture
+} StatusSnapshot;
+
+/**
+ * Publish a new status (capture loop only)
+ */
+void statusPublish(const StatusSnapshot* status);
+
+/**
+ * Copy a consistent status snapshot without blocking the writer
+ */
+void statusRead(StatusSnapshot* status);
+
+// MARK: Payload Slot
+typedef struct SharedPayload SharedPayload;
+
+/**
+ * Publish the latest JSON payload, taking ownership of the malloc'd buffer
+ * @param data Payload from encodeFrameAsGeminiJson (freed once no reader holds it)
+ * @param len Payload length
+ */
+void payloadPublish(char* data, size_t len);
+
+/**
+ * Take a reference to the latest payload
+ * @return Payload or NULL if none yet (release with payloadRelease())
+ */
+SharedPayload* payloadAcquire(void);
+
+/**
+ * Drop a reference taken with payloadAcquire
+ */
+void payloadRelease(SharedPayload* payload);
+
+const char* payloadData(const SharedPayload* payload);
+size_t payloadLength(const SharedPayload* payload);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SHARED_STATE_H */
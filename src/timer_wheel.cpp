@@ -0,0 +1,130 @@
+#include "timer_wheel.h"
+#include "platform_port.h"
+#include <stddef.h>
+
+// MARK: Wheel Config
+static const uint32_t TICK_MS = 10;
+#define WHEEL_SLOTS 64      // Power of two; later deadlines sit out whole turns
+
+static WheelTask* s_slots[WHEEL_SLOTS];
+static uint32_t s_tick = 0;         // Tick last expired, revisited on the next run
+static PortSem s_wake = NULL;
+
+static uint32_t slotOf(uint32_t due_ms) {
+    return (due_ms / TICK_MS) & (WHEEL_SLOTS - 1);
+}
+
+static void unlink(WheelTask* task) {
+    WheelTask** link = &s_slots[slotOf(task->due_ms)];
+    while (*link && *link != task) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = task->next;
+    }
+    task->next = NULL;
+    task->armed = false;
+}
+
+static void insert(WheelTask* task, uint32_t due_ms) {
+    task->due_ms = due_ms;
+    WheelTask** slot = &s_slots[slotOf(due_ms)];
+    task->next = *slot;
+    *slot = task;
+    task->armed = true;
+}
+
+// MARK: Tasks
+bool wheelBegin(void) {
+    if (!s_wake) {
+        s_wake = portSemCreate(0);
+    }
+    s_tick = millis() / TICK_MS;
+    return s_wake != NULL;
+}
+
+void wheelStart(WheelTask* task, uint32_t delay_ms) {
+    if (task->armed) {
+        unlink(task);
+    }
+    // At least a millisecond out, so a task restarting itself can't keep a run going
+    insert(task, millis() + (delay_ms ? delay_ms : 1));
+}
+
+void wheelStop(WheelTask* task) {
+    if (task->armed) {
+        unlink(task);
+    }
+}
+
+static WheelTask* firstDue(uint32_t slot, uint32_t now) {
+    for (WheelTask* task = s_slots[slot]; task; task = task->next) {
+        if ((int32_t)(now - task->due_ms) >= 0) {
+            return task;
+        }
+    }
+    return NULL;
+}
+
+uint32_t wheelRunDue(void) {
+    uint32_t now = millis();
+    uint32_t now_tick = now / TICK_MS;
+
+    // Every slot passed since the last run, or the whole wheel after a long stall
+    uint32_t ticks = now_tick - s_tick + 1;
+    if (ticks > WHEEL_SLOTS) {
+        ticks = WHEEL_SLOTS;
+    }
+    for (uint32_t i = 0; i < ticks; i++) {
+        uint32_t slot = (now_tick - i) & (WHEEL_SLOTS - 1);
+        // One at a time: a task may start or stop others, including ones in this slot
+        WheelTask* task;
+        while ((task = firstDue(slot, now)) != NULL) {
+            unlink(task);
+            if (task->period_ms) {
+                insert(task, now + task->period_ms);
+            }
+            task->fn(task->arg);
+        }
+    }
+    s_tick = now_tick;
+
+    // Tasks are few; the nearest deadline is a scan of every slot
+    uint32_t after = millis();
+    uint32_t next = WHEEL_NO_DEADLINE;
+    for (uint32_t slot = 0; slot < WHEEL_SLOTS; slot++) {
+        for (WheelTask* task = s_slots[slot]; task; task = task->next) {
+            int32_t remaining = (int32_t)(task->due_ms - after);
+            uint32_t wait = remaining > 0 ? (uint32_t)remaining : 0;
+            if (wait < next) {
+                next = wait;
+            }
+        }
+    }
+    return next;
+}
+
+// MARK: Sleep
+bool wheelWait(uint32_t timeout_ms) {
+    if (!s_wake) {
+        delay(timeout_ms == WHEEL_NO_DEADLINE ? TICK_MS : timeout_ms);
+        return false;
+    }
+    if (timeout_ms == WHEEL_NO_DEADLINE) {
+        portSemTake(s_wake);
+        return true;
+    }
+    return timeout_ms > 0 && portSemTakeTimeout(s_wake, timeout_ms);
+}
+
+void wheelWake(void) {
+    if (s_wake) {
+        portSemGive(s_wake);
+    }
+}
+
+void PORT_ISR_ATTR wheelWakeFromIsr(void) {
+    if (s_wake) {
+        portSemGiveFromIsr(s_wake);
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Deadline tasks for the capture loop
+ *
+ * Background work that used to run on every pass of a loop paced by
+ * delay() is scheduled here instead, and the loop sleeps until the next
+ * deadline or until something wakes it (the trigger interrupt, a trigger
+ * request from the web server). Tasks hash into a wheel of fixed-length
+ * ticks by deadline, so scheduling and expiry don't depend on how many
+ * tasks exist.
+ *
+ * Tasks run on the task calling wheelRunDue(), one at a time; start and
+ * stop them from that task only. wheelWake() is safe from any task.
+ */
+
+/**
+ * A deadline; storage belongs to the caller and must outlive it
+ */
+typedef struct WheelTask {
+    void (*fn)(void* arg);
+    void* arg;
+    uint32_t period_ms;         // Restarted this long after each run, 0 to run once
+
+    // Owned by the wheel
+    uint32_t due_ms;
+    struct WheelTask* next;
+    bool armed;
+} WheelTask;
+
+#define WHEEL_NO_DEADLINE UINT32_MAX
+
+/**
+ * Create the wake event; call once before anything can wake the wheel
+ * @return false if out of memory
+ */
+bool wheelBegin(void);
+
+/**
+ * Arm a task, moving it if it is already armed
+ * @param delay_ms From now
+ */
+void wheelStart(WheelTask* task, uint32_t delay_ms);
+
+/**
+ * Disarm a task; harmless if it isn't armed
+ */
+void wheelStop(WheelTask* task);
+
+/**
+ * Run every task whose deadline has passed
+ * @return Milliseconds until the next deadline, WHEEL_NO_DEADLINE if nothing is armed
+ */
+uint32_t wheelRunDue(void);
+
+/**
+ * Sleep until woken or timeout_ms passes
+ * @return true if woken
+ */
+bool wheelWait(uint32_t timeout_ms);
+
+/**
+ * End the current or next wheelWait() early
+ */
+void wheelWake(void);
+
+/**
+ * wheelWake for interrupt handlers
+ */
+void wheelWakeFromIsr(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TIMER_WHEEL_H */
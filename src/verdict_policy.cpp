@@ -0,0 +1,63 @@
+#include "verdict_policy.h"
+
+// MARK: Policy Config
+static const float CONFIDENT = 0.80f;          // Answer probability taken without a second look
+
+static VerdictPolicyStats s_stats = {0, 0, 0, 0, 0, -1};
+
+static bool isSure(const WasteVerdict* verdict) {
+    if (verdict->waste_type == TYPE_ERROR) {
+        return false;
+    }
+    if (verdict->finish != VISION_FINISH_STOP && verdict->finish != VISION_FINISH_UNKNOWN) {
+        return false;
+    }
+    return verdict->confidence < 0 || verdict->confidence >= CONFIDENT;
+}
+
+// MARK: Decisions
+VerdictAction verdictPolicyDecide(const WasteVerdict* verdict, bool downscaled, uint32_t remaining_ms, uint32_t retry_ms) {
+    if (isSure(verdict)) {
+        s_stats.accepted++;
+        return VERDICT_ACCEPT;
+    }
+    if (retry_ms >= remaining_ms) {
+        s_stats.unsure_kept++;
+        return VERDICT_ACCEPT;
+    }
+    if (downscaled) {
+        s_stats.requeried++;
+        return VERDICT_REQUERY_FULL;
+    }
+    s_stats.recaptured++;
+    return VERDICT_RECAPTURE;
+}
+
+static bool finishedCleanly(const WasteVerdict* verdict) {
+    return verdict->finish != VISION_FINISH_MAX_TOKENS && verdict->finish != VISION_FINISH_OTHER;
+}
+
+bool verdictPolicyPreferSecond(const WasteVerdict* first, const WasteVerdict* second) {
+    if (second->waste_type == TYPE_ERROR) {
+        return false;
+    }
+    if (first->waste_type == TYPE_ERROR) {
+        return true;
+    }
+    // A clean finish beats one cut short or blocked, then the likelier answer wins; on a
+    // tie, the second saw the better frame. Unknown confidence ranks below any reported one.
+    bool prefer = finishedCleanly(second) != finishedCleanly(first) ? finishedCleanly(second)
+                                                                    : second->confidence >= first->confidence;
+    if (prefer && second->waste_type != first->waste_type) {
+        s_stats.overturned++;
+    }
+    return prefer;
+}
+
+void verdictPolicyRecord(const WasteVerdict* verdict) {
+    s_stats.last_confidence_pct = verdict->confidence < 0 ? -1 : (int16_t)(verdict->confidence * 100 + 0.5f);
+}
+
+VerdictPolicyStats verdictPolicyGetStats(void) {
+    return s_stats;
+}
@@ -0,0 +1,72 @@
+#ifndef VERDICT_POLICY_H
+#define VERDICT_POLICY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "waste_classifier.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Second opinions on unsure verdicts
+ *
+ * Most answers come back with a probability near 1 and are taken as they
+ * are. When the backend is unsure (a low answer probability, an answer
+ * cut short or blocked, or no label at all), one more attempt is made if
+ * the frame stays fresh long enough: the full frame if the first request
+ * went downscaled for a slow link, otherwise a new capture, since the
+ * item may have been moving or half in view. The more confident of the
+ * two answers wins. Answers without a probability are trusted, so
+ * backends that don't report one never cost a second request.
+ */
+
+typedef enum {
+    VERDICT_ACCEPT = 0,
+    VERDICT_REQUERY_FULL,       // Same frame again at full resolution
+    VERDICT_RECAPTURE           // New frame, same request
+} VerdictAction;
+
+/**
+ * Decision counters, for /status
+ */
+typedef struct {
+    uint32_t accepted;          // Sure on the first answer
+    uint32_t requeried;
+    uint32_t recaptured;
+    uint32_t overturned;        // Second answer replaced the first with another label
+    uint32_t unsure_kept;       // Unsure, but no time left to ask again
+    int16_t last_confidence_pct;// Of the verdict used, -1 if unknown
+} VerdictPolicyStats;
+
+/**
+ * Decide what to do with a first answer
+ * @param verdict First answer
+ * @param downscaled The request carried a downscaled frame
+ * @param remaining_ms Time until the frame is stale
+ * @param retry_ms Expected time for the second attempt
+ */
+VerdictAction verdictPolicyDecide(const WasteVerdict* verdict, bool downscaled, uint32_t remaining_ms, uint32_t retry_ms);
+
+/**
+ * Choose between the first answer and the second attempt's
+ * @return true if the second should be used
+ */
+bool verdictPolicyPreferSecond(const WasteVerdict* first, const WasteVerdict* second);
+
+/**
+ * Note the verdict finally used, for the stats
+ */
+void verdictPolicyRecord(const WasteVerdict* verdict);
+
+/**
+ * @return Snapshot of the stats
+ */
+VerdictPolicyStats verdictPolicyGetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VERDICT_POLICY_H */
@@ -0,0 +1,623 @@
+#include "vision_backend.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// MARK: Base64 Encoding
+static const char base64_table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// MARK: Gemini API Config
+#ifndef GEMINI_MODEL
+#define GEMINI_MODEL "gemini-2.0-flash-lite"
+#endif
+
+static const char* GEMINI_HOST = "generativelanguage.googleapis.com";
+static const int GEMINI_PORT = 443;
+
+// JSON format template parts
+static const char* GEMINI_JSON_PREFIX = "{\n"
+    "  \"contents\":[\n"
+    "    {\n"
+    "      \"parts\":[\n"
+    "        {\"text\":\"";
+
+static const char* GEMINI_PROMPT_SUFFIX = "\"},\n"
+    "        {\"inline_data\":{\n"
+    "          \"mime_type\":\"image/jpeg\",\n"
+    "          \"data\":\"";
+
+static const char* GEMINI_JSON_SUFFIX = "\"\n"
+    "        }}\n"
+    "      ]\n"
+    "    }\n"
+    "  ],\n"
+    "  \"generationConfig\":{\n"
+    "    \"maxOutputTokens\":5,\n"
+    "    \"temperature\":1";
+
+// Log-probabilities of the answer tokens and their best alternative
+static const char* GEMINI_LOGPROBS = ",\n"
+    "    \"responseLogprobs\":true,\n"
+    "    \"logprobs\":2";
+
+// Constrains the answer to an enum that follows it
+static const char* GEMINI_ENUM_SUFFIX = ",\n"
+    "    \"responseMimeType\":\"text/x.enum\",\n"
+    "    \"responseSchema\":{\"type\":\"STRING\",\"enum\":";
+
+static const char* GEMINI_ENUM_CLOSE = "}";
+
+static const char* GEMINI_CONFIG_CLOSE = "\n"
+    "  }\n"
+    "}";
+
+// Context templates: the cache or the inline system instruction and
+// few-shot turns stand in for the prompt. Example and image openers start
+// with ",\n", skipped when nothing precedes them.
+static const char* GEMINI_CACHED_PREFIX = "{\n"
+    "  \"cachedContent\":\"";
+
+static const char* GEMINI_CONTEXT_PREFIX = "{\n"
+    "  \"system_instruction\":{\"parts\":[{\"text\":\"";
+
+static const char* GEMINI_CONTEXT_CONTENTS = "\"}]},\n"
+    "  \"contents\":[\n";
+
+static const char* GEMINI_CACHED_CONTENTS = "\",\n"
+    "  \"contents\":[\n";
+
+static const char* GEMINI_EXAMPLE_OPEN = ",\n"
+    "    {\"role\":\"user\",\"parts\":[{\"inline_data\":{\"mime_type\":\"image/jpeg\",\"data\":\"";
+
+static const char* GEMINI_EXAMPLE_LABEL = "\"}}]},\n"
+    "    {\"role\":\"model\",\"parts\":[{\"text\":\"";
+
+static const char* GEMINI_EXAMPLE_CLOSE = "\"}]}";
+
+static const char* GEMINI_IMAGE_OPEN = ",\n"
+    "    {\n"
+    "      \"role\":\"user\",\n"
+    "      \"parts\":[\n"
+    "        {\"inline_data\":{\n"
+    "          \"mime_type\":\"image/jpeg\",\n"
+    "          \"data\":\"";
+
+static const char* GEMINI_CACHE_MODEL_PREFIX = "{\n"
+    "  \"model\":\"models/";
+
+static const char* GEMINI_CACHE_INSTRUCTION = "\",\n"
+    "  \"system_instruction\":{\"parts\":[{\"text\":\"";
+
+static const char* GEMINI_CACHE_TTL = "\n"
+    "  ],\n"
+    "  \"ttl\":\"";
+
+static const char* GEMINI_CACHE_SUFFIX = "\"\n"
+    "}";
+
+// MARK: Segment Helpers
+static size_t segmentLength(const VisionSegment* seg) {
+    switch (seg->type) {
+        case VISION_SEG_ESCAPED: {
+            size_t len = seg->len;
+            for (size_t i = 0; i < seg->len; i++) {
+                if (seg->data[i] == '"' || seg->data[i] == '\\') {
+                    len++;
+                }
+            }
+            return len;
+        }
+        case VISION_SEG_BASE64:
+            return (seg->len + 2) / 3 * 4;
+        default:
+            return seg->len;
+    }
+}
+
+static bool addSegment(VisionEncoder* encoder, VisionSegmentType type, const void* data, size_t len) {
+    if (encoder->segment_count >= VISION_ENCODER_MAX_SEGMENTS) {
+        return false;
+    }
+    VisionSegment* seg = &encoder->segments[encoder->segment_count++];
+    seg->type = type;
+    seg->data = (const uint8_t*)data;
+    seg->len = len;
+    encoder->total_length += segmentLength(seg);
+    return true;
+}
+
+static inline void encodeQuad(const uint8_t* in, size_t n, char* out) {
+    uint32_t a = in[0];
+    uint32_t b = n > 1 ? in[1] : 0;
+    uint32_t c = n > 2 ? in[2] : 0;
+    uint32_t triple = (a << 16) | (b << 8) | c;
+
+    out[0] = base64_table[(triple >> 18) & 0x3F];
+    out[1] = base64_table[(triple >> 12) & 0x3F];
+    out[2] = n > 1 ? base64_table[(triple >> 6) & 0x3F] : '=';
+    out[3] = n > 2 ? base64_table[triple & 0x3F] : '=';
+}
+
+static bool addLiteral(VisionEncoder* encoder, const char* text) {
+    return addSegment(encoder, VISION_SEG_LITERAL, text, strlen(text));
+}
+
+static bool addEscaped(VisionEncoder* encoder, const char* text) {
+    return addSegment(encoder, VISION_SEG_ESCAPED, text, strlen(text));
+}
+
+/**
+ * Add an opener that starts with ",\n", dropping the separator for the first item
+ */
+static bool addOpener(VisionEncoder* encoder, const char* text, bool first) {
+    return addLiteral(encoder, first ? text + 2 : text);
+}
+
+/**
+ * Close the image part and add the generation config, with log-probabilities and the response enum if asked
+ */
+static bool addSuffix(VisionEncoder* encoder, const VisionRequest* request) {
+    if (!addLiteral(encoder, GEMINI_JSON_SUFFIX)) {
+        return false;
+    }
+    if (request->logprobs && !addLiteral(encoder, GEMINI_LOGPROBS)) {
+        return false;
+    }
+    if (request->response_enum &&
+        !(addLiteral(encoder, GEMINI_ENUM_SUFFIX) &&
+          addLiteral(encoder, request->response_enum) &&
+          addLiteral(encoder, GEMINI_ENUM_CLOSE))) {
+        return false;
+    }
+    return addLiteral(encoder, GEMINI_CONFIG_CLOSE);
+}
+
+// MARK: JSON Helpers
+/**
+ * Find the first "key" in body and skip to its value
+ * @return Start of the value, NULL if the key is missing
+ */
+static const char* jsonFieldValue(const char* body, const char* key) {
+    char quoted[32];
+    int quoted_len = snprintf(quoted, sizeof(quoted), "\"%s\"", key);
+    if (quoted_len < 0 || (size_t)quoted_len >= sizeof(quoted)) {
+        return NULL;
+    }
+
+    const char* p = strstr(body, quoted);
+    if (!p) {
+        return NULL;
+    }
+    p += quoted_len;
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+    if (*p++ != ':') {
+        return NULL;
+    }
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+    return p;
+}
+
+/**
+ * Find the first string value of "key" in body
+ * @return true if found, value points into body (not NUL terminated)
+ */
+static bool jsonStringField(const char* body, const char* key, const char** value, size_t* value_len) {
+    const char* p = jsonFieldValue(body, key);
+    if (!p || *p++ != '"') {
+        return false;
+    }
+
+    const char* start = p;
+    while (*p && *p != '"') {
+        if (*p == '\\' && p[1]) p++;
+        p++;
+    }
+    if (*p != '"') {
+        return false;
+    }
+
+    *value = start;
+    *value_len = p - start;
+    return true;
+}
+
+/**
+ * Find the first numeric value of "key" in body
+ * @return true if found
+ */
+static bool jsonNumberField(const char* body, const char* key, double* value) {
+    const char* p = jsonFieldValue(body, key);
+    if (!p) {
+        return false;
+    }
+    char* end;
+    double parsed = strtod(p, &end);
+    if (end == p) {
+        return false;
+    }
+    *value = parsed;
+    return true;
+}
+
+/**
+ * @param p An opening '[' or '{'
+ * @return The bracket closing it, NULL if the body ends first
+ */
+static const char* jsonBlockEnd(const char* p) {
+    int depth = 0;
+    bool in_string = false;
+    for (; *p; p++) {
+        if (in_string) {
+            if (*p == '\\' && p[1]) {
+                p++;
+            } else if (*p == '"') {
+                in_string = false;
+            }
+        } else if (*p == '"') {
+            in_string = true;
+        } else if (*p == '[' || *p == '{') {
+            depth++;
+        } else if ((*p == ']' || *p == '}') && --depth == 0) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+// MARK: Gemini Ops
+static size_t geminiBuildPath(const VisionBackend* backend, const char* api_key, char* out, size_t out_size) {
+    int len = snprintf(out, out_size,
+                       "/v1beta/models/%s:generateContent?key=%s",
+                       backend->model, api_key);
+    if (len < 0 || (size_t)len >= out_size) {
+        return 0;
+    }
+    return (size_t)len;
+}
+
+static bool addExamples(VisionEncoder* encoder, const VisionContext* context) {
+    for (uint8_t i = 0; i < context->example_count; i++) {
+        const VisionExample* example = &context->examples[i];
+        if (!addOpener(encoder, GEMINI_EXAMPLE_OPEN, i == 0) ||
+            !addSegment(encoder, VISION_SEG_BASE64, example->image, example->image_len) ||
+            !addLiteral(encoder, GEMINI_EXAMPLE_LABEL) ||
+            !addEscaped(encoder, example->label) ||
+            !addLiteral(encoder, GEMINI_EXAMPLE_CLOSE)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool geminiInitEncoder(const VisionBackend* backend, const VisionRequest* request, VisionEncoder* encoder) {
+    (void)backend;
+    const VisionContext* context = request->context;
+    if (context && context->cache_name) {
+        // Instructions and examples are already on the server, send just the image
+        return addLiteral(encoder, GEMINI_CACHED_PREFIX) &&
+               addEscaped(encoder, context->cache_name) &&
+               addLiteral(encoder, GEMINI_CACHED_CONTENTS) &&
+               addOpener(encoder, GEMINI_IMAGE_OPEN, true) &&
+               addSegment(encoder, VISION_SEG_BASE64, request->image, request->image_len) &&
+               addSuffix(encoder, request);
+    }
+    if (context) {
+        return addLiteral(encoder, GEMINI_CONTEXT_PREFIX) &&
+               addEscaped(encoder, context->instructions) &&
+               addLiteral(encoder, GEMINI_CONTEXT_CONTENTS) &&
+               addExamples(encoder, context) &&
+               addOpener(encoder, GEMINI_IMAGE_OPEN, context->example_count == 0) &&
+               addSegment(encoder, VISION_SEG_BASE64, request->image, request->image_len) &&
+               addSuffix(encoder, request);
+    }
+    return addSegment(encoder, VISION_SEG_LITERAL, GEMINI_JSON_PREFIX, strlen(GEMINI_JSON_PREFIX)) &&
+           addSegment(encoder, VISION_SEG_ESCAPED, request->prompt, strlen(request->prompt)) &&
+           addSegment(encoder, VISION_SEG_LITERAL, GEMINI_PROMPT_SUFFIX, strlen(GEMINI_PROMPT_SUFFIX)) &&
+           addSegment(encoder, VISION_SEG_BASE64, request->image, request->image_len) &&
+           addSuffix(encoder, request);
+}
+
+static bool geminiExtractText(const char* body, const char** text, size_t* text_len) {
+    // First "text" field of the first candidate
+    return jsonStringField(body, "text", text, text_len);
+}
+
+static VisionFinishReason geminiFinishReason(const char* body) {
+    const char* value;
+    size_t len;
+    if (!jsonStringField(body, "finishReason", &value, &len)) {
+        return VISION_FINISH_UNKNOWN;
+    }
+    if (len == 4 && strncmp(value, "STOP", len) == 0) {
+        return VISION_FINISH_STOP;
+    }
+    if (len == 10 && strncmp(value, "MAX_TOKENS", len) == 0) {
+        return VISION_FINISH_MAX_TOKENS;
+    }
+    return VISION_FINISH_OTHER;
+}
+
+static bool geminiAnswerLogprob(const char* body, float* logprob) {
+    // With responseLogprobs, the chosen tokens' log-probabilities add up to the answer's
+    const char* chosen = jsonFieldValue(body, "chosenCandidates");
+    const char* end = chosen && *chosen == '[' ? jsonBlockEnd(chosen) : NULL;
+    if (end) {
+        double sum = 0;
+        int tokens = 0;
+        const char* p = chosen;
+        while ((p = strstr(p, "\"logProbability\"")) != NULL && p < end) {
+            double value;
+            if (!jsonNumberField(p, "logProbability", &value)) {
+                break;
+            }
+            sum += value;
+            tokens++;
+            p++;
+        }
+        if (tokens > 0) {
+            *logprob = (float)sum;
+            return true;
+        }
+    }
+    // Otherwise the per-token average; answers are a token or two, so close enough
+    double avg;
+    if (jsonNumberField(body, "avgLogprobs", &avg)) {
+        *logprob = (float)avg;
+        return true;
+    }
+    return false;
+}
+
+static bool geminiExtractAnswerInfo(const char* body, VisionAnswerInfo* info) {
+    // {"candidates":[{"content":...,"finishReason":"STOP","avgLogprobs":-0.01,"logprobsResult":{...}}]}
+    info->finish = geminiFinishReason(body);
+    info->has_logprob = geminiAnswerLogprob(body, &info->logprob);
+    return info->finish != VISION_FINISH_UNKNOWN || info->has_logprob;
+}
+
+static size_t geminiBuildCachePath(const VisionBackend* backend, const char* api_key, char* out, size_t out_size) {
+    (void)backend;
+    int len = snprintf(out, out_size, "/v1beta/cachedContents?key=%s", api_key);
+    if (len < 0 || (size_t)len >= out_size) {
+        return 0;
+    }
+    return (size_t)len;
+}
+
+static bool geminiInitCacheEncoder(const VisionBackend* backend, const VisionContext* context, const char* ttl, VisionEncoder* encoder) {
+    return addLiteral(encoder, GEMINI_CACHE_MODEL_PREFIX) &&
+           addEscaped(encoder, backend->model) &&
+           addLiteral(encoder, GEMINI_CACHE_INSTRUCTION) &&
+           addEscaped(encoder, context->instructions) &&
+           addLiteral(encoder, GEMINI_CONTEXT_CONTENTS) &&
+           addExamples(encoder, context) &&
+           addLiteral(encoder, GEMINI_CACHE_TTL) &&
+           addLiteral(encoder, ttl) &&
+           addLiteral(encoder, GEMINI_CACHE_SUFFIX);
+}
+
+static bool geminiExtractCacheName(const char* body, const char** name, size_t* name_len) {
+    // {"name": "cachedContents/...", "model": ..., "expireTime": ...}
+    return jsonStringField(body, "name", name, name_len);
+}
+
+static const VisionBackendOps GEMINI_OPS = {
+    geminiBuildPath,
+    geminiInitEncoder,
+    geminiExtractText,
+    geminiExtractAnswerInfo,
+    geminiBuildCachePath,
+    geminiInitCacheEncoder,
+    geminiExtractCacheName,
+    "application/json"
+};
+
+// MARK: Controller Ops
+static size_t controllerBuildPath(const VisionBackend* backend, const char* api_key, char* out, size_t out_size) {
+    (void)api_key;  // The controller holds the backend key
+    int len = snprintf(out, out_size, "/frame?source=%s", backend->model);
+    if (len < 0 || (size_t)len >= out_size) {
+        return 0;
+    }
+    return (size_t)len;
+}
+
+static bool controllerInitEncoder(const VisionBackend* backend, const VisionRequest* request, VisionEncoder* encoder) {
+    (void)backend;
+    return addSegment(encoder, VISION_SEG_LITERAL, request->image, request->image_len);
+}
+
+static bool controllerExtractText(const char* body, const char** text, size_t* text_len) {
+    // The whole body is the label
+    *text = body;
+    *text_len = strlen(body);
+    return *text_len > 0;
+}
+
+static const VisionBackendOps CONTROLLER_OPS = {
+    controllerBuildPath,
+    controllerInitEncoder,
+    controllerExtractText,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    "image/jpeg"
+};
+
+// MARK: Backends
+VisionBackend visionGeminiBackend(const char* model) {
+    VisionBackend backend;
+    backend.name = "gemini";
+    backend.host = GEMINI_HOST;
+    backend.port = GEMINI_PORT;
+    backend.use_tls = true;
+    backend.model = model ? model : GEMINI_MODEL;
+    backend.ops = &GEMINI_OPS;
+    return backend;
+}
+
+VisionBackend visionMockBackend(const char* host, uint16_t port, bool use_tls) {
+    VisionBackend backend = visionGeminiBackend(GEMINI_MODEL);
+    backend.name = "mock";
+    backend.host = host;
+    backend.port = port;
+    backend.use_tls = use_tls;
+    return backend;
+}
+
+VisionBackend visionControllerBackend(const char* host, uint16_t port, const char* source) {
+    VisionBackend backend;
+    backend.name = "controller";
+    backend.host = host;
+    backend.port = port;
+    backend.use_tls = false;
+    backend.model = source;     // Goes in the path where a model name would
+    backend.ops = &CONTROLLER_OPS;
+    return backend;
+}
+
+static const VisionBackend DEFAULT_BACKEND = visionGeminiBackend(GEMINI_MODEL);
+static const VisionBackend* s_backend = &DEFAULT_BACKEND;
+
+void visionSetBackend(const VisionBackend* backend) {
+    s_backend = backend ? backend : &DEFAULT_BACKEND;
+}
+
+const VisionBackend* visionGetBackend(void) {
+    return s_backend;
+}
+
+// MARK: Encoder
+bool visionEncoderInit(VisionEncoder* encoder, const VisionBackend* backend, const VisionRequest* request) {
+    if (!encoder || !backend || !request || (!request->prompt && !request->context) ||
+        !request->image || request->image_len == 0) {
+        return false;
+    }
+    if (request->context && (!request->context->instructions || request->context->example_count > VISION_MAX_EXAMPLES)) {
+        return false;
+    }
+
+    memset(encoder, 0, sizeof(*encoder));
+    return backend->ops->initEncoder(backend, request, encoder);
+}
+
+bool visionCacheEncoderInit(VisionEncoder* encoder, const VisionBackend* backend, const VisionContext* context, const char* ttl) {
+    if (!encoder || !backend || !context || !context->instructions || !ttl ||
+        context->example_count > VISION_MAX_EXAMPLES || !backend->ops->initCacheEncoder) {
+        return false;
+    }
+
+    memset(encoder, 0, sizeof(*encoder));
+    return backend->ops->initCacheEncoder(backend, context, ttl, encoder);
+}
+
+void visionEncoderInitRaw(VisionEncoder* encoder, const char* data, size_t len) {
+    memset(encoder, 0, sizeof(*encoder));
+    addSegment(encoder, VISION_SEG_LITERAL, data, len);
+}
+
+size_t visionEncoderLength(const VisionEncoder* encoder) {
+    return encoder->total_length;
+}
+
+void visionEncoderRewind(VisionEncoder* encoder) {
+    encoder->segment = 0;
+    encoder->offset = 0;
+    encoder->pending_len = 0;
+    encoder->pending_pos = 0;
+}
+
+size_t visionEncoderRead(VisionEncoder* encoder, char* out, size_t out_size) {
+    size_t written = 0;
+
+    while (written < out_size) {
+        // Drain characters left over from a split escape or base64 quad
+        if (encoder->pending_pos < encoder->pending_len) {
+            out[written++] = encoder->pending[encoder->pending_pos++];
+            continue;
+        }
+
+        if (encoder->segment >= encoder->segment_count) {
+            break;
+        }
+
+        const VisionSegment* seg = &encoder->segments[encoder->segment];
+        if (encoder->offset >= seg->len) {
+            encoder->segment++;
+            encoder->offset = 0;
+            continue;
+        }
+
+        size_t room = out_size - written;
+        size_t left = seg->len - encoder->offset;
+
+        switch (seg->type) {
+            case VISION_SEG_LITERAL: {
+                size_t n = left < room ? left : room;
+                memcpy(out + written, seg->data + encoder->offset, n);
+                written += n;
+                encoder->offset += n;
+                break;
+            }
+            case VISION_SEG_ESCAPED: {
+                char c = (char)seg->data[encoder->offset++];
+                if (c == '"' || c == '\\') {
+                    encoder->pending[0] = '\\';
+                    encoder->pending[1] = c;
+                    encoder->pending_len = 2;
+                    encoder->pending_pos = 0;
+                } else {
+                    out[written++] = c;
+                }
+                break;
+            }
+            case VISION_SEG_BASE64: {
+                // Whole quads straight into the output
+                const uint8_t* in = seg->data + encoder->offset;
+                size_t quads = left / 3;
+                if (quads > room / 4) {
+                    quads = room / 4;
+                }
+                for (size_t q = 0; q < quads; q++) {
+                    encodeQuad(in, 3, out + written);
+                    in += 3;
+                    written += 4;
+                }
+                encoder->offset += quads * 3;
+
+                // Tail or a quad that does not fit goes through the pending buffer
+                left = seg->len - encoder->offset;
+                if (left > 0 && (left < 3 || out_size - written < 4)) {
+                    size_t n = left < 3 ? left : 3;
+                    encodeQuad(seg->data + encoder->offset, n, encoder->pending);
+                    encoder->offset += n;
+                    encoder->pending_len = 4;
+                    encoder->pending_pos = 0;
+                }
+                break;
+            }
+        }
+    }
+
+    return written;
+}
+
+// MARK: Response Parsing
+bool visionExtractText(const char* body, const char** text, size_t* text_len) {
+    if (!body || !text || !text_len) {
+        return false;
+    }
+    return s_backend->ops->extractText(body, text, text_len);
+}
+
+bool visionExtractAnswerInfo(const char* body, VisionAnswerInfo* info) {
+    if (!info) {
+        return false;
+    }
+    memset(info, 0, sizeof(*info));
+    if (!body || !s_backend->ops->extractAnswerInfo) {
+        return false;
+    }
+    return s_backend->ops->extractAnswerInfo(body, info);
+}
@@ -0,0 +1,237 @@
+#ifndef VISION_BACKEND_H
+#define VISION_BACKEND_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VISION_MAX_EXAMPLES 6
+
+/**
+ * A labelled example image shown to the model ahead of the real request
+ */
+typedef struct {
+    const char* label;
+    const uint8_t* image;
+    size_t image_len;
+} VisionExample;
+
+/**
+ * Standing context shared by every request: instructions and few-shot examples
+ *
+ * With cache_name set the backend already holds the context (a Gemini
+ * cachedContent) and requests only reference it by name; otherwise the
+ * context is sent inline with each request.
+ */
+typedef struct {
+    const char* instructions;
+    const VisionExample* examples;
+    uint8_t example_count;
+    const char* cache_name;     // e.g. "cachedContents/abc123", NULL to send inline
+} VisionContext;
+
+/**
+ * One classification request: a text prompt and a JPEG image
+ *
+ * With a context, its instructions take the place of the prompt. With a
+ * response enum, the model is constrained to answer with one of its values.
+ */
+typedef struct {
+    const char* prompt;
+    const uint8_t* image;
+    size_t image_len;
+    const VisionContext* context;   // Optional
+    const char* response_enum;      // Optional JSON array of the only answers allowed, e.g. ["yes","no"]
+    bool logprobs;                  // Ask for the answer's token log-probabilities (not every model accepts it)
+} VisionRequest;
+
+/**
+ * Why the model stopped answering
+ */
+typedef enum {
+    VISION_FINISH_UNKNOWN = 0,      // Not reported
+    VISION_FINISH_STOP,             // Finished normally
+    VISION_FINISH_MAX_TOKENS,       // Cut short by the token limit
+    VISION_FINISH_OTHER             // Blocked (safety, recitation...) or failed
+} VisionFinishReason;
+
+/**
+ * What a response says about its own answer, beyond the text
+ */
+typedef struct {
+    VisionFinishReason finish;
+    bool has_logprob;
+    float logprob;                  // Natural log of the answer's probability
+} VisionAnswerInfo;
+
+/**
+ * Streaming request body encoder
+ *
+ * The body is described as a list of segments (literal text, JSON-escaped
+ * text, base64 of binary data) and produced on demand, so callers can fill
+ * a single buffer, stream straight into a socket, or replay the same body
+ * on another connection without rebuilding it.
+ */
+#define VISION_ENCODER_MAX_SEGMENTS (11 + 5 * VISION_MAX_EXAMPLES)
+
+typedef enum {
+    VISION_SEG_LITERAL = 0,
+    VISION_SEG_ESCAPED,
+    VISION_SEG_BASE64
+} VisionSegmentType;
+
+typedef struct {
+    VisionSegmentType type;
+    const uint8_t* data;
+    size_t len;
+} VisionSegment;
+
+typedef struct {
+    VisionSegment segments[VISION_ENCODER_MAX_SEGMENTS];
+    int segment_count;
+    size_t total_length;
+
+    // Read cursor
+    int segment;
+    size_t offset;
+    char pending[4];
+    uint8_t pending_len;
+    uint8_t pending_pos;
+} VisionEncoder;
+
+struct VisionBackend;
+
+/**
+ * Wire-format operations shared by every backend that speaks the same API
+ */
+typedef struct {
+    /** Write the request path (including query) into out, returns its length or 0 */
+    size_t (*buildPath)(const struct VisionBackend* backend, const char* api_key, char* out, size_t out_size);
+    /** Set up an encoder for the request body */
+    bool (*initEncoder)(const struct VisionBackend* backend, const VisionRequest* request, VisionEncoder* encoder);
+    /** Locate the model's answer text inside a response body */
+    bool (*extractText)(const char* body, const char** text, size_t* text_len);
+    /** Read the finish reason and answer log-probability from a response body, false if neither is there */
+    bool (*extractAnswerInfo)(const char* body, VisionAnswerInfo* info);
+    /** Write the path for creating a context cache, returns its length or 0 if unsupported */
+    size_t (*buildCachePath)(const struct VisionBackend* backend, const char* api_key, char* out, size_t out_size);
+    /** Set up an encoder for the context cache creation body, ttl like "3600s" */
+    bool (*initCacheEncoder)(const struct VisionBackend* backend, const VisionContext* context, const char* ttl, VisionEncoder* encoder);
+    /** Locate the cache name inside a creation response */
+    bool (*extractCacheName)(const char* body, const char** name, size_t* name_len);
+    /** Content-Type of the request body */
+    const char* content_type;
+} VisionBackendOps;
+
+/**
+ * A vision backend: where requests go and how they are built and parsed
+ */
+typedef struct VisionBackend {
+    const char* name;
+    const char* host;
+    uint16_t port;
+    bool use_tls;
+    const char* model;
+    const VisionBackendOps* ops;
+} VisionBackend;
+
+/**
+ * Gemini generateContent backend for the given model
+ * @param model Model name, e.g. "gemini-2.0-flash-lite"
+ */
+VisionBackend visionGeminiBackend(const char* model);
+
+/**
+ * Local mock server speaking the Gemini wire format (see src/host/mock_server.cpp)
+ * @param host Host name or IP of the machine running the mock
+ * @param port TCP port of the mock
+ * @param use_tls true if the mock was started with a certificate
+ */
+VisionBackend visionMockBackend(const char* host, uint16_t port, bool use_tls);
+
+/**
+ * A controller classifying frames for several cameras (see frame_source.h)
+ *
+ * Requests carry the bare JPEG to the controller's /frame endpoint, which
+ * queues it behind its own captures and answers with the label as plain
+ * text. The instructions and examples live on the controller.
+ *
+ * @param host Host name or IP of the controller
+ * @param port TCP port of its web server
+ * @param source Name this camera is known by on the controller, e.g. "chute2"
+ */
+VisionBackend visionControllerBackend(const char* host, uint16_t port, const char* source);
+
+/**
+ * Select the backend used by sendToGeminiAPI and captureImageAsGeminiJson
+ * @param backend Backend descriptor, must outlive all requests (NULL restores Gemini)
+ */
+void visionSetBackend(const VisionBackend* backend);
+
+/**
+ * @return The currently selected backend (never NULL)
+ */
+const VisionBackend* visionGetBackend(void);
+
+/**
+ * Prepare an encoder for the request body of the given backend
+ * @return true if successful, false if the request is invalid
+ */
+bool visionEncoderInit(VisionEncoder* encoder, const VisionBackend* backend, const VisionRequest* request);
+
+/**
+ * Prepare an encoder for the body that uploads a context to the backend's cache
+ * @param ttl Cache lifetime in the backend's format, e.g. "3600s", must outlive the encoder
+ * @return true if successful, false if the context is invalid or the backend has no cache
+ */
+bool visionCacheEncoderInit(VisionEncoder* encoder, const VisionBackend* backend, const VisionContext* context, const char* ttl);
+
+/**
+ * Prepare an encoder that replays an already built body
+ * @param data Body bytes, must outlive the encoder
+ * @param len Body length
+ */
+void visionEncoderInitRaw(VisionEncoder* encoder, const char* data, size_t len);
+
+/**
+ * @return Exact number of bytes the encoder will produce
+ */
+size_t visionEncoderLength(const VisionEncoder* encoder);
+
+/**
+ * Produce the next part of the body
+ * @return Number of bytes written to out, 0 once the body is complete
+ */
+size_t visionEncoderRead(VisionEncoder* encoder, char* out, size_t out_size);
+
+/**
+ * Restart the encoder from the beginning of the body
+ */
+void visionEncoderRewind(VisionEncoder* encoder);
+
+/**
+ * Extract the answer text from a response using the current backend's parser
+ * @param body Response body
+ * @param text Receives a pointer into body (not NUL terminated)
+ * @param text_len Receives the text length
+ * @return true if an answer was found
+ */
+bool visionExtractText(const char* body, const char** text, size_t* text_len);
+
+/**
+ * Extract the finish reason and answer log-probability using the current backend's parser
+ * @param body Response body
+ * @param info Receives what was found; fields the response lacks are left unknown
+ * @return true if the response reported either
+ */
+bool visionExtractAnswerInfo(const char* body, VisionAnswerInfo* info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VISION_BACKEND_H */
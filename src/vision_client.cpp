@@ -0,0 +1,703 @@
+#include "vision_client.h"
+#include "vision_transport.h"
+#include "latency_stats.h"
+#include "request_scheduler.h"
+#include "link_estimator.h"
+#include "platform_port.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// MARK: Client Config
+static const uint32_t CONNECT_TIMEOUT_MS = 10000;
+static const uint32_t RESPONSE_TIMEOUT_MS = 10000;
+static const size_t CHUNK_SIZE = 1024;
+#define UPLOAD_BUFFER_SIZE 4096
+
+static bool s_chunked_upload = false;
+
+void visionSetChunkedUpload(bool enabled) {
+    s_chunked_upload = enabled;
+}
+
+// MARK: Response Buffer
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+} ResponseBuffer;
+
+static bool responseReserve(ResponseBuffer* buf, size_t extra) {
+    if (buf->len + extra + 1 <= buf->cap) {
+        return true;
+    }
+    size_t cap = buf->cap ? buf->cap : 1024;
+    while (cap < buf->len + extra + 1) {
+        cap *= 2;
+    }
+    char* data = (char*)realloc(buf->data, cap);
+    if (!data) {
+        return false;
+    }
+    buf->data = data;
+    buf->cap = cap;
+    return true;
+}
+
+// MARK: HTTP Parsing
+typedef struct {
+    int status;
+    size_t header_len;          // Bytes up to and including the blank line
+    long content_length;        // -1 if absent
+    bool chunked;
+    uint32_t retry_after_ms;    // 0 if absent
+} ResponseHead;
+
+static bool parseHead(const char* data, size_t len, ResponseHead* head) {
+    const char* end = NULL;
+    for (size_t i = 3; i < len; i++) {
+        if (data[i - 3] == '\r' && data[i - 2] == '\n' && data[i - 1] == '\r' && data[i] == '\n') {
+            end = data + i + 1;
+            break;
+        }
+    }
+    if (!end) {
+        return false;
+    }
+
+    head->header_len = end - data;
+    head->status = 0;
+    head->content_length = -1;
+    head->chunked = false;
+    head->retry_after_ms = 0;
+
+    // Status line: HTTP/1.1 200 OK
+    const char* sp = (const char*)memchr(data, ' ', head->header_len);
+    if (sp) {
+        head->status = atoi(sp + 1);
+    }
+
+    const char* line = (const char*)memchr(data, '\n', head->header_len) + 1;
+    while (line < end) {
+        const char* eol = (const char*)memchr(line, '\n', end - line);
+        if (!eol) break;
+
+        if (strncasecmp(line, "Content-Length:", 15) == 0) {
+            head->content_length = atol(line + 15);
+        } else if (strncasecmp(line, "Retry-After:", 12) == 0) {
+            // Only the delay-seconds form; an HTTP date falls back to backoff
+            head->retry_after_ms = strtoul(line + 12, NULL, 10) * 1000;
+        } else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0) {
+            for (const char* p = line + 18; p + 7 <= eol; p++) {
+                if (strncasecmp(p, "chunked", 7) == 0) {
+                    head->chunked = true;
+                    break;
+                }
+            }
+        }
+        line = eol + 1;
+    }
+    return true;
+}
+
+/**
+ * Gemini puts the quota delay in the error body: "retryDelay": "23s"
+ * @return Delay in ms, 0 if not present
+ */
+static uint32_t parseRetryDelay(const char* body) {
+    const char* key = strstr(body, "\"retryDelay\"");
+    if (!key) {
+        return 0;
+    }
+    const char* p = key + 12;
+    while (*p == ' ' || *p == ':' || *p == '"') {
+        p++;
+    }
+    char* end;
+    double seconds = strtod(p, &end);
+    return end != p && *end == 's' ? (uint32_t)(seconds * 1000) : 0;
+}
+
+/**
+ * Decode a chunked body in place
+ * @return Decoded length, or -1 if the terminating chunk has not arrived yet
+ */
+static long decodeChunked(char* body, size_t len) {
+    size_t in = 0;
+    size_t out = 0;
+
+    while (in < len) {
+        const char* eol = (const char*)memchr(body + in, '\n', len - in);
+        if (!eol) {
+            return -1;
+        }
+        size_t chunk = strtoul(body + in, NULL, 16);
+        size_t data_start = (eol - body) + 1;
+        if (chunk == 0) {
+            return (long)out;
+        }
+        if (data_start + chunk + 2 > len) {
+            return -1;
+        }
+        memmove(body + out, body + data_start, chunk);
+        out += chunk;
+        in = data_start + chunk + 2;
+    }
+    return -1;
+}
+
+static bool chunkedComplete(const char* body, size_t len) {
+    size_t in = 0;
+    while (in < len) {
+        const char* eol = (const char*)memchr(body + in, '\n', len - in);
+        if (!eol) {
+            return false;
+        }
+        size_t chunk = strtoul(body + in, NULL, 16);
+        if (chunk == 0) {
+            return true;
+        }
+        in = (eol - body) + 1 + chunk + 2;
+    }
+    return false;
+}
+
+// MARK: Last Response
+static VisionResponseInfo s_last_response;
+
+VisionResponseInfo visionLastResponse(void) {
+    return s_last_response;
+}
+
+// MARK: Hedging
+static const uint32_t HEDGE_DEFAULT_DEADLINE_MS = 3000;
+static const uint32_t HEDGE_MIN_DEADLINE_MS = 500;
+static const uint16_t HEDGE_MIN_SAMPLES = 8;
+static const uint32_t HEDGE_WINDOW_MS = 60000;
+
+static bool s_hedging = false;
+static uint8_t s_hedge_cap = 0;
+static uint32_t s_hedge_window_start = 0;
+static uint8_t s_hedges_in_window = 0;
+static LatencyWindow s_first_byte;
+static VisionHedgeStats s_hedge_stats;
+
+void visionSetHedging(bool enabled, uint8_t max_per_minute) {
+    s_hedging = enabled;
+    s_hedge_cap = max_per_minute;
+}
+
+uint32_t visionHedgeDeadline(void) {
+    if (s_first_byte.count < HEDGE_MIN_SAMPLES) {
+        return HEDGE_DEFAULT_DEADLINE_MS;
+    }
+    uint32_t p90 = latencyPercentile(&s_first_byte, 90);
+    if (p90 < HEDGE_MIN_DEADLINE_MS) {
+        return HEDGE_MIN_DEADLINE_MS;
+    }
+    return p90 < RESPONSE_TIMEOUT_MS ? p90 : RESPONSE_TIMEOUT_MS;
+}
+
+VisionHedgeStats visionGetHedgeStats(void) {
+    return s_hedge_stats;
+}
+
+static bool hedgeBudgetTake(void) {
+    uint32_t now = millis();
+    if (now - s_hedge_window_start >= HEDGE_WINDOW_MS) {
+        s_hedge_window_start = now;
+        s_hedges_in_window = 0;
+    }
+    if (s_hedges_in_window >= s_hedge_cap) {
+        s_hedge_stats.suppressed++;
+        return false;
+    }
+    s_hedges_in_window++;
+    return true;
+}
+
+// MARK: Request
+/**
+ * Read whatever is available from conn into buf
+ * @return Bytes appended, 0 if none yet, -1 if the peer closed or memory ran out
+ */
+static int pollInto(VisionConn* conn, ResponseBuffer* buf) {
+    if (!responseReserve(buf, CHUNK_SIZE)) {
+        return -1;
+    }
+    int n = visionConnRead(conn, (uint8_t*)buf->data + buf->len, CHUNK_SIZE);
+    if (n > 0) {
+        buf->len += n;
+    }
+    return n;
+}
+
+static bool writeFully(VisionConn* conn, const char* data, size_t len) {
+    while (len > 0) {
+        size_t sent = visionConnWrite(conn, (const uint8_t*)data, len);
+        if (sent == 0) {
+            return false;
+        }
+        data += sent;
+        len -= sent;
+    }
+    return true;
+}
+
+/**
+ * Write one piece of the body, framed as an HTTP chunk in chunked mode
+ */
+static bool writePiece(VisionConn* conn, const char* data, size_t len, bool chunked) {
+    if (!chunked) {
+        return writeFully(conn, data, len);
+    }
+    char size_line[12];
+    int n = snprintf(size_line, sizeof(size_line), "%x\r\n", (unsigned)len);
+    return writeFully(conn, size_line, n) &&
+           writeFully(conn, data, len) &&
+           writeFully(conn, "\r\n", 2);
+}
+
+// MARK: Upload Pipe
+/**
+ * Double buffer between an encoder task (producer) and the socket writer
+ * (consumer), so base64 encoding of the next piece overlaps with sending
+ * the current one.
+ */
+typedef struct {
+    VisionEncoder* encoder;
+    char data[2][UPLOAD_BUFFER_SIZE];
+    size_t len[2];
+    PortSem free_slots;
+    PortSem full_slots;
+    PortSem done;
+    volatile bool abort;
+} UploadPipe;
+
+static void uploadProducer(void* arg) {
+    UploadPipe* pipe = (UploadPipe*)arg;
+    for (int slot = 0;; slot ^= 1) {
+        portSemTake(pipe->free_slots);
+        size_t len = pipe->abort ? 0 : visionEncoderRead(pipe->encoder, pipe->data[slot], UPLOAD_BUFFER_SIZE);
+        pipe->len[slot] = len;
+        portSemGive(pipe->full_slots);
+        if (len == 0) {
+            break;
+        }
+    }
+    portSemGive(pipe->done);
+}
+
+static bool writeBodyPipelined(VisionConn* conn, VisionEncoder* body, VisionConn* watch, ResponseBuffer* watch_buf, bool* watch_ready) {
+    UploadPipe* pipe = (UploadPipe*)malloc(sizeof(UploadPipe));
+    if (!pipe) {
+        return false;
+    }
+    pipe->encoder = body;
+    pipe->abort = false;
+    pipe->free_slots = portSemCreate(2);
+    pipe->full_slots = portSemCreate(0);
+    pipe->done = portSemCreate(0);
+
+    bool started = pipe->free_slots && pipe->full_slots && pipe->done &&
+                   portTaskStart(uploadProducer, "vision_enc", pipe);
+    bool ok = started;
+    for (int slot = 0; started; slot ^= 1) {
+        portSemTake(pipe->full_slots);
+        size_t len = pipe->len[slot];
+        if (len == 0) {
+            break;
+        }
+        if (ok) {
+            if (!writePiece(conn, pipe->data[slot], len, true)) {
+                ok = false;
+            } else if (watch && pollInto(watch, watch_buf) > 0) {
+                *watch_ready = true;
+                ok = false;
+            }
+            // Producer sees this on its next piece and finishes with an empty one
+            pipe->abort = !ok;
+        }
+        portSemGive(pipe->free_slots);
+    }
+
+    if (started) {
+        portSemTake(pipe->done);
+    }
+    if (ok) {
+        ok = writeFully(conn, "0\r\n\r\n", 5);
+    }
+    portSemDelete(pipe->free_slots);
+    portSemDelete(pipe->full_slots);
+    portSemDelete(pipe->done);
+    free(pipe);
+    return ok;
+}
+
+/**
+ * Write the whole body produced by the encoder
+ *
+ * If watch is given it is polled between chunks; as soon as it delivers
+ * data the upload is abandoned and *watch_ready is set.
+ */
+static bool writeBody(VisionConn* conn, VisionEncoder* body, VisionConn* watch, ResponseBuffer* watch_buf, bool* watch_ready) {
+    visionEncoderRewind(body);
+    if (s_chunked_upload) {
+        return writeBodyPipelined(conn, body, watch, watch_buf, watch_ready);
+    }
+
+    char chunk[CHUNK_SIZE];
+    size_t len;
+    while ((len = visionEncoderRead(body, chunk, sizeof(chunk))) > 0) {
+        if (!writePiece(conn, chunk, len, false)) {
+            return false;
+        }
+        if (watch && pollInto(watch, watch_buf) > 0) {
+            *watch_ready = true;
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool writeRequestHead(VisionConn* conn, const VisionBackend* backend, const char* path, size_t payload_len) {
+    char length_header[48];
+    if (s_chunked_upload) {
+        snprintf(length_header, sizeof(length_header), "Transfer-Encoding: chunked");
+    } else {
+        snprintf(length_header, sizeof(length_header), "Content-Length: %u", (unsigned)payload_len);
+    }
+
+    char head[512];
+    int len = snprintf(head, sizeof(head),
+                       "POST %s HTTP/1.1\r\n"
+                       "Host: %s\r\n"
+                       "Content-Type: %s\r\n"
+                       "%s\r\n"
+                       "Connection: close\r\n"
+                       "\r\n",
+                       path, backend->host, backend->ops->content_type, length_header);
+    if (len < 0 || (size_t)len >= sizeof(head)) {
+        return false;
+    }
+    return writeFully(conn, head, len);
+}
+
+/**
+ * Send the request on an open connection
+ * @return conn, or NULL after closing it if sending failed
+ */
+static VisionConn* sendRequest(VisionConn* conn, const VisionBackend* backend, const char* path, VisionEncoder* body,
+                               VisionConn* watch, ResponseBuffer* watch_buf, bool* watch_ready) {
+    size_t body_len = visionEncoderLength(body);
+    if (!writeRequestHead(conn, backend, path, body_len)) {
+        visionConnClose(conn);
+        return NULL;
+    }
+    uint32_t upload_start = millis();
+    if (!writeBody(conn, body, watch, watch_buf, watch_ready)) {
+        visionConnClose(conn);
+        return NULL;
+    }
+    // Feeds the payload downgrade decision for the next capture
+    linkRecordUpload(visionLinkRssi(), body_len, millis() - upload_start);
+    return conn;
+}
+
+static VisionConn* openAndSend(const VisionBackend* backend, const char* path, VisionEncoder* body) {
+    VisionConn* conn = visionConnOpen(backend, CONNECT_TIMEOUT_MS);
+    return conn ? sendRequest(conn, backend, path, body, NULL, NULL, NULL) : NULL;
+}
+
+// MARK: Response
+typedef enum {
+    RESPONSE_WAITING,
+    RESPONSE_COMPLETE,
+    RESPONSE_FAILED
+} ResponseState;
+
+/**
+ * A response arriving on one connection; the primary and a hedge each have one
+ */
+typedef struct {
+    VisionConn* conn;           // NULL once closed
+    ResponseBuffer buf;
+    ResponseHead head;
+    bool have_head;
+    uint32_t sent_at;           // When this connection's request finished uploading
+    uint32_t first_byte_at;     // 0 until a byte arrives
+    uint32_t last_data;
+} PendingResponse;
+
+static void pendingStart(PendingResponse* pending, VisionConn* conn, ResponseBuffer buf) {
+    pending->conn = conn;
+    pending->buf = buf;
+    pending->have_head = false;
+    pending->sent_at = millis();
+    pending->first_byte_at = buf.len > 0 ? pending->sent_at : 0;
+    pending->last_data = pending->sent_at;
+}
+
+static void pendingDrop(PendingResponse* pending) {
+    if (pending->conn) {
+        visionConnClose(pending->conn);
+        pending->conn = NULL;
+    }
+    free(pending->buf.data);
+    pending->buf.data = NULL;
+    pending->buf.len = 0;
+    pending->buf.cap = 0;
+}
+
+static bool pendingComplete(PendingResponse* pending) {
+    if (!pending->have_head) {
+        pending->have_head = parseHead(pending->buf.data, pending->buf.len, &pending->head);
+        if (!pending->have_head) {
+            return false;
+        }
+    }
+    size_t body_len = pending->buf.len - pending->head.header_len;
+    if (pending->head.chunked) {
+        return chunkedComplete(pending->buf.data + pending->head.header_len, body_len);
+    }
+    return pending->head.content_length >= 0 && body_len >= (size_t)pending->head.content_length;
+}
+
+/**
+ * Read what has arrived and say whether the response is all there
+ */
+static ResponseState pendingPoll(PendingResponse* pending) {
+    if (pendingComplete(pending)) {
+        return RESPONSE_COMPLETE;
+    }
+    int n = pollInto(pending->conn, &pending->buf);
+    uint32_t now = millis();
+    if (n < 0) {
+        // Without a length the body runs to the close
+        bool to_close = pending->have_head && !pending->head.chunked && pending->head.content_length < 0;
+        return to_close ? RESPONSE_COMPLETE : RESPONSE_FAILED;
+    }
+    if (n == 0) {
+        return now - pending->last_data > RESPONSE_TIMEOUT_MS ? RESPONSE_FAILED : RESPONSE_WAITING;
+    }
+    if (!pending->first_byte_at) {
+        pending->first_byte_at = now;
+    }
+    pending->last_data = now;
+    return pendingComplete(pending) ? RESPONSE_COMPLETE : RESPONSE_WAITING;
+}
+
+/**
+ * Close the connection and strip a complete response down to its body
+ * @return The body (must be freed with free()) for a 2xx status, NULL otherwise
+ */
+static char* pendingFinish(PendingResponse* pending, VisionResponseInfo* info) {
+    visionConnClose(pending->conn);
+    pending->conn = NULL;
+    ResponseBuffer buf = pending->buf;
+    pending->buf.data = NULL;
+    ResponseHead* head = &pending->head;
+
+    // Strip headers, keep only the body
+    char* body = buf.data + head->header_len;
+    size_t body_len = buf.len - head->header_len;
+    if (head->chunked) {
+        long decoded = decodeChunked(body, body_len);
+        body_len = decoded >= 0 ? (size_t)decoded : 0;
+    } else if (head->content_length >= 0 && body_len > (size_t)head->content_length) {
+        body_len = head->content_length;
+    }
+    memmove(buf.data, body, body_len);
+    buf.data[body_len] = '\0';
+
+    info->status = head->status;
+    info->retry_after_ms = head->retry_after_ms;
+    if (head->status < 200 || head->status >= 300) {
+        if (info->retry_after_ms == 0) {
+            info->retry_after_ms = parseRetryDelay(buf.data);
+        }
+        free(buf.data);
+        return NULL;
+    }
+    return buf.data;
+}
+
+// MARK: Exchange
+/**
+ * Send the request and wait for a usable answer, hedging once if the first byte is late
+ *
+ * Whichever connection completes a 2xx response first wins. A connection
+ * that fails or answers with an error is dropped and the other one, if
+ * any, is still waited for, so a hedge returning 5xx never beats a primary
+ * that would have succeeded.
+ */
+static char* exchange(const VisionBackend* backend, const char* path, VisionEncoder* body) {
+    s_last_response.status = 0;
+    s_last_response.retry_after_ms = 0;
+    s_last_response.cache_rejected = false;
+
+    ResponseBuffer empty = {NULL, 0, 0};
+    PendingResponse primary;
+    PendingResponse hedge;
+    pendingStart(&hedge, NULL, empty);
+
+    VisionConn* conn = openAndSend(backend, path, body);
+    if (!conn) {
+        return NULL;
+    }
+    pendingStart(&primary, conn, empty);
+
+    uint32_t deadline = visionHedgeDeadline();
+    bool hedge_tried = false;
+    bool hedge_warming = false;
+    char* response = NULL;
+    PendingResponse* winner = NULL;
+
+    while (!winner && (primary.conn || hedge.conn)) {
+        PendingResponse* slots[2] = {&primary, &hedge};
+        for (int i = 0; i < 2 && !winner; i++) {
+            PendingResponse* pending = slots[i];
+            if (!pending->conn) {
+                continue;
+            }
+            ResponseState state = pendingPoll(pending);
+            if (state == RESPONSE_COMPLETE) {
+                // Keep the status of a failed answer for the scheduler, unless the other one succeeds
+                VisionResponseInfo info = {0, 0, false};
+                uint32_t first_byte_ms = pending->first_byte_at - pending->sent_at;
+                response = pendingFinish(pending, &info);
+                if (response || s_last_response.status == 0) {
+                    s_last_response.status = info.status;
+                    s_last_response.retry_after_ms = info.retry_after_ms;
+                }
+                if (response) {
+                    winner = pending;
+                    latencyRecord(&s_first_byte, first_byte_ms);
+                }
+            } else if (state == RESPONSE_FAILED) {
+                pendingDrop(pending);
+            }
+        }
+        if (winner || (!primary.conn && !hedge.conn)) {
+            break;
+        }
+
+        // Hedge only while the primary has sent nothing back. Its handshake runs in the
+        // background from half the deadline on, so the primary is never left unread
+        // while a hedge connects; the hedge goes out once that connection is up
+        uint32_t now = millis();
+        bool hedge_wanted = primary.conn && !primary.first_byte_at && !hedge_tried && s_hedging;
+        if (hedge_wanted && !hedge_warming && now - primary.sent_at >= deadline / 2) {
+            hedge_warming = true;
+            visionConnPrewarm(backend);
+        }
+        if (hedge_wanted && now - primary.sent_at >= deadline) {
+            conn = visionConnTakeWarm(backend);
+            if (conn) {
+                hedge_tried = true;
+                // A duplicate costs quota too, so it only runs on a spare token
+                if (hedgeBudgetTake() && schedulerAcquire(REQUEST_BACKGROUND, 0)) {
+                    s_hedge_stats.fired++;
+                    bool primary_ready = false;
+                    conn = sendRequest(conn, backend, path, body, primary.conn, &primary.buf, &primary_ready);
+                    if (primary_ready && !primary.first_byte_at) {
+                        primary.first_byte_at = millis();
+                        primary.last_data = primary.first_byte_at;
+                    }
+                    if (conn) {
+                        pendingStart(&hedge, conn, empty);
+                    }
+                } else {
+                    visionConnClose(conn);
+                }
+            }
+        }
+        delay(1);
+    }
+
+    if (winner == &hedge) {
+        s_hedge_stats.won++;
+    }
+    // Cancel the loser
+    pendingDrop(&primary);
+    pendingDrop(&hedge);
+    return response;
+}
+
+// MARK: Gemini API
+static bool generatePath(const VisionBackend* backend, const char* key, char* path, size_t path_size) {
+    return backend->ops->buildPath(backend, key, path, path_size) > 0;
+}
+
+char* visionSendRequest(const VisionRequest* request, const char* api_key) {
+    if (!request || !api_key) {
+        return NULL;
+    }
+
+    const VisionBackend* backend = visionGetBackend();
+    char path[256];
+    VisionEncoder body;
+    if (!generatePath(backend, api_key, path, sizeof(path)) || !visionEncoderInit(&body, backend, request)) {
+        return NULL;
+    }
+    char* response = exchange(backend, path, &body);
+
+    // An expired or evicted cache is refused with 400/403/404: resend with the context inline
+    const VisionContext* context = request->context;
+    int status = s_last_response.status;
+    if (!response && context && context->cache_name && (status == 400 || status == 403 || status == 404)) {
+        VisionContext inline_context = *context;
+        inline_context.cache_name = NULL;
+        VisionRequest inline_request = *request;
+        inline_request.context = &inline_context;
+        if (visionEncoderInit(&body, backend, &inline_request)) {
+            response = exchange(backend, path, &body);
+        }
+        s_last_response.cache_rejected = true;
+    }
+    return response;
+}
+
+char* sendToGeminiAPI(const char* json_payload, const char* gemini_key) {
+    if (!json_payload || !gemini_key) {
+        return NULL;
+    }
+
+    const VisionBackend* backend = visionGetBackend();
+    char path[256];
+    if (!generatePath(backend, gemini_key, path, sizeof(path))) {
+        return NULL;
+    }
+    VisionEncoder body;
+    visionEncoderInitRaw(&body, json_payload, strlen(json_payload));
+    return exchange(backend, path, &body);
+}
+
+bool visionCreateCache(const VisionContext* context, const char* ttl, const char* api_key, char* name, size_t name_size) {
+    if (!context || !ttl || !api_key || !name || name_size == 0) {
+        return false;
+    }
+
+    const VisionBackend* backend = visionGetBackend();
+    char path[256];
+    VisionEncoder body;
+    if (!backend->ops->buildCachePath || backend->ops->buildCachePath(backend, api_key, path, sizeof(path)) == 0 ||
+        !visionCacheEncoderInit(&body, backend, context, ttl)) {
+        return false;
+    }
+
+    char* response = exchange(backend, path, &body);
+    if (!response) {
+        return false;
+    }
+    const char* value;
+    size_t value_len;
+    bool ok = backend->ops->extractCacheName(response, &value, &value_len) && value_len < name_size;
+    if (ok) {
+        memcpy(name, value, value_len);
+        name[value_len] = '\0';
+    }
+    free(response);
+    return ok;
+}
@@ -0,0 +1,101 @@
+#ifndef VISION_CLIENT_H
+#define VISION_CLIENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "vision_backend.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Counters for hedged requests
+ */
+typedef struct {
+    uint32_t fired;       // Duplicate requests sent
+    uint32_t won;         // Duplicates that answered first
+    uint32_t suppressed;  // Hedges skipped because the per-minute cap was reached
+} VisionHedgeStats;
+
+/**
+ * How the backend answered the last request
+ */
+typedef struct {
+    int status;               // HTTP status, 0 if no response arrived
+    uint32_t retry_after_ms;  // From Retry-After or the body's retryDelay, 0 if not given
+    bool cache_rejected;      // The context cache was refused and the request resent inline
+} VisionResponseInfo;
+
+/**
+ * Send the image to the selected vision backend (Gemini by default) and get response
+ * @param json_payload The JSON payload (from captureImageAsGeminiJson)
+ * @param gemini_key The Gemini API key
+ * @return Pointer to the response body (must be freed with free()), NULL on failure or a non-2xx status
+ */
+char* sendToGeminiAPI(const char* json_payload, const char* gemini_key);
+
+/**
+ * Encode and send a request straight from the image, without building the JSON in memory
+ * @param request Prompt and JPEG image
+ * @param api_key The backend API key
+ * @return Pointer to the response body (must be freed with free()), NULL on failure or a non-2xx status
+ */
+char* visionSendRequest(const VisionRequest* request, const char* api_key);
+
+/**
+ * Upload a context (instructions and few-shot examples) to the backend's cache
+ * @param context Context to upload, cache_name is ignored
+ * @param ttl Cache lifetime in the backend's format, e.g. "3600s"
+ * @param api_key The backend API key
+ * @param name Receives the cache name to put in VisionContext::cache_name
+ * @param name_size Size of the name buffer
+ * @return true if successful, false on error or if the backend has no cache
+ */
+bool visionCreateCache(const VisionContext* context, const char* ttl, const char* api_key, char* name, size_t name_size);
+
+/**
+ * @return Status of the last request, so callers can tell a quota error from a network failure
+ */
+VisionResponseInfo visionLastResponse(void);
+
+/**
+ * Send request bodies with Transfer-Encoding: chunked
+ *
+ * The body is produced by an encoder task into a double buffer while the
+ * caller writes the previous piece to the socket, so encoding and
+ * transmission overlap instead of adding up.
+ *
+ * @param enabled true for chunked uploads, false for Content-Length
+ */
+void visionSetChunkedUpload(bool enabled);
+
+/**
+ * Enable hedged requests
+ *
+ * When no response byte arrives within visionHedgeDeadline(), the same
+ * body is sent on a second connection and whichever answers first wins.
+ * That connection is prewarmed from half the deadline on, and the hedge
+ * waits for its handshake rather than connecting inline.
+ *
+ * @param enabled true to hedge slow requests
+ * @param max_per_minute Upper bound on duplicate requests per minute
+ */
+void visionSetHedging(bool enabled, uint8_t max_per_minute);
+
+/**
+ * @return Current hedge deadline in ms (p90 of recent first-byte latencies)
+ */
+uint32_t visionHedgeDeadline(void);
+
+/**
+ * @return Hedge counters since boot
+ */
+VisionHedgeStats visionGetHedgeStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VISION_CLIENT_H */
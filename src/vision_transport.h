@@ -0,0 +1,82 @@
+#ifndef VISION_TRANSPORT_H
+#define VISION_TRANSPORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "vision_backend.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Byte-stream connection to a vision backend
+ *
+ * Implemented once per platform: vision_transport_wifi.cpp on the ESP32,
+ * src/host/ for Linux builds.
+ */
+typedef struct VisionConn VisionConn;
+
+/**
+ * Open a connection to the backend's host and port (TLS if the backend asks for it)
+ * @param backend Backend to connect to
+ * @param timeout_ms Connect timeout
+ * @return Connection handle or NULL on failure (must be closed with visionConnClose())
+ */
+VisionConn* visionConnOpen(const VisionBackend* backend, uint32_t timeout_ms);
+
+/**
+ * Write bytes to the connection
+ * @return Number of bytes written, 0 on error
+ */
+size_t visionConnWrite(VisionConn* conn, const uint8_t* data, size_t len);
+
+/**
+ * Read whatever is available without blocking
+ * @return Number of bytes read, 0 if nothing is available yet, -1 once the peer has closed
+ */
+int visionConnRead(VisionConn* conn, uint8_t* buffer, size_t len);
+
+/**
+ * Close the connection and release its resources
+ */
+void visionConnClose(VisionConn* conn);
+
+/**
+ * Start DNS resolution and the TCP/TLS handshake in the background
+ *
+ * Call on the trigger edge; the next visionConnOpen() for the same backend
+ * picks up the warm connection (waiting for the handshake to finish if it
+ * is still in flight) instead of connecting from scratch.
+ *
+ * @param backend Backend to connect to, must outlive the connection
+ */
+void visionConnPrewarm(const VisionBackend* backend);
+
+/**
+ * Take the warm connection only if its handshake is already done
+ *
+ * Never waits or connects, so a caller can keep polling other connections
+ * while visionConnPrewarm() works in the background.
+ *
+ * @return Connection for the backend, NULL if none is ready yet
+ */
+VisionConn* visionConnTakeWarm(const VisionBackend* backend);
+
+/**
+ * Set how long resolved backend addresses are reused before resolving again
+ * @param ttl_ms Cache lifetime in ms, 0 disables the cache
+ */
+void visionSetDnsTtl(uint32_t ttl_ms);
+
+/**
+ * @return Current signal strength in dBm, 0 if the link has none (wired or host builds)
+ */
+int8_t visionLinkRssi(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VISION_TRANSPORT_H */
@@ -0,0 +1,261 @@
+#include "vision_transport.h"
+#include "platform_port.h"
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiClient.h>
+#include <WiFiClientSecure.h>
+#include <new>
+
+struct VisionConn {
+    WiFiClientSecure secure;
+    WiFiClient plain;
+    bool use_tls;
+};
+
+static inline Client& connClient(VisionConn* conn) {
+    if (conn->use_tls) {
+        return conn->secure;
+    }
+    return conn->plain;
+}
+
+// MARK: Prewarm Config
+static const uint32_t PREWARM_TIMEOUT_MS = 10000;
+static const uint32_t WARM_MAX_IDLE_MS = 15000;  // Servers drop idle TLS sessions
+
+// MARK: DNS Cache
+static uint32_t s_dns_ttl_ms = 600000;
+static char s_dns_host[64] = "";
+static IPAddress s_dns_ip;
+static uint32_t s_dns_resolved_at = 0;
+
+void visionSetDnsTtl(uint32_t ttl_ms) {
+    s_dns_ttl_ms = ttl_ms;
+}
+
+static PortSem dnsLock(void) {
+    static PortSem lock = portSemCreate(1);
+    return lock;
+}
+
+static bool resolveHost(const char* host, IPAddress* ip) {
+    // Literal addresses need no lookup
+    if (ip->fromString(host)) {
+        return true;
+    }
+
+    // The loop and prewarms started from web server tasks may resolve at
+    // once; hostByName shares one result slot, so lookups are serialized too
+    PortSem lock = dnsLock();
+    if (!lock) {
+        return false;
+    }
+    portSemTake(lock);
+    bool ok = true;
+    if (s_dns_ttl_ms > 0 && strcmp(s_dns_host, host) == 0 &&
+        millis() - s_dns_resolved_at < s_dns_ttl_ms) {
+        *ip = s_dns_ip;
+    } else if (WiFi.hostByName(host, *ip)) {
+        strncpy(s_dns_host, host, sizeof(s_dns_host) - 1);
+        s_dns_ip = *ip;
+        s_dns_resolved_at = millis();
+    } else {
+        ok = false;
+    }
+    portSemGive(lock);
+    return ok;
+}
+
+// MARK: Connect
+static VisionConn* connectBackend(const VisionBackend* backend, uint32_t timeout_ms) {
+    IPAddress ip;
+    if (!resolveHost(backend->host, &ip)) {
+        return NULL;
+    }
+
+    VisionConn* conn = new (std::nothrow) VisionConn();
+    if (!conn) {
+        return NULL;
+    }
+    conn->use_tls = backend->use_tls;
+
+    bool ok;
+    if (conn->use_tls) {
+        conn->secure.setInsecure(); // Skip certificate validation
+        conn->secure.setHandshakeTimeout((timeout_ms + 999) / 1000);
+        // Connect by address but keep the host name for SNI
+        ok = conn->secure.connect(ip, backend->port, backend->host, NULL, NULL, NULL);
+    } else {
+        ok = conn->plain.connect(ip, backend->port, timeout_ms);
+    }
+
+    if (!ok) {
+        delete conn;
+        return NULL;
+    }
+    return conn;
+}
+
+// MARK: Warm Slot
+static VisionConn* s_warm_conn = NULL;
+static const VisionBackend* s_warm_backend = NULL;
+static uint32_t s_warm_at = 0;
+static volatile bool s_warm_pending = false;
+
+/**
+ * Lock for the warm slot; created on first use, exactly once even when the
+ * loop and a web server task prewarm at the same time
+ */
+static PortSem warmLock(void) {
+    static PortSem lock = portSemCreate(1);
+    return lock;
+}
+
+// Given by the prewarm task when its handshake ends, for takeWarm to wait on
+static PortSem warmDone(void) {
+    static PortSem done = portSemCreate(0);
+    return done;
+}
+
+static void prewarmTask(void* arg) {
+    const VisionBackend* backend = (const VisionBackend*)arg;
+    VisionConn* conn = connectBackend(backend, PREWARM_TIMEOUT_MS);
+
+    portSemTake(warmLock());
+    s_warm_conn = conn;
+    s_warm_backend = backend;
+    s_warm_at = millis();
+    s_warm_pending = false;
+    portSemGive(warmLock());
+    portSemGive(warmDone());
+}
+
+/**
+ * Whether the parked connection can serve the backend; call with the warm lock held
+ */
+static bool warmUsable(const VisionBackend* backend) {
+    return s_warm_backend->port == backend->port &&
+           s_warm_backend->use_tls == backend->use_tls &&
+           strcmp(s_warm_backend->host, backend->host) == 0 &&
+           millis() - s_warm_at <= WARM_MAX_IDLE_MS &&
+           connClient(s_warm_conn).connected();
+}
+
+void visionConnPrewarm(const VisionBackend* backend) {
+    if (!backend) {
+        return;
+    }
+    PortSem lock = warmLock();
+    PortSem done = warmDone();
+    if (!lock || !done) {
+        return;
+    }
+
+    // Keep a parked connection only while takeWarm would still use it
+    portSemTake(lock);
+    VisionConn* stale = NULL;
+    if (s_warm_conn && !warmUsable(backend)) {
+        stale = s_warm_conn;
+        s_warm_conn = NULL;
+    }
+    bool busy = s_warm_pending || s_warm_conn;
+    if (!busy) {
+        s_warm_pending = true;
+        // Forget the end of an earlier handshake nobody waited for
+        while (portSemTakeTimeout(done, 0)) {
+        }
+    }
+    portSemGive(lock);
+    if (stale) {
+        connClient(stale).stop();
+        delete stale;
+    }
+    if (busy) {
+        return;
+    }
+
+    if (!portTaskStart(prewarmTask, "vision_prewarm", (void*)backend)) {
+        s_warm_pending = false;
+    }
+}
+
+/**
+ * Take the warm connection if it matches the backend and is still usable
+ */
+static VisionConn* takeWarm(const VisionBackend* backend, uint32_t timeout_ms) {
+    PortSem lock = warmLock();
+    if (!lock) {
+        return NULL;
+    }
+
+    // A handshake already in flight is faster than starting a new one
+    if (s_warm_pending) {
+        portSemTakeTimeout(warmDone(), timeout_ms);
+    }
+
+    portSemTake(lock);
+    VisionConn* conn = NULL;
+    if (!s_warm_pending && s_warm_conn) {
+        bool usable = warmUsable(backend);
+        conn = s_warm_conn;
+        s_warm_conn = NULL;
+        if (!usable) {
+            connClient(conn).stop();
+            delete conn;
+            conn = NULL;
+        }
+    }
+    portSemGive(lock);
+    return conn;
+}
+
+VisionConn* visionConnTakeWarm(const VisionBackend* backend) {
+    return backend ? takeWarm(backend, 0) : NULL;
+}
+
+// MARK: Open
+VisionConn* visionConnOpen(const VisionBackend* backend, uint32_t timeout_ms) {
+    if (!backend) {
+        return NULL;
+    }
+
+    VisionConn* conn = takeWarm(backend, timeout_ms);
+    if (conn) {
+        return conn;
+    }
+    return connectBackend(backend, timeout_ms);
+}
+
+// MARK: I/O
+size_t visionConnWrite(VisionConn* conn, const uint8_t* data, size_t len) {
+    if (!conn) {
+        return 0;
+    }
+    return connClient(conn).write(data, len);
+}
+
+int visionConnRead(VisionConn* conn, uint8_t* buffer, size_t len) {
+    if (!conn) {
+        return -1;
+    }
+
+    Client& client = connClient(conn);
+    int available = client.available();
+    if (available > 0) {
+        return client.read(buffer, (size_t)available < len ? (size_t)available : len);
+    }
+    return client.connected() ? 0 : -1;
+}
+
+// MARK: Close
+void visionConnClose(VisionConn* conn) {
+    if (!conn) {
+        return;
+    }
+    connClient(conn).stop();
+    delete conn;
+}
+
+int8_t visionLinkRssi(void) {
+    return WiFi.status() == WL_CONNECTED ? WiFi.RSSI() : 0;
+}
@@ -0,0 +1,155 @@
+#include "waste_classifier.h"
+#include "vision_backend.h"
+#include "frame_analysis.h"
+#include "platform_port.h"
+#include <math.h>
+#include <string.h>
+#include <strings.h>
+
+// MARK: Labels
+#define WASTE_NAME_ENTRY(id, name, pulse_ms) name,
+#define WASTE_PULSE_ENTRY(id, name, pulse_ms) pulse_ms,
+static const char* const LABEL_NAMES[] = {"", WASTE_LABELS(WASTE_NAME_ENTRY, WASTE_NAME_ENTRY) "Error"};
+static const uint16_t LABEL_PULSES[] = {0, WASTE_LABELS(WASTE_PULSE_ENTRY, WASTE_PULSE_ENTRY) WASTE_ERROR_PULSE_MS};
+#undef WASTE_NAME_ENTRY
+#undef WASTE_PULSE_ENTRY
+
+const char* wasteTypeName(int waste_type) {
+    return waste_type > TYPE_UNSET && waste_type < TYPE_ERROR ? LABEL_NAMES[waste_type] : LABEL_NAMES[TYPE_ERROR];
+}
+
+uint16_t wastePulseMs(int waste_type) {
+    return waste_type > TYPE_UNSET && waste_type < TYPE_ERROR ? LABEL_PULSES[waste_type] : LABEL_PULSES[TYPE_ERROR];
+}
+
+// MARK: Matcher
+// FNV-1a over lowercase letters, usable in case labels
+static const uint32_t FNV_OFFSET = 2166136261u;
+static const uint32_t FNV_PRIME = 16777619u;
+
+static constexpr char lowerAscii(char c) {
+    return c >= 'A' && c <= 'Z' ? (char)(c + ('a' - 'A')) : c;
+}
+
+static constexpr uint32_t labelHash(const char* s, uint32_t hash = FNV_OFFSET) {
+    return *s ? labelHash(s + 1, (hash ^ (uint8_t)lowerAscii(*s)) * FNV_PRIME) : hash;
+}
+
+static inline bool isWordChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9');
+}
+
+/**
+ * Look up one word by its hash
+ *
+ * Two labels with the same hash fail to compile (duplicate case), so a
+ * hit needs only one comparison to rule out an unrelated word.
+ */
+static int wordType(const char* word, size_t len, uint32_t hash) {
+    int type;
+    switch (hash) {
+#define WASTE_CASE_ENTRY(id, name, pulse_ms) case labelHash(name): type = TYPE_##id; break;
+        WASTE_LABELS(WASTE_CASE_ENTRY, WASTE_CASE_ENTRY)
+#undef WASTE_CASE_ENTRY
+        default: return TYPE_ERROR;
+    }
+    const char* name = LABEL_NAMES[type];
+    return strlen(name) == len && strncasecmp(name, word, len) == 0 ? type : TYPE_ERROR;
+}
+
+int matchWasteLabel(const char* text, size_t len) {
+    if (!text) {
+        return TYPE_ERROR;
+    }
+    uint32_t hash = FNV_OFFSET;
+    uint32_t stem = FNV_OFFSET;     // Hash without the last letter, for plurals
+    size_t start = 0;
+    for (size_t i = 0; i <= len; i++) {
+        char c = i < len ? lowerAscii(text[i]) : ' ';
+        if (isWordChar(c)) {
+            stem = hash;
+            hash = (hash ^ (uint8_t)c) * FNV_PRIME;
+            continue;
+        }
+        if (i > start) {
+            size_t word_len = i - start;
+            int type = wordType(text + start, word_len, hash);
+            if (type == TYPE_ERROR && word_len > 1 && lowerAscii(text[i - 1]) == 's') {
+                type = wordType(text + start, word_len - 1, stem);
+            }
+            if (type != TYPE_ERROR) {
+                return type;
+            }
+        }
+        // The text is still JSON-escaped: "\n" separates words too
+        if (c == '\\' && i + 1 < len) {
+            i++;
+        }
+        hash = FNV_OFFSET;
+        start = i + 1;
+    }
+    return TYPE_ERROR;
+}
+
+int parseGeminiResponse(const char* response) {
+    // Only look at the model's answer, not the whole response envelope
+    const char* text;
+    size_t text_len;
+    if (!visionExtractText(response, &text, &text_len)) {
+        return TYPE_ERROR;
+    }
+    return matchWasteLabel(text, text_len);
+}
+
+WasteVerdict parseVerdict(const char* response) {
+    WasteVerdict verdict;
+    verdict.waste_type = parseGeminiResponse(response);
+    verdict.confidence = -1;
+
+    VisionAnswerInfo info;
+    visionExtractAnswerInfo(response, &info);
+    verdict.finish = info.finish;
+    if (info.has_logprob) {
+        verdict.confidence = expf(info.logprob > 0 ? 0 : info.logprob);
+    }
+    return verdict;
+}
+
+// MARK: Local Fallback
+static const uint32_t VERDICT_CACHE_MS = 10000;
+static const uint8_t VERDICT_MATCH_BITS = 6;    // Hash bits a repeat of the same item may differ by
+static const uint8_t EMPTY_TOLERANCE_PCT = 8;
+
+static int s_last_verdict = TYPE_ERROR;
+static uint32_t s_last_verdict_at = 0;
+static uint64_t s_last_verdict_hash = 0;       // Item the verdict was issued for, 0 if unknown
+static size_t s_empty_jpeg_len = 0;
+
+void classifierRemember(int waste_type, size_t jpeg_len, uint64_t item_hash) {
+    if (waste_type == TYPE_ERROR) {
+        return;
+    }
+    s_last_verdict = waste_type;
+    s_last_verdict_at = millis();
+    s_last_verdict_hash = item_hash;
+
+    if (waste_type == TYPE_NONE) {
+        // Running average of empty-chute sizes, weighted 3:1 to the history
+        s_empty_jpeg_len = s_empty_jpeg_len ? (3 * s_empty_jpeg_len + jpeg_len) / 4 : jpeg_len;
+    }
+}
+
+int classifyLocally(size_t jpeg_len, uint64_t item_hash) {
+    if (s_empty_jpeg_len) {
+        size_t diff = jpeg_len > s_empty_jpeg_len ? jpeg_len - s_empty_jpeg_len : s_empty_jpeg_len - jpeg_len;
+        if (diff * 100 <= s_empty_jpeg_len * EMPTY_TOLERANCE_PCT) {
+            return TYPE_NONE;
+        }
+    }
+    // Only a repeat of the same item may reuse its verdict; the next item on the line must not
+    if (s_last_verdict != TYPE_ERROR && millis() - s_last_verdict_at < VERDICT_CACHE_MS && item_hash &&
+        s_last_verdict_hash && hashDistance(item_hash, s_last_verdict_hash) <= VERDICT_MATCH_BITS) {
+        return s_last_verdict;
+    }
+    return TYPE_ERROR;
+}
@@ -0,0 +1,113 @@
+#ifndef WASTE_CLASSIFIER_H
+#define WASTE_CLASSIFIER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "waste_labels.h"
+#include "vision_backend.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Waste types, numbered from 1 in table order, then TYPE_ERROR
+#define WASTE_TYPE_ENTRY(id, name, pulse_ms) TYPE_##id,
+enum {
+    TYPE_UNSET = 0,     // No verdict yet
+    WASTE_LABELS(WASTE_TYPE_ENTRY, WASTE_TYPE_ENTRY)
+    TYPE_ERROR
+};
+#undef WASTE_TYPE_ENTRY
+
+// MARK: Generated Strings
+#define WASTE_LABEL_NAME(id, name, pulse_ms) name
+#define WASTE_LABEL_SKIP(id, name, pulse_ms)
+#define WASTE_PROMPT_ITEM(id, name, pulse_ms) name ", "
+#define WASTE_ENUM_ITEM(id, name, pulse_ms) "\"" name "\","
+#define WASTE_ENUM_LAST(id, name, pulse_ms) "\"" name "\""
+
+// The empty-chute answer
+#define WASTE_NONE_LABEL WASTE_LABELS(WASTE_LABEL_SKIP, WASTE_LABEL_NAME)
+
+// Classification prompt listing every label
+#define WASTE_PROMPT "Which trash type do you see in the image? Answer with one word from this list: " \
+    WASTE_LABELS(WASTE_PROMPT_ITEM, WASTE_LABEL_NAME) ". Say " WASTE_NONE_LABEL \
+    " if you can't see any trash, and don't write anything else."
+
+// JSON array of the labels, for VisionRequest.response_enum
+#define WASTE_RESPONSE_ENUM "[" WASTE_LABELS(WASTE_ENUM_ITEM, WASTE_ENUM_LAST) "]"
+
+// MARK: Labels
+/**
+ * @return The label of a waste type, "Error" for TYPE_ERROR or unknown values
+ */
+const char* wasteTypeName(int waste_type);
+
+/**
+ * @return Length of the OUTPUT_PIN pulse signalling a waste type
+ */
+uint16_t wastePulseMs(int waste_type);
+
+/**
+ * Find the first label in a model answer
+ *
+ * One pass over the text: each word is hashed as it is read and looked
+ * up in a switch whose cases the compiler computes from the label table,
+ * so the cost does not grow with the number of labels. Case-insensitive,
+ * and a trailing plural "s" is accepted.
+ *
+ * @param text Answer text (need not be NUL terminated)
+ * @param len Length of text
+ * @return One of the TYPE_* values, TYPE_ERROR if no label was found
+ */
+int matchWasteLabel(const char* text, size_t len);
+
+/**
+ * A backend answer with what the response says about its reliability
+ */
+typedef struct {
+    int waste_type;                 // TYPE_* value, TYPE_ERROR if no answer was recognised
+    VisionFinishReason finish;
+    float confidence;               // Probability of the answer 0-1, negative if the backend gave none
+} WasteVerdict;
+
+/**
+ * Map a backend response to a waste type and its confidence
+ * @param response Response body from sendToGeminiAPI
+ */
+WasteVerdict parseVerdict(const char* response);
+
+/**
+ * Map a backend response to a waste type
+ * @param response Response body from sendToGeminiAPI
+ * @return One of the TYPE_* values, TYPE_ERROR if no answer was recognised
+ */
+int parseGeminiResponse(const char* response);
+
+/**
+ * Remember a backend verdict for classifyLocally
+ * @param waste_type Verdict from parseGeminiResponse
+ * @param jpeg_len Size of the JPEG it was given
+ * @param item_hash thumbnailHash() of the frame, 0 if there is none
+ */
+void classifierRemember(int waste_type, size_t jpeg_len, uint64_t item_hash);
+
+/**
+ * Best guess without the backend, for when the request quota is exhausted
+ *
+ * A JPEG about as large as recent empty-chute frames is taken as TYPE_NONE
+ * (an empty chute compresses to a stable size); otherwise a verdict from
+ * the last few seconds is reused, but only if the frame's hash shows the
+ * same item, as in a burst of triggers on one item.
+ *
+ * @param jpeg_len Size of the captured JPEG
+ * @param item_hash thumbnailHash() of the frame, 0 if there is none (no verdict is reused then)
+ * @return One of the TYPE_* values, TYPE_ERROR if there is no good guess
+ */
+int classifyLocally(size_t jpeg_len, uint64_t item_hash);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WASTE_CLASSIFIER_H */
@@ -0,0 +1,26 @@
+#ifndef WASTE_LABELS_H
+#define WASTE_LABELS_H
+
+/**
+ * The label set, defined once
+ *
+ * Each X(ID, name, pulse_ms) entry yields TYPE_<ID>, the word the model
+ * answers with, and the length of the OUTPUT_PIN pulse that signals it.
+ * The prompt, the response schema and the matcher are generated from
+ * this table, so adding a label is one line here. Pulse lengths are set
+ * per label rather than derived from the order, so the sorting hardware
+ * keeps its codes when a label is inserted.
+ *
+ * The final entry goes to LAST: it is the answer for an empty chute.
+ */
+#define WASTE_LABELS(X, LAST) \
+    X(PLASTIC,   "plastic",   50)  \
+    X(CARDBOARD, "cardboard", 100) \
+    X(PAPER,     "paper",     150) \
+    X(OTHER,     "other",     200) \
+    LAST(NONE,   "None",      250)
+
+// Pulse for a failed classification
+#define WASTE_ERROR_PULSE_MS 300
+
+#endif /* WASTE_LABELS_H */
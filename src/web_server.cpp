@@ -0,0 +1,698 @@
+#include "web_server.h"
+#include "shared_state.h"
+#include "vision_client.h"
+#include "request_scheduler.h"
+#include "frame_hub.h"
+#include "capture_log.h"
+#include "capture_archive.h"
+#include "link_estimator.h"
+#include "base64_stream.h"
+#include "exposure_lock.h"
+#include "sensor_profile.h"
+#include "timer_wheel.h"
+#include "idle_power.h"
+#include "waste_classifier.h"
+#include "verdict_policy.h"
+#include "frame_source.h"
+#include "platform_port.h"
+#include <Arduino.h>
+#include "esp_http_server.h"
+#include "esp_idf_version.h"
+#include "lwip/sockets.h"
+#include <atomic>
+#include <new>
+
+// Async request handling lets each stream client run on its own task; older
+// servers hand the client's socket to a task instead
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
+#define STREAM_ASYNC 1
+#else
+#define STREAM_ASYNC 0
+#endif
+
+// MARK: Server Config
+static const size_t SEND_CHUNK_SIZE = 4096;
+static const uint8_t MAX_CLIENTS = 7;
+static const uint8_t MAX_URI_HANDLERS = 16;
+
+static const uint8_t STREAM_MAX_CLIENTS = 3;
+static const uint8_t STREAM_DEFAULT_FPS = 5;
+static const uint8_t STREAM_MAX_FPS = 15;
+static const uint32_t STREAM_BUSY_INTERVAL_MS = 1000;  // While a classification is in flight
+
+static const size_t REMOTE_FRAME_MAX = 256 * 1024;      // Largest JPEG a remote camera may push
+static const size_t REMOTE_NAME_MAX = 16;
+static const uint8_t REMOTE_RECV_TIMEOUTS = 3;          // Receive timeouts before a stalled push is dropped
+
+static httpd_handle_t s_server = NULL;
+static httpd_handle_t s_stream_server = NULL;
+static std::atomic<int> s_stream_clients(0);
+
+// Remote cameras, registered as frame sources on their first push
+typedef struct {
+    FrameSource source;
+    char name[REMOTE_NAME_MAX];
+} RemoteCamera;
+
+static RemoteCamera s_remotes[FRAME_SOURCES_MAX];
+static uint8_t s_remote_count = 0;
+static PortSem s_remote_lock = NULL;
+
+#define STREAM_BOUNDARY "frame"
+#define STREAM_CONTENT_TYPE "multipart/x-mixed-replace;boundary=" STREAM_BOUNDARY
+static const char* STREAM_PART = "\r\n--" STREAM_BOUNDARY "\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n";
+
+// MARK: Handlers
+static esp_err_t handleIndex(httpd_req_t* req) {
+    static const char html[] =
+        "<html><body>"
+        "<h1>ESP32-CAM Trash Classifier</h1>"
+        "<p><a href='/photo.jpg'>View Latest Capture</a> (<a href='/photo'>request JSON</a>)</p>"
+        "<p><a href='/trigger'>Trigger New Capture</a></p>"
+        "<p><a href='/status'>Status</a></p>"
+        "<p><a href='/log'>Capture Log (CSV)</a></p>"
+        "<p><a href='/captures'>Recent Captures</a> (<a href='/captures.tar'>download</a>)</p>"
+        "<p><a href='/stream' onclick=\"this.href='//'+location.hostname+':81/stream';\">Live Preview</a></p>"
+        "</body></html>";
+    httpd_resp_set_type(req, "text/html");
+    return httpd_resp_send(req, html, sizeof(html) - 1);
+}
+
+static esp_err_t handlePhoto(httpd_req_t* req) {
+    SharedPayload* payload = payloadAcquire();
+    if (!payload) {
+        httpd_resp_set_status(req, "404 Not Found");
+        httpd_resp_set_type(req, "text/plain");
+        return httpd_resp_sendstr(req, "No image captured yet");
+    }
+
+    // Stream in chunks; the reference keeps the payload alive even if a
+    // newer capture replaces it meanwhile
+    httpd_resp_set_type(req, "application/json");
+    const char* data = payloadData(payload);
+    size_t remaining = payloadLength(payload);
+    esp_err_t err = ESP_OK;
+    while (remaining > 0 && err == ESP_OK) {
+        size_t chunk = remaining > SEND_CHUNK_SIZE ? SEND_CHUNK_SIZE : remaining;
+        err = httpd_resp_send_chunk(req, data, chunk);
+        data += chunk;
+        remaining -= chunk;
+    }
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, NULL, 0);
+    }
+
+    payloadRelease(payload);
+    return err;
+}
+
+static esp_err_t handlePhotoJpeg(httpd_req_t* req) {
+    SharedPayload* payload = payloadAcquire();
+    const char* json = payload ? payloadData(payload) : NULL;
+    size_t json_len = payload ? payloadLength(payload) : 0;
+
+    // The capture is the last image in the payload, after any few-shot examples
+    size_t start = 0;
+    size_t end = 0;
+    bool found = false;
+    while (base64FindInlineData(json, json_len, end, &start, &end)) {
+        found = true;
+    }
+    if (!found) {
+        payloadRelease(payload);
+        httpd_resp_set_status(req, "404 Not Found");
+        httpd_resp_set_type(req, "text/plain");
+        return httpd_resp_sendstr(req, "No image captured yet");
+    }
+
+    // Decoded a slice at a time, never into a second full-size buffer
+    static const size_t SLICE = SEND_CHUNK_SIZE / 3 * 4;     // Base64 characters per chunk sent
+    static uint8_t chunk[BASE64_DECODED_MAX(SLICE) + 2];
+    Base64Decoder decoder;
+    base64DecoderInit(&decoder);
+    httpd_resp_set_type(req, "image/jpeg");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    esp_err_t err = ESP_OK;
+    for (size_t pos = start; pos < end && err == ESP_OK; pos += SLICE) {
+        size_t slice = end - pos < SLICE ? end - pos : SLICE;
+        size_t len = base64Decode(&decoder, json + pos, slice, chunk);
+        if (pos + slice == end) {
+            len += base64DecodeFinish(&decoder, chunk + len);
+        }
+        if (decoder.failed) {
+            err = ESP_FAIL;
+        } else if (len > 0) {
+            err = httpd_resp_send_chunk(req, (const char*)chunk, len);
+        }
+    }
+    payloadRelease(payload);
+
+    // On a decode error the headers are already out, just end the response
+    esp_err_t end_err = httpd_resp_send_chunk(req, NULL, 0);
+    return err == ESP_OK ? end_err : err;
+}
+
+static esp_err_t handleTrigger(httpd_req_t* req) {
+    httpd_resp_set_type(req, "text/plain");
+    if (pipelineRequestTrigger()) {
+        wheelWake();
+        return httpd_resp_sendstr(req, "Triggered successfully");
+    }
+    httpd_resp_set_status(req, "409 Conflict");
+    return httpd_resp_sendstr(req, "Already processing an image");
+}
+
+static esp_err_t handleStatus(httpd_req_t* req) {
+    static const char* STATE_NAMES[] = {"idle", "triggered", "processing"};
+
+    StatusSnapshot status;
+    statusRead(&status);
+    VisionHedgeStats hedge = visionGetHedgeStats();
+    SchedulerStats quota = schedulerGetStats();
+    LinkStats link = linkGetStats();
+    ExposureStats exposure = exposureGetStats();
+    SensorProfileStats profiles = sensorProfileGetStats();
+    IdleStats idle = idleGetStats();
+    VerdictPolicyStats verdicts = verdictPolicyGetStats();
+
+    static char json[1536];    // Handlers run one at a time; keeps it off the httpd stack
+    snprintf(json, sizeof(json),
+             "{\"state\":\"%s\",\"uptime_ms\":%lu,\"captures\":%lu,\"failures\":%lu,"
+             "\"last_result\":%d,\"last_latency_ms\":%lu,\"last_result_at\":%lu,"
+             "\"degraded\":%lu,\"local_results\":%lu,\"last_sharpness\":%u,\"hedges\":{\"fired\":%lu,\"won\":%lu,\"suppressed\":%lu},"
+             "\"quota\":{\"granted\":%lu,\"throttled\":%lu,\"refused\":%lu,\"tokens\":%u,\"paused_ms\":%lu},"
+             "\"link\":{\"rssi\":%d,\"throughput_bps\":%lu,\"uploads\":%lu,\"last_upload_ms\":%lu,"
+             "\"last_predicted_ms\":%lu,\"levels\":[%lu,%lu,%lu],\"reencode_ms\":[%lu,%lu]},"
+             "\"exposure\":{\"snapshot\":%s,\"aec\":%u,\"gain\":%u,\"learned\":%lu,\"locked\":%lu,\"settle_ms\":%lu},"
+             "\"profiles\":{\"switches\":%lu,\"writes\":%lu,\"skipped\":%lu,\"failures\":%lu,\"last_switch_us\":%lu},"
+             "\"idle\":{\"parked\":%s,\"light_sleep\":%s,\"parks\":%lu,\"parked_ms\":%lu,\"wakes\":%lu,"
+             "\"wake_to_capture_ms\":%lu,\"wake_to_capture_max_ms\":%lu},"
+             "\"verdicts\":{\"accepted\":%lu,\"requeried\":%lu,\"recaptured\":%lu,\"overturned\":%lu,"
+             "\"unsure_kept\":%lu,\"last_confidence_pct\":%d},\"sources\":[",
+             STATE_NAMES[pipelineGetState()], (unsigned long)millis(),
+             (unsigned long)status.captures, (unsigned long)status.failures,
+             status.last_result, (unsigned long)status.last_latency_ms,
+             (unsigned long)status.last_result_at, (unsigned long)status.degraded,
+             (unsigned long)status.local_results, (unsigned)status.last_sharpness,
+             (unsigned long)hedge.fired, (unsigned long)hedge.won, (unsigned long)hedge.suppressed,
+             (unsigned long)quota.granted, (unsigned long)quota.throttled, (unsigned long)quota.degraded,
+             (unsigned)quota.tokens, (unsigned long)quota.paused_ms,
+             (int)link.rssi, (unsigned long)link.throughput_bps, (unsigned long)link.uploads,
+             (unsigned long)link.last_upload_ms, (unsigned long)link.last_predicted_ms,
+             (unsigned long)link.decisions[0], (unsigned long)link.decisions[1], (unsigned long)link.decisions[2],
+             (unsigned long)link.reencode_ms[1], (unsigned long)link.reencode_ms[2],
+             exposure.valid ? "true" : "false", (unsigned)exposure.aec, (unsigned)exposure.gain,
+             (unsigned long)exposure.learned, (unsigned long)exposure.locked,
+             (unsigned long)exposure.last_settle_ms,
+             (unsigned long)profiles.switches, (unsigned long)profiles.writes, (unsigned long)profiles.skipped,
+             (unsigned long)profiles.failures, (unsigned long)profiles.last_switch_us,
+             idle.parked ? "true" : "false", idle.light_sleep ? "true" : "false",
+             (unsigned long)idle.parks, (unsigned long)idle.parked_ms, (unsigned long)idle.wakes,
+             (unsigned long)idle.last_wake_to_capture_ms, (unsigned long)idle.max_wake_to_capture_ms,
+             (unsigned long)verdicts.accepted, (unsigned long)verdicts.requeried,
+             (unsigned long)verdicts.recaptured, (unsigned long)verdicts.overturned,
+             (unsigned long)verdicts.unsure_kept, (int)verdicts.last_confidence_pct);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    esp_err_t err = httpd_resp_send_chunk(req, json, HTTPD_RESP_USE_STRLEN);
+
+    // Remote cameras after the fixed part, however many have registered
+    for (uint8_t i = 0; i < frameSourceCount() && err == ESP_OK; i++) {
+        const FrameSource* source = frameSourceAt(i);
+        char item[160];
+        int len = snprintf(item, sizeof(item),
+                           "%s{\"id\":%u,\"name\":\"%s\",\"frames\":%lu,\"dropped\":%lu,"
+                           "\"last_result\":%d,\"last_latency_ms\":%lu}",
+                           i ? "," : "", (unsigned)source->id, source->name,
+                           (unsigned long)source->stats.frames, (unsigned long)source->stats.dropped,
+                           source->stats.last_verdict, (unsigned long)source->stats.last_latency_ms);
+        err = httpd_resp_send_chunk(req, item, len);
+    }
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, "]}", 2);
+    }
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, NULL, 0);
+    }
+    return err;
+}
+
+static bool sendLogChunk(void* ctx, const char* data, size_t len) {
+    return httpd_resp_send_chunk((httpd_req_t*)ctx, data, len) == ESP_OK;
+}
+
+static esp_err_t handleLog(httpd_req_t* req) {
+    httpd_resp_set_type(req, "text/csv");
+    httpd_resp_set_hdr(req, "Content-Disposition", "inline; filename=\"captures.csv\"");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    if (!captureLogExportCsv(sendLogChunk, req)) {
+        // Headers may already be out, just end the response
+        httpd_resp_send_chunk(req, NULL, 0);
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// MARK: Archive
+static bool sendArchiveChunk(void* ctx, const char* data, size_t len) {
+    return httpd_resp_send_chunk((httpd_req_t*)ctx, data, len) == ESP_OK;
+}
+
+static esp_err_t handleCaptures(httpd_req_t* req) {
+    static ArchiveEntry entries[ARCHIVE_SLOTS];
+    uint8_t count = archiveList(entries);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    esp_err_t err = httpd_resp_send_chunk(req, "[", 1);
+    for (uint8_t i = 0; i < count && err == ESP_OK; i++) {
+        char item[192];
+        int len = snprintf(item, sizeof(item),
+                           "%s{\"id\":%lu,\"trigger_ms\":%lu,\"latency_ms\":%lu,\"verdict\":\"%s\","
+                           "\"capture_bytes\":%lu,\"thumbnail\":\"/capture.jpg?id=%lu\"}",
+                           i ? "," : "", (unsigned long)entries[i].id, (unsigned long)entries[i].trigger_ms,
+                           (unsigned long)entries[i].latency_ms, wasteTypeName(entries[i].verdict),
+                           (unsigned long)entries[i].jpeg_len, (unsigned long)entries[i].id);
+        err = httpd_resp_send_chunk(req, item, len);
+    }
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, "]", 1);
+    }
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, NULL, 0);
+    }
+    return err;
+}
+
+static esp_err_t handleCaptureImage(httpd_req_t* req) {
+    char query[32];
+    char value[12];
+    uint32_t id = 0;
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "id", value, sizeof(value)) == ESP_OK) {
+        id = strtoul(value, NULL, 10);
+    }
+
+    httpd_resp_set_type(req, "image/jpeg");
+    if (id == 0 || !archiveExportImage(id, sendArchiveChunk, req)) {
+        httpd_resp_set_status(req, "404 Not Found");
+        httpd_resp_set_type(req, "text/plain");
+        return httpd_resp_sendstr(req, "Capture not in the archive");
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static esp_err_t handleCapturesTar(httpd_req_t* req) {
+    httpd_resp_set_type(req, "application/x-tar");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"captures.tar\"");
+    if (!archiveExportTar(sendArchiveChunk, req)) {
+        httpd_resp_send_chunk(req, NULL, 0);
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// MARK: Remote Cameras
+/**
+ * A push waiting for its verdict
+ *
+ * The handler returns as soon as the frame is queued; the verdict is
+ * written to the camera's socket later, from the server's own task, so
+ * the control server never blocks on a classification.
+ */
+typedef struct {
+    int sockfd;
+    int waste_type;
+} RemoteReply;
+
+// The session owns no memory through its context, which only marks who may answer on it
+static void remoteSessionFree(void* ctx) {
+    (void)ctx;
+}
+
+static void sendRemoteReply(void* arg) {
+    RemoteReply* reply = (RemoteReply*)arg;
+
+    // The socket may have closed, and its number been reused, while the frame waited
+    if (httpd_sess_get_ctx(s_server, reply->sockfd) == reply) {
+        // Plain label text, which the camera's matcher reads as it would a model answer
+        bool ok = reply->waste_type != TYPE_ERROR;
+        const char* body = ok ? wasteTypeName(reply->waste_type) : "No verdict";
+        char response[192];
+        int len = snprintf(response, sizeof(response),
+                           "HTTP/1.1 %s\r\n"
+                           "Content-Type: text/plain\r\n"
+                           "Cache-Control: no-store\r\n"
+                           "Content-Length: %u\r\n"
+                           "Connection: close\r\n"
+                           "\r\n"
+                           "%s",
+                           ok ? "200 OK" : "502 Bad Gateway", (unsigned)strlen(body), body);
+        httpd_socket_send(s_server, reply->sockfd, response, len, 0);
+        httpd_sess_set_ctx(s_server, reply->sockfd, NULL, NULL);
+        httpd_sess_trigger_close(s_server, reply->sockfd);
+    }
+    free(reply);
+}
+
+static void remoteDeliver(FrameSource* source, const SourceFrame* frame, int waste_type) {
+    (void)source;
+    RemoteReply* reply = (RemoteReply*)frame->owner;
+    reply->waste_type = waste_type;
+    if (httpd_queue_work(s_server, sendRemoteReply, reply) != ESP_OK) {
+        free(reply);
+    }
+}
+
+static void remoteRelease(FrameSource* source, SourceFrame* frame) {
+    (void)source;
+    free((void*)frame->jpeg);
+}
+
+static const FrameSourceOps REMOTE_OPS = {remoteDeliver, remoteRelease};
+
+// Names go into /status JSON as they are, so keep them to plain characters
+static bool validSourceName(const char* name) {
+    if (!*name) {
+        return false;
+    }
+    for (const char* c = name; *c; c++) {
+        if (!isalnum((unsigned char)*c) && *c != '-' && *c != '_') {
+            return false;
+        }
+    }
+    return true;
+}
+
+static FrameSource* remoteSource(const char* name) {
+    portSemTake(s_remote_lock);
+    FrameSource* source = frameSourceFind(name);
+    if (!source && s_remote_count < FRAME_SOURCES_MAX) {
+        RemoteCamera* remote = &s_remotes[s_remote_count];
+        strlcpy(remote->name, name, sizeof(remote->name));
+        remote->source.name = remote->name;
+        remote->source.ops = &REMOTE_OPS;
+        if (frameSourceRegister(&remote->source)) {
+            source = &remote->source;
+            s_remote_count++;
+        }
+    }
+    portSemGive(s_remote_lock);
+    return source;
+}
+
+static esp_err_t sendError(httpd_req_t* req, const char* status, const char* message) {
+    httpd_resp_set_status(req, status);
+    httpd_resp_set_type(req, "text/plain");
+    return httpd_resp_sendstr(req, message);
+}
+
+static esp_err_t handleFrame(httpd_req_t* req) {
+    char query[48];
+    char name[REMOTE_NAME_MAX];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+        httpd_query_key_value(query, "source", name, sizeof(name)) != ESP_OK || !validSourceName(name)) {
+        return sendError(req, "400 Bad Request", "Missing source");
+    }
+    if (req->content_len == 0) {
+        return sendError(req, "400 Bad Request", "Empty frame");
+    }
+    if (req->content_len > REMOTE_FRAME_MAX) {
+        return sendError(req, "413 Payload Too Large", "Frame too large");
+    }
+    FrameSource* source = remoteSource(name);
+    if (!source) {
+        return sendError(req, "503 Service Unavailable", "Too many cameras");
+    }
+
+    uint8_t* jpeg = (uint8_t*)ps_malloc(req->content_len);
+    RemoteReply* reply = (RemoteReply*)malloc(sizeof(RemoteReply));
+    if (!jpeg || !reply) {
+        free(jpeg);
+        free(reply);
+        return sendError(req, "503 Service Unavailable", "Out of memory");
+    }
+
+    // A camera that stops sending gives up its slot after a few receive timeouts
+    size_t received = 0;
+    uint8_t timeouts = 0;
+    while (received < req->content_len) {
+        int n = httpd_req_recv(req, (char*)jpeg + received, req->content_len - received);
+        if (n == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts < REMOTE_RECV_TIMEOUTS) {
+            continue;
+        }
+        if (n <= 0) {
+            free(jpeg);
+            free(reply);
+            if (n == HTTPD_SOCK_ERR_TIMEOUT) {
+                httpd_resp_send_err(req, HTTPD_408_REQ_TIMEOUT, NULL);
+            }
+            return ESP_FAIL;
+        }
+        received += n;
+    }
+
+    // Answered later by sendRemoteReply; the capture loop answers every
+    // queued frame, stale ones with an error, so the camera always gets one
+    reply->sockfd = httpd_req_to_sockfd(req);
+    reply->waste_type = TYPE_ERROR;
+    if (!frameSourceSubmit(source, jpeg, received, reply)) {
+        free(jpeg);
+        free(reply);
+        return sendError(req, "503 Service Unavailable", "Queue full");
+    }
+    // Handlers set the session context through the request; the server copies it over on return
+    req->sess_ctx = reply;
+    req->free_ctx = remoteSessionFree;
+    return ESP_OK;
+}
+
+// MARK: Stream
+// Sends one piece of the stream, false once the client is gone
+typedef bool (*StreamSend)(void* arg, const char* data, size_t len);
+
+static uint8_t requestedFps(httpd_req_t* req) {
+    char query[32];
+    char value[8];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "fps", value, sizeof(value)) == ESP_OK) {
+        int fps = atoi(value);
+        if (fps >= 1) {
+            return fps > STREAM_MAX_FPS ? STREAM_MAX_FPS : fps;
+        }
+    }
+    return STREAM_DEFAULT_FPS;
+}
+
+static void streamLoop(uint32_t interval, StreamSend push, void* arg) {
+    bool sent = true;
+    uint32_t last_sent = 0;
+    uint32_t last_frame_at = 0;
+    while (sent) {
+        // Never grab frames while the classifier needs the camera and the uplink
+        bool busy = pipelineGetState() != PIPELINE_IDLE;
+        uint32_t wait = busy ? STREAM_BUSY_INTERVAL_MS : interval;
+        uint32_t elapsed = millis() - last_sent;
+        if (elapsed < wait) {
+            delay(wait - elapsed);
+            continue;
+        }
+
+        SharedFrame* frame = frameHubAcquire(interval, !busy);
+        last_sent = millis();
+        if (!frame) {
+            continue;
+        }
+        if (frameTimestamp(frame) == last_frame_at) {
+            frameRelease(frame);
+            continue;
+        }
+        last_frame_at = frameTimestamp(frame);
+
+        // Send straight from the shared frame buffer
+        const camera_fb_t* fb = frameBuffer(frame);
+        char part[96];
+        int len = snprintf(part, sizeof(part), STREAM_PART, (unsigned)fb->len);
+        sent = push(arg, part, len) && push(arg, (const char*)fb->buf, fb->len);
+        frameRelease(frame);
+    }
+}
+
+#if STREAM_ASYNC
+static bool streamSendChunk(void* arg, const char* data, size_t len) {
+    return httpd_resp_send_chunk((httpd_req_t*)arg, data, len) == ESP_OK;
+}
+
+static void streamTask(void* arg) {
+    httpd_req_t* req = (httpd_req_t*)arg;
+    httpd_resp_set_type(req, STREAM_CONTENT_TYPE);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    streamLoop(1000 / requestedFps(req), streamSendChunk, req);
+    httpd_req_async_handler_complete(req);
+    s_stream_clients--;
+}
+#else
+// Without async handlers the handler hands its socket to a task of its own and
+// returns, so the stream server stays free for the next client. The session and
+// the task each hold a reference; streamClose leaves the socket open while the
+// task has it, and the last one out closes it, so the number is never reused
+// under the task.
+typedef struct {
+    int sockfd;
+    uint32_t interval;
+    std::atomic<int> refs;
+} StreamClient;
+
+static const char STREAM_HEAD[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: " STREAM_CONTENT_TYPE "\r\n"
+    "Cache-Control: no-store\r\n"
+    "Connection: close\r\n\r\n";
+
+static bool socketSendAll(int sockfd, const char* data, size_t len) {
+    // The server set a send timeout on the socket, so a stalled client errors out
+    while (len > 0) {
+        int sent = send(sockfd, data, len, 0);
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        len -= sent;
+    }
+    return true;
+}
+
+static void streamClientRelease(void* ctx) {
+    StreamClient* client = (StreamClient*)ctx;
+    if (--client->refs == 0) {
+        close(client->sockfd);
+        delete client;
+        s_stream_clients--;
+    }
+}
+
+static bool streamSendSocket(void* arg, const char* data, size_t len) {
+    StreamClient* client = (StreamClient*)arg;
+    // Fewer than two references means the server dropped the session
+    return client->refs == 2 && socketSendAll(client->sockfd, data, len);
+}
+
+static void streamClientTask(void* arg) {
+    StreamClient* client = (StreamClient*)arg;
+    streamLoop(client->interval, streamSendSocket, client);
+    httpd_sess_trigger_close(s_stream_server, client->sockfd);
+    streamClientRelease(client);
+}
+
+static void streamClose(httpd_handle_t server, int sockfd) {
+    // Streaming sessions carry their client; streamClientRelease closes those
+    if (!httpd_sess_get_ctx(server, sockfd)) {
+        close(sockfd);
+    }
+}
+#endif
+
+static esp_err_t handleStream(httpd_req_t* req) {
+    if (s_stream_clients.fetch_add(1) >= STREAM_MAX_CLIENTS) {
+        s_stream_clients--;
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_sendstr(req, "Too many stream clients");
+    }
+    // The sensor may be parked in standby; the capture loop brings it back
+    wheelWake();
+
+#if STREAM_ASYNC
+    httpd_req_t* async_req = NULL;
+    if (httpd_req_async_handler_begin(req, &async_req) == ESP_OK) {
+        if (portTaskStart(streamTask, "stream", async_req)) {
+            return ESP_OK;
+        }
+        httpd_req_async_handler_complete(async_req);
+    }
+#else
+    StreamClient* client = new (std::nothrow) StreamClient();
+    if (client) {
+        client->sockfd = httpd_req_to_sockfd(req);
+        client->interval = 1000 / requestedFps(req);
+        client->refs = 2;
+        if (socketSendAll(client->sockfd, STREAM_HEAD, sizeof(STREAM_HEAD) - 1) &&
+            portTaskStart(streamClientTask, "stream", client)) {
+            // The server copies the context over to the session on return
+            req->sess_ctx = client;
+            req->free_ctx = streamClientRelease;
+            return ESP_OK;
+        }
+        delete client;
+    }
+#endif
+
+    s_stream_clients--;
+    return ESP_FAIL;
+}
+
+// MARK: Start
+int webStreamClients(void) {
+    return s_stream_clients.load();
+}
+
+static bool registerUri(httpd_handle_t server, const char* uri, esp_err_t (*handler)(httpd_req_t*),
+                        httpd_method_t method = HTTP_GET) {
+    httpd_uri_t route = {};
+    route.uri = uri;
+    route.method = method;
+    route.handler = handler;
+    return httpd_register_uri_handler(server, &route) == ESP_OK;
+}
+
+bool startWebServer(uint16_t port) {
+    if (s_server) {
+        return true;
+    }
+
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = port;
+    config.ctrl_port = port + 32768;
+    config.max_open_sockets = MAX_CLIENTS;
+    config.max_uri_handlers = MAX_URI_HANDLERS;
+    config.lru_purge_enable = true;
+    config.core_id = 0;  // Capture loop runs on core 1
+
+    if (!s_remote_lock) {
+        s_remote_lock = portSemCreate(1);
+    }
+    if (!s_remote_lock || httpd_start(&s_server, &config) != ESP_OK) {
+        s_server = NULL;
+        return false;
+    }
+
+    if (!registerUri(s_server, "/", handleIndex) ||
+        !registerUri(s_server, "/photo", handlePhoto) ||
+        !registerUri(s_server, "/photo.jpg", handlePhotoJpeg) ||
+        !registerUri(s_server, "/trigger", handleTrigger) ||
+        !registerUri(s_server, "/status", handleStatus) ||
+        !registerUri(s_server, "/log", handleLog) ||
+        !registerUri(s_server, "/captures", handleCaptures) ||
+        !registerUri(s_server, "/capture.jpg", handleCaptureImage) ||
+        !registerUri(s_server, "/captures.tar", handleCapturesTar) ||
+        !registerUri(s_server, "/frame", handleFrame, HTTP_POST)) {
+        return false;
+    }
+
+    // Preview stream on the next port, so a long-lived stream never blocks the control handlers
+    httpd_config_t stream_config = HTTPD_DEFAULT_CONFIG();
+    stream_config.server_port = port + 1;
+    stream_config.ctrl_port = port + 32769;
+    stream_config.max_open_sockets = STREAM_MAX_CLIENTS + 1;
+    stream_config.lru_purge_enable = true;
+    stream_config.core_id = 0;
+#if !STREAM_ASYNC
+    stream_config.close_fn = streamClose;
+#endif
+
+    if (httpd_start(&s_stream_server, &stream_config) != ESP_OK) {
+        s_stream_server = NULL;
+        return false;
+    }
+    return registerUri(s_stream_server, "/stream", handleStream);
+}
@@ -0,0 +1,34 @@
+#ifndef WEB_SERVER_H
+#define WEB_SERVER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Start the HTTP control server on its own task
+ *
+ * Runs on esp_http_server pinned to core 0, away from the capture loop on
+ * core 1. Handlers only touch shared_state.h, so any number of dashboard
+ * clients can poll while a classification is in flight. A multipart
+ * MJPEG preview is served at /stream on port + 1, each client from a task
+ * of its own; clients past the limit get a 503.
+ *
+ * @param port TCP port to listen on
+ * @return true if successful, false on error
+ */
+bool startWebServer(uint16_t port);
+
+/**
+ * @return Preview clients currently streaming
+ */
+int webStreamClients(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WEB_SERVER_H */